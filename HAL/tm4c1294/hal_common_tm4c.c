@@ -22,6 +22,13 @@
 #include "driverlib/interrupt.h"
 #include "driverlib/pwm.h"
 
+//  Cortex-M4 debug registers used for cycle counting (not covered by TivaWare)
+#define DEMCR_REG           0xE000EDFC
+#define DEMCR_TRCENA        0x01000000
+#define DWT_CTRL_REG        0xE0001000
+#define DWT_CTRL_CYCCNTENA  0x00000001
+#define DWT_CYCCNT_REG      0xE0001004
+
 
 uint32_t g_ui32SysClock;
 
@@ -45,6 +52,10 @@ void HAL_BOARD_CLOCK_Init()
     MAP_FPUStackingEnable();
     //  Enable interrupt handler
     MAP_IntMasterEnable();
+    //  Start free-running cycle counter used as a time base for measurements
+    HWREG(DEMCR_REG) |= DEMCR_TRCENA;
+    HWREG(DWT_CYCCNT_REG) = 0;
+    HWREG(DWT_CTRL_REG) |= DWT_CTRL_CYCCNTENA;
 }
 
 /**
@@ -67,6 +78,53 @@ void HAL_DelayUS(uint32_t us)   //1000
     MAP_SysCtlDelay((uint32_t)f);
 }
 
+/**
+ * Get current value of free-running cycle counter
+ * @note Counter wraps around every ~35s at 120MHz; use only for measuring
+ * intervals shorter than that (unsigned subtraction handles the wrap-around)
+ * @return number of clock cycles since counter was started
+ */
+uint32_t HAL_GetTicks()
+{
+    return HWREG(DWT_CYCCNT_REG);
+}
+
+/**
+ * Convert number of clock cycles into microseconds
+ * @param ticks number of clock cycles (i.e. difference of two HAL_GetTicks())
+ * @return equivalent time in microseconds
+ */
+uint32_t HAL_TicksToUS(uint32_t ticks)
+{
+    return (ticks / (g_ui32SysClock / 1000000));
+}
+
+/**
+ * Get time elapsed since the cycle counter was started in milliseconds
+ * Accumulates cycle counter so the value doesn't wrap around every ~35s, as
+ * long as the function is called at least once in that period.
+ * @return time in ms
+ */
+uint32_t HAL_GetMS()
+{
+    static uint32_t lastTick = 0, remTicks = 0, ms = 0;
+    uint32_t retVal, now;
+    //  Function is called from both ISRs and main loop, keep update atomic
+    bool intDisabled = MAP_IntMasterDisable();
+
+    now = HWREG(DWT_CYCCNT_REG);
+    remTicks += now - lastTick;
+    lastTick = now;
+    ms += remTicks / (g_ui32SysClock / 1000);
+    remTicks %= (g_ui32SysClock / 1000);
+    retVal = ms;
+
+    if (!intDisabled)
+        MAP_IntMasterEnable();
+
+    return retVal;
+}
+
 /**
  * Calculate load value from timer based on desired time in milliseconds
  * @param ms time in milliseconds
@@ -27,6 +27,9 @@ extern void         HAL_BOARD_CLOCK_Init();
 extern void         HAL_BOARD_Reset();
 extern void         UNUSED (int32_t arg);
 extern uint32_t     _TM4CMsToCycles(uint32_t ms);
+extern uint32_t     HAL_GetTicks();
+extern uint32_t     HAL_TicksToUS(uint32_t ticks);
+extern uint32_t     HAL_GetMS();
 
 extern void         HAL_SetPWM(uint32_t id, uint32_t pwm);
 extern uint32_t     HAL_GetPWM(uint32_t id);
@@ -25,43 +25,66 @@
 #include "driverlib/systick.h"
 #include "driverlib/timer.h"
 
+//  Default port: UART7 on PC4/PC5, CH_PD on PC6, Timer 6, flow control on
+//  PE4/PE5 (see header for details)
+HAL_ESP_Port HAL_ESP_PORT0 =
+{
+    SYSCTL_PERIPH_UART7, UART7_BASE, INT_UART7,
+    SYSCTL_PERIPH_GPIOC, GPIO_PORTC_BASE, GPIO_PC4_U7RX, GPIO_PC5_U7TX,
+    GPIO_PIN_4 | GPIO_PIN_5,
+    SYSCTL_PERIPH_GPIOC, GPIO_PORTC_BASE, GPIO_PIN_6, GPIO_PIN_7,
+    SYSCTL_PERIPH_TIMER6, TIMER6_BASE, INT_TIMER6A,
+    SYSCTL_PERIPH_GPIOE, GPIO_PORTE_BASE, GPIO_PIN_4, GPIO_PIN_5
+};
+
+//  Second port: UART6 on PP0/PP1, CH_PD on PP2, Timer 7, flow control on
+//  PP4/PP5
+HAL_ESP_Port HAL_ESP_PORT1 =
+{
+    SYSCTL_PERIPH_UART6, UART6_BASE, INT_UART6,
+    SYSCTL_PERIPH_GPIOP, GPIO_PORTP_BASE, GPIO_PP0_U6RX, GPIO_PP1_U6TX,
+    GPIO_PIN_0 | GPIO_PIN_1,
+    SYSCTL_PERIPH_GPIOP, GPIO_PORTP_BASE, GPIO_PIN_2, GPIO_PIN_3,
+    SYSCTL_PERIPH_TIMER7, TIMER7_BASE, INT_TIMER7A,
+    SYSCTL_PERIPH_GPIOP, GPIO_PORTP_BASE, GPIO_PIN_4, GPIO_PIN_5
+};
+
 /**
  * Initialize UART port communicating with ESP8266 chip - 8 data bits, no parity,
  * 1 stop bit, no flow control
+ * @param port port ESP is connected to
  * @param baud designated speed of communication
  * @return HAL library error code
  */
-uint32_t HAL_ESP_InitPort(uint32_t baud)
+uint32_t HAL_ESP_InitPort(HAL_ESP_Port *port, uint32_t baud)
 {
-    static bool pinInit = false;
-
     //  Prevents reinitializing the pins every time a baud rate is updated
-    if (!pinInit)
+    if (!port->pinInit)
     {
         //  Configure HW pins for UART and on/off signal
-        MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOC);
-        MAP_GPIOPinConfigure(GPIO_PC4_U7RX);
-        MAP_GPIOPinConfigure(GPIO_PC5_U7TX);
-        MAP_GPIOPinTypeUART(GPIO_PORTC_BASE, GPIO_PIN_4 | GPIO_PIN_5);
+        MAP_SysCtlPeripheralEnable(port->uartGPIOPeriph);
+        MAP_GPIOPinConfigure(port->rxPinCfg);
+        MAP_GPIOPinConfigure(port->txPinCfg);
+        MAP_GPIOPinTypeUART(port->uartGPIOBase, port->uartPins);
 
-        MAP_GPIOPinTypeGPIOOutput(GPIO_PORTC_BASE, GPIO_PIN_6);
-        MAP_GPIOPinWrite(GPIO_PORTC_BASE, GPIO_PIN_6, 0x00);
+        MAP_SysCtlPeripheralEnable(port->ctrlGPIOPeriph);
+        MAP_GPIOPinTypeGPIOOutput(port->ctrlGPIOBase, port->enPin);
+        MAP_GPIOPinWrite(port->ctrlGPIOBase, port->enPin, 0x00);
 
-        MAP_GPIOPinTypeGPIOOutput(GPIO_PORTC_BASE, GPIO_PIN_7);
-        MAP_GPIOPinWrite(GPIO_PORTC_BASE, GPIO_PIN_7, 0xFF);
+        MAP_GPIOPinTypeGPIOOutput(port->ctrlGPIOBase, port->rstPin);
+        MAP_GPIOPinWrite(port->ctrlGPIOBase, port->rstPin, 0xFF);
 
-        pinInit = true;
+        port->pinInit = true;
     }
 
-    //    Configure UART 7 peripheral used for ESP communication
-    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_UART7);
-    MAP_SysCtlPeripheralReset(SYSCTL_PERIPH_UART7);
-    MAP_UARTClockSourceSet(ESP8266_UART_BASE, UART_CLOCK_SYSTEM);
-    MAP_UARTConfigSetExpClk(ESP8266_UART_BASE, g_ui32SysClock, baud,
+    //    Configure UART peripheral used for ESP communication
+    MAP_SysCtlPeripheralEnable(port->uartPeriph);
+    MAP_SysCtlPeripheralReset(port->uartPeriph);
+    MAP_UARTClockSourceSet(port->uartBase, UART_CLOCK_SYSTEM);
+    MAP_UARTConfigSetExpClk(port->uartBase, g_ui32SysClock, baud,
                         (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE |
                          UART_CONFIG_PAR_NONE));
-    MAP_UARTEnable(ESP8266_UART_BASE);
-    HAL_DelayUS(50000);    //  50ms delay after configuring
+    MAP_UARTEnable(port->uartBase);
 
     return HAL_OK;
 }
@@ -70,79 +93,135 @@ uint32_t HAL_ESP_InitPort(uint32_t baud)
  * Attach specific interrupt handler to ESP's UART and configure interrupt to
  * occur on every received character
  */
-void HAL_ESP_RegisterIntHandler(void((*intHandler)(void)))
+void HAL_ESP_RegisterIntHandler(HAL_ESP_Port *port, void((*intHandler)(void)))
 {
-    MAP_UARTDisable(ESP8266_UART_BASE);
-    //  Enable Interrupt on received data
-    MAP_UARTFIFOLevelSet(ESP8266_UART_BASE,UART_FIFO_TX1_8, UART_FIFO_RX1_8 );
-    UARTIntRegister(ESP8266_UART_BASE, intHandler);
-    MAP_UARTIntEnable(ESP8266_UART_BASE, UART_INT_RX | UART_INT_RT);
-    MAP_IntDisable(INT_UART7);
-    MAP_UARTEnable(ESP8266_UART_BASE);
+    MAP_UARTDisable(port->uartBase);
+    //  Enable Interrupt on received data and on RX FIFO overrun (counted)
+    MAP_UARTFIFOLevelSet(port->uartBase,UART_FIFO_TX1_8, UART_FIFO_RX1_8 );
+    UARTIntRegister(port->uartBase, intHandler);
+    MAP_UARTIntEnable(port->uartBase, UART_INT_RX | UART_INT_RT | UART_INT_OE);
+    MAP_IntDisable(port->uartInt);
+    MAP_UARTEnable(port->uartBase);
 }
 
 /**
  * Enable or disable ESP chip by toggling a pin connected to CH_PD
+ * Returns right away, waiting for chip to power down or boot is left to the
+ * library (it watches for the chip to report it's ready)
  * @param enable is state of device
  */
-void HAL_ESP_HWEnable(bool enable)
+void HAL_ESP_HWEnable(HAL_ESP_Port *port, bool enable)
 {
-    ///    After both actions add a delay to allow chip to settle
-    if (!enable)
-    {
-        MAP_GPIOPinWrite(GPIO_PORTC_BASE, GPIO_PIN_6, 0);
-        HAL_DelayUS(1000000);
-    }
-    else
-    {
-        MAP_GPIOPinWrite(GPIO_PORTC_BASE, GPIO_PIN_6, 0xFF);
-        HAL_DelayUS(2000000);
-    }
+    MAP_GPIOPinWrite(port->ctrlGPIOBase, port->enPin, (enable ? 0xFF : 0));
 }
 
 /**
  * Check whether the chip is enabled or disabled
  */
-bool HAL_ESP_IsHWEnabled()
+bool HAL_ESP_IsHWEnabled(HAL_ESP_Port *port)
 {
-    return ((MAP_GPIOPinRead(GPIO_PORTC_BASE, GPIO_PIN_6) & GPIO_PIN_6) > 0);
+    return ((MAP_GPIOPinRead(port->ctrlGPIOBase, port->enPin) & port->enPin) > 0);
 }
 
 /**
  * Enable/disable UART interrupt - interrupt occurs on every char received
  * @param enable
  */
-void HAL_ESP_IntEnable(bool enable)
+void HAL_ESP_IntEnable(HAL_ESP_Port *port, bool enable)
 {
-    if (enable) MAP_IntEnable(INT_UART7);
-    else MAP_IntDisable(INT_UART7);
+    if (enable) MAP_IntEnable(port->uartInt);
+    else MAP_IntDisable(port->uartInt);
 }
 
 /**
- * Clear all interrupt flags when an interrupt occurs
+ * Clear all interrupt flags when an interrupt occurs (counts RX FIFO overruns)
  */
-int32_t HAL_ESP_ClearInt()
+int32_t HAL_ESP_ClearInt(HAL_ESP_Port *port)
 {
-    uint32_t retVal = MAP_UARTIntStatus(ESP8266_UART_BASE, true);
+    uint32_t retVal = MAP_UARTIntStatus(port->uartBase, true);
     //  Clear all raised interrupt flags
-    MAP_UARTIntClear(ESP8266_UART_BASE, retVal);
+    MAP_UARTIntClear(port->uartBase, retVal);
+
+    //  FIFO was full when another char arrived - at least one byte was lost
+    if (retVal & UART_INT_OE)
+    {
+        port->overruns++;
+        MAP_UARTRxErrorClear(port->uartBase);
+    }
     return retVal;
 }
 
+/**
+ * Enable/disable RTS/CTS flow control
+ * UARTs used have no hardware flow control, so RTS is driven and CTS is read
+ * as GPIO pins. When disabled, RTS is kept asserted and CTS is ignored.
+ * @note ESP has to be configured for flow control separately (AT+UART_CUR)
+ * @param enable desired state of flow control
+ */
+void HAL_ESP_FlowControl(HAL_ESP_Port *port, bool enable)
+{
+    if (!port->fcPinInit)
+    {
+        MAP_SysCtlPeripheralEnable(port->fcGPIOPeriph);
+        MAP_GPIOPinTypeGPIOOutput(port->fcGPIOBase, port->rtsPin);
+        MAP_GPIOPinTypeGPIOInput(port->fcGPIOBase, port->ctsPin);
+        port->fcPinInit = true;
+    }
+
+    //  RTS is active low, assert it - ready to receive
+    MAP_GPIOPinWrite(port->fcGPIOBase, port->rtsPin, 0x00);
+    port->flowCtrl = enable;
+}
+
+/**
+ * Check if ESP is ready to receive data (CTS asserted)
+ * @return true: if data can be sent to ESP (or flow control is disabled)
+ *        false: if ESP asked to pause transmission
+ */
+bool HAL_ESP_TxReady(HAL_ESP_Port *port)
+{
+    if (!port->flowCtrl)
+        return true;
+
+    return ((MAP_GPIOPinRead(port->fcGPIOBase, port->ctsPin)
+             & port->ctsPin) == 0);
+}
+
+/**
+ * Ask ESP to pause/resume transmission by deasserting/asserting RTS. Used while
+ * received data is processed in ISR and RX FIFO isn't being emptied.
+ * @param hold true to pause transmission, false to resume it
+ */
+void HAL_ESP_RxHold(HAL_ESP_Port *port, bool hold)
+{
+    if (!port->flowCtrl)
+        return;
+
+    MAP_GPIOPinWrite(port->fcGPIOBase, port->rtsPin, hold ? 0xFF : 0x00);
+}
+
+/**
+ * Get number of RX FIFO overruns since startup
+ * @return number of overruns (each means at least one byte lost)
+ */
+uint32_t HAL_ESP_OverrunCount(HAL_ESP_Port *port)
+{
+    return port->overruns;
+}
+
 /**
  * Watchdog timer for ESP module - used to reset protocol if communication hangs
  * for too long.
  */
-void((*g_intHandler)(void));
-void HAL_ESP_InitWD(void((*intHandler)(void)))
+void HAL_ESP_InitWD(HAL_ESP_Port *port, void((*intHandler)(void)))
 {
-    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER6);
-    MAP_SysCtlPeripheralReset(SYSCTL_PERIPH_TIMER6);
-    MAP_TimerConfigure(TIMER6_BASE, TIMER_CFG_ONE_SHOT_UP);
-    TimerIntRegister(TIMER6_BASE, TIMER_A, intHandler);
-    MAP_TimerIntEnable(TIMER6_BASE, TIMER_TIMA_TIMEOUT);
-    MAP_IntEnable(INT_TIMER6A);
-    g_intHandler = intHandler;
+    MAP_SysCtlPeripheralEnable(port->timerPeriph);
+    MAP_SysCtlPeripheralReset(port->timerPeriph);
+    MAP_TimerConfigure(port->timerBase, TIMER_CFG_ONE_SHOT_UP);
+    TimerIntRegister(port->timerBase, TIMER_A, intHandler);
+    MAP_TimerIntEnable(port->timerBase, TIMER_TIMA_TIMEOUT);
+    MAP_IntEnable(port->timerInt);
+    port->wdHandler = intHandler;
 }
 
 /**
@@ -150,29 +229,29 @@ void HAL_ESP_InitWD(void((*intHandler)(void)))
  * @param enable desired state of timer (true-run/false-stop)
  * @param ms time in millisec. after which the communication is interrupted
  */
-void HAL_ESP_WDControl(bool enable, uint32_t ms)
+void HAL_ESP_WDControl(HAL_ESP_Port *port, bool enable, uint32_t ms)
 {
-    //  Record last value for timeout, use it when timeout argument is 0
-    static uint32_t LTM;
+    //  Last value for timeout is used when timeout argument is 0
     HAL_DelayUS(2);
-    MAP_TimerDisable(TIMER6_BASE, TIMER_A);
+    MAP_TimerDisable(port->timerBase, TIMER_A);
 
     if (enable)
     {
         if (ms != 0)
         {
-            HAL_ESP_InitWD(g_intHandler);
-            MAP_TimerLoadSet(TIMER6_BASE, TIMER_A, _TM4CMsToCycles(ms));
-            LTM = ms;
+            HAL_ESP_InitWD(port, port->wdHandler);
+            MAP_TimerLoadSet(port->timerBase, TIMER_A, _TM4CMsToCycles(ms));
+            port->wdLastMS = ms;
 
         }
         else
-            MAP_TimerLoadSet(TIMER6_BASE, TIMER_A, _TM4CMsToCycles(LTM));
-        MAP_TimerEnable(TIMER6_BASE, TIMER_A);
+            MAP_TimerLoadSet(port->timerBase, TIMER_A,
+                             _TM4CMsToCycles(port->wdLastMS));
+        MAP_TimerEnable(port->timerBase, TIMER_A);
     }
     else if (ms != 0)
     {
-        LTM = ms;
+        port->wdLastMS = ms;
     }
 }
 
@@ -187,11 +266,11 @@ void HAL_ESP_WDControl(bool enable, uint32_t ms)
  * leaves this (watchdog) interrupt. (Because there can be no interrupt within
  * an interrupt)
  */
-void HAL_ESP_WDClearInt()
+void HAL_ESP_WDClearInt(HAL_ESP_Port *port)
 {
-    MAP_TimerIntClear(TIMER6_BASE, MAP_TimerIntStatus(TIMER6_BASE, true));
-    MAP_TimerDisable(TIMER6_BASE, TIMER_A);
+    MAP_TimerIntClear(port->timerBase, MAP_TimerIntStatus(port->timerBase, true));
+    MAP_TimerDisable(port->timerBase, TIMER_A);
 
-    MAP_IntPendSet(INT_UART7);
+    MAP_IntPendSet(port->uartInt);
 }
 
@@ -4,10 +4,18 @@
  *  Created on: Mar 4, 2017
  *      Author: Vedran Mikov
  *
- ****Hardware dependencies:
+ ****Hardware dependencies (one set per ESP module, see HAL_ESP_Port):
+ *  HAL_ESP_PORT0 (default):
  *      UART7, pins PC4(Rx), PC5(Tx)
  *      GPIO PC6(CH_PD), PC7(Reset-not implemented!)
  *      Timer 6 - watchdog timer in case UART port hangs(likes to do so)
+ *      (optional) GPIO PE4(RTS, output), PE5(CTS, input) - flow control,
+ *      UART7 has no hardware RTS/CTS pins so they are handled as GPIOs
+ *  HAL_ESP_PORT1 (second module):
+ *      UART6, pins PP0(Rx), PP1(Tx)
+ *      GPIO PP2(CH_PD), PP3(Reset-not implemented!)
+ *      Timer 7 - watchdog timer
+ *      (optional) GPIO PP4(RTS, output), PP5(CTS, input) - flow control
  */
 #include <stdint.h>
 #include <stdbool.h>
@@ -22,7 +30,54 @@
 #include "driverlib/rom.h"
 
 /**     ESP8266 - related macros        */
-#define ESP8266_UART_BASE       0x40013000
+//  Number of ports (ESP modules) available on this board
+#define HAL_ESP_PORT_NUM        2
+
+/**
+ * Hardware used to communicate with one ESP module, and run-time state of it.
+ * Every function of this HAL takes the port it operates on, so several modules
+ * can be used at the same time.
+ */
+struct _halEspPort
+{
+    //  UART peripheral, its interrupt and pins
+    uint32_t    uartPeriph;
+    uint32_t    uartBase;
+    uint32_t    uartInt;
+    uint32_t    uartGPIOPeriph;
+    uint32_t    uartGPIOBase;
+    uint32_t    rxPinCfg;
+    uint32_t    txPinCfg;
+    uint8_t     uartPins;
+    //  CH_PD and reset pins
+    uint32_t    ctrlGPIOPeriph;
+    uint32_t    ctrlGPIOBase;
+    uint8_t     enPin;
+    uint8_t     rstPin;
+    //  Timer used as watchdog
+    uint32_t    timerPeriph;
+    uint32_t    timerBase;
+    uint32_t    timerInt;
+    //  Flow control pins: RTS connects to ESP's CTS (GPIO13), CTS connects to
+    //  ESP's RTS (GPIO15), both active low
+    uint32_t    fcGPIOPeriph;
+    uint32_t    fcGPIOBase;
+    uint8_t     rtsPin;
+    uint8_t     ctsPin;
+
+    //  Run-time state, zero-initialized
+    bool                pinInit;
+    bool                fcPinInit;
+    //  Specifies whether RTS/CTS flow control is in use
+    volatile bool       flowCtrl;
+    //  Number of RX FIFO overruns (bytes lost) since startup
+    volatile uint32_t   overruns;
+    //  Last watchdog timeout, used when timeout argument is 0
+    uint32_t            wdLastMS;
+    //  Watchdog interrupt handler
+    void                ((*wdHandler)(void));
+};
+typedef struct _halEspPort HAL_ESP_Port;
 
 #ifdef __cplusplus
 extern "C"
@@ -33,23 +88,35 @@ extern "C"
  * To prevent unnecessary stack layers (calling function from function) some
  * simpler functions are implemented using just macro definitions
  */
-#define HAL_ESP_UARTBusy()      MAP_UARTBusy(ESP8266_UART_BASE)
-#define HAL_ESP_SendChar(x)     MAP_UARTCharPut(ESP8266_UART_BASE, x)
-#define HAL_ESP_CharAvail()     MAP_UARTCharsAvail(ESP8266_UART_BASE)
-#define HAL_ESP_GetChar()       MAP_UARTCharGetNonBlocking(ESP8266_UART_BASE)
-
-
-extern uint32_t    HAL_ESP_InitPort(uint32_t baud);
-extern void        HAL_ESP_RegisterIntHandler(void((*intHandler)(void)));
-extern void        HAL_ESP_HWEnable(bool enable);
-extern bool        HAL_ESP_IsHWEnabled();
-extern void        HAL_ESP_IntEnable(bool enable);
-extern int32_t     HAL_ESP_ClearInt();
+#define HAL_ESP_UARTBusy(p)     MAP_UARTBusy((p)->uartBase)
+#define HAL_ESP_SendChar(p, x)  do {                                    \
+                                    while(!HAL_ESP_TxReady(p)) {}       \
+                                    MAP_UARTCharPut((p)->uartBase, x);  \
+                                } while(0)
+#define HAL_ESP_CharAvail(p)    MAP_UARTCharsAvail((p)->uartBase)
+#define HAL_ESP_GetChar(p)      MAP_UARTCharGetNonBlocking((p)->uartBase)
+
+//  Ports ESP modules are connected to (HAL_ESP_PORT0 is the default one)
+extern HAL_ESP_Port HAL_ESP_PORT0;
+extern HAL_ESP_Port HAL_ESP_PORT1;
+
+extern uint32_t    HAL_ESP_InitPort(HAL_ESP_Port *port, uint32_t baud);
+extern void        HAL_ESP_RegisterIntHandler(HAL_ESP_Port *port,
+                                              void((*intHandler)(void)));
+extern void        HAL_ESP_HWEnable(HAL_ESP_Port *port, bool enable);
+extern bool        HAL_ESP_IsHWEnabled(HAL_ESP_Port *port);
+extern void        HAL_ESP_IntEnable(HAL_ESP_Port *port, bool enable);
+extern int32_t     HAL_ESP_ClearInt(HAL_ESP_Port *port);
 //extern bool        HAL_ESP_CharAvail();
 //extern char        HAL_ESP_GetChar();
-extern void        HAL_ESP_InitWD(void((*intHandler)(void)));
-extern void        HAL_ESP_WDControl(bool enable, uint32_t timeout);
-extern void        HAL_ESP_WDClearInt();
+extern void        HAL_ESP_InitWD(HAL_ESP_Port *port, void((*intHandler)(void)));
+extern void        HAL_ESP_WDControl(HAL_ESP_Port *port, bool enable,
+                                     uint32_t timeout);
+extern void        HAL_ESP_WDClearInt(HAL_ESP_Port *port);
+extern void        HAL_ESP_FlowControl(HAL_ESP_Port *port, bool enable);
+extern bool        HAL_ESP_TxReady(HAL_ESP_Port *port);
+extern void        HAL_ESP_RxHold(HAL_ESP_Port *port, bool hold);
+extern uint32_t    HAL_ESP_OverrunCount(HAL_ESP_Port *port);
 
 #ifdef __cplusplus
 }
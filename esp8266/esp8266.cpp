@@ -27,13 +27,38 @@
 #include "serialPort/uartHW.h"
 #endif
 
-//  Function prototype for an interrupt handler (declared at the bottom)
-void UART7RxIntHandler(void);
+//  Function prototypes for interrupt handlers (declared at the bottom)
+void ESPRxISR(ESP8266 &esp);
+void ESPWDISR(ESP8266 &esp);
 
-//  Buffer used to assemble commands (shared between all functions )
-//  2048 is max allowed length for a continuous stream ESP can handle
-char _commBuf[2048];
+//  Instances which have initialized their hardware, index selects ISRs below
+static ESP8266 *_espInst[ESP_MAX_INST] = {0};
 
+/*
+ * Interrupt vectors take no arguments, so each instance gets its own pair of
+ * ISRs which only forward the interrupt to the instance they belong to (one
+ * pair per ESP_MAX_INST)
+ */
+static void _ESPRxISR0(void) { if (_espInst[0] != 0) ESPRxISR(*_espInst[0]); }
+static void _ESPRxISR1(void) { if (_espInst[1] != 0) ESPRxISR(*_espInst[1]); }
+static void _ESPWDISR0(void) { if (_espInst[0] != 0) ESPWDISR(*_espInst[0]); }
+static void _ESPWDISR1(void) { if (_espInst[1] != 0) ESPWDISR(*_espInst[1]); }
+
+static void ((* const _espRxISR[ESP_MAX_INST])(void)) = {_ESPRxISR0, _ESPRxISR1};
+static void ((* const _espWDISR[ESP_MAX_INST])(void)) = {_ESPWDISR0, _ESPWDISR1};
+
+//  Upper limits of latency histogram bins in ms (see _espCmdStats)
+const uint16_t _espHistLimMS[ESP_STAT_HIST_BINS - 1] =
+    {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000};
+//  Default lower bounds of adaptive timeouts in ms, indexed by ESP_CMD_*
+//  (generic commands include flash writes of *_DEF commands, hence higher; ESP
+//  stalls for tens of ms while busy with WiFi, so no bound is below 100ms)
+static const uint16_t _espRTOMinMS[ESP_CMD_NUM] =
+    {200, 1000, 200, 100, 200, 100, 100, 200};
+//  Candidate baud-rates for negotiation, ascending (TM4C UART runs up to 7.5M,
+//  ESP's limit is 115200*40)
+const uint32_t _espBaudCand[ESP_BAUD_CAND_NUM] =
+    {115200, 230400, 460800, 921600, 1000000, 1500000, 2000000, 3000000};
 
 #if defined(__USE_TASK_SCHEDULER__)
 /**
@@ -139,9 +164,7 @@ void _ESP_KernelCallback(void)
             if (!__esp.ValidSocket(__esp._espKer.args[0]))
                 return;
             cli = __esp.GetClientBySockID(__esp._espKer.args[0]);
-            __esp.custHook(__esp._espKer.args[0],
-                            (uint8_t*)(cli->RespBody),
-                            (uint16_t)((cli->RespLen)));
+            __esp._CallHandler(cli);
             __esp._espKer.retVal = ESP_STATUS_OK;
         }
         break;
@@ -204,19 +227,33 @@ void _ESP_KernelCallback(void)
 
 /**
  * Routine invoked by watchdog timer on timeout
- * Sets global status for current communication to "error", clears WD interrupt
+ * Completes the blocking command being waited for (watchdog is only armed for
+ * it) with "error" and "no response" status
+ * (ESP_NORESPONSE tells caller it was a timeout), clears WD interrupt
  * flag and artificially produces ESP's interrupt to process any remaining data
  * in the receiving buffer before communication got blocked
+ * @param __esp instance whose watchdog timer timed out
  */
-void ESPWDISR()
+void ESPWDISR(ESP8266 &__esp)
 {
-    ESP8266::GetI().flowControl = ESP_STATUS_ERROR;
+    __esp.flowControl = ESP_STATUS_ERROR | ESP_NORESPONSE;
+    __esp._wdFired = true;
+
+    //  Detached commands (e.g. AP join) keep waiting for their own reply
+    __esp._wdSlot = __esp._PendBlocking();
+    if (__esp._wdSlot >= 0)
+    {
+        _espPendCmd &cmd = __esp._pend[__esp._wdSlot];
+        __esp._wdSeq = cmd.seq;
+        cmd.status |= ESP_STATUS_ERROR | ESP_NORESPONSE;
+        cmd.done = true;
+    }
 
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_HANG);
 #endif  /* __HAL_USE_EVENTLOG__ */
 
-    HAL_ESP_WDClearInt();
+    HAL_ESP_WDClearInt(__esp._port);
 }
 
 ///-----------------------------------------------------------------------------
@@ -229,7 +266,7 @@ void ESPWDISR()
  */
 ESP8266& ESP8266::GetI()
 {
-    static ESP8266 singletonInstance;
+    static ESP8266 singletonInstance(&HAL_ESP_PORT0);
     return singletonInstance;
 }
 
@@ -251,29 +288,65 @@ ESP8266* ESP8266::GetP()
  * to handle any blockage in communication and (if using task scheduler)
  * register kernel module so TS can make calls to this library.
  * @param baud baud-rate used in serial communication between ESP and hardware
+ * (has to match ESP's default baud-rate)
+ * @param negotiate[optional] whether to negotiate the fastest baud-rate the
+ * link can sustain (see NegotiateBaud)
  * @return error code, depending on the outcome
  */
-uint32_t ESP8266::InitHW(int32_t baud)
+uint32_t ESP8266::InitHW(int32_t baud, bool negotiate)
 {
     uint32_t retVal;
 
+    //  Take a free pair of ISRs (once), there's no way to serve the port without
+    if (_inst >= ESP_MAX_INST)
+    {
+        for (_inst = 0; _inst < ESP_MAX_INST; _inst++)
+            if (_espInst[_inst] == 0)
+                break;
+        if (_inst >= ESP_MAX_INST)
+        {
+            _inst = 0xFF;
+            return ESP_STATUS_ERROR;
+        }
+        _espInst[_inst] = this;
+    }
+
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_STARTUP);
 #endif  /* __HAL_USE_EVENTLOG__ */
 
-    HAL_ESP_InitPort(baud);
-    HAL_ESP_RegisterIntHandler(UART7RxIntHandler);
-    HAL_ESP_InitWD(ESPWDISR);
-
-    //    Turn ESP8266 chip ON
+    //  Drop any commands and events left from before
+    memset((void*)_pend, 0, sizeof(_pend));
+    _evHead = _evTail = 0;
+    _echoCapture = false;
+    _ptMode = false;
+    _passiveRx = false;
+    _dinfo = false;
+    //  Seed pseudo-random generator (must be non-zero)
+    _rndState = HAL_GetTicks() | 1;
+    _rxLen = 0;
+
+    HAL_ESP_InitPort(_port, baud);
+    _baud = _defBaud = baud;
+    HAL_ESP_RegisterIntHandler(_port, _espRxISR[_inst]);
+    HAL_ESP_InitWD(_port, _espWDISR[_inst]);
+
+    //    Restart ESP8266 chip and wait for it to boot
+    Enable(false);
     Enable(true);
 
-    //  Send test command(AT) then turn off echoing of commands(ATE0)
-    retVal = _SendRAW("AT\0");
-    retVal = _SendRAW("ATE0\0");
+    //  Send test command(AT) unless ESP already said it's ready, then turn off
+    //  echoing of commands(ATE0)
+    if (!_ready)
+        retVal = _SendRAW("AT\0");
+    retVal = _SetConfig(_cfg.echo, 0, "ATE0\0");
+
+    //  Speed up the link as much as it allows
+    if (negotiate)
+        NegotiateBaud();
 
     //  Allow for multiple connections
-    retVal |= _SendRAW("AT+CIPMUX=1\0");
+    retVal |= _SetConfig(_cfg.mux, 1, "AT+CIPMUX=1\0");
 
     //  Reset internal parameters
     _ipAddress = 0;
@@ -283,11 +356,16 @@ uint32_t ESP8266::InitHW(int32_t baud)
     wifiStatus = ESP_WIFI_NONE;
     for (uint8_t i = 0; i < ESP_MAX_CLI; i++)
         _clients[i] = 0;
+    _retryQLen = 0;
 
 #if defined(__USE_TASK_SCHEDULER__)
-    //  Register module services with task scheduler
-    _espKer.callBackFunc = _ESP_KernelCallback;
-    TS_RegCallback(&_espKer, ESP_UID);
+    //  Register module services with task scheduler (only singleton provides
+    //  them)
+    if (this == ESP8266::GetP())
+    {
+        _espKer.callBackFunc = _ESP_KernelCallback;
+        TS_RegCallback(&_espKer, ESP_UID);
+    }
 #endif  /* __USE_TASK_SCHEDULER__ */
 
 #ifdef __HAL_USE_EVENTLOG__
@@ -299,15 +377,22 @@ uint32_t ESP8266::InitHW(int32_t baud)
 
 /**
  * Enable/disable ESP8266 chip (by controlling CH_PD pin)
+ * Disabling returns right away. Enabling first makes sure chip has been powered
+ * down for at least ESP_OFF_MIN_MS, then waits until it boots (see _WaitReady)
  * @param enable new state of chip to set
  */
 void ESP8266::Enable(bool enable)
 {
-    HAL_ESP_HWEnable(enable);
+    if (!enable)
+    {
+        HAL_ESP_HWEnable(_port, false);
+        _offMS = HAL_GetMS();
+        return;
+    }
 
-    //  If enabling the chip, wait 70ms it's started
-    if (enable)
-        HAL_DelayUS(70000);
+    while ((HAL_GetMS() - _offMS) < ESP_OFF_MIN_MS);
+    HAL_ESP_HWEnable(_port, true);
+    _WaitReady();
 }
 
 /**
@@ -316,7 +401,132 @@ void ESP8266::Enable(bool enable)
  */
 bool ESP8266::IsEnabled()
 {
-    return HAL_ESP_IsHWEnabled();
+    return HAL_ESP_IsHWEnabled(_port);
+}
+
+/**
+ * Get duration of the last boot, from powering ESP up until it reported it's
+ * ready (or replied to "AT")
+ * @return duration of boot in ms, ESP_BOOT_MAX_MS if ESP didn't respond
+ */
+uint32_t ESP8266::GetBootTime()
+{
+    return _bootMS;
+}
+
+/**
+ * Negotiate the fastest baud-rate ESP and this board can sustain
+ * Steps through candidate baud-rates (_espBaudCand) above the current one in
+ * ascending order. At each step ESP is switched to new rate with AT+UART_CUR
+ * (not saved in flash), UART port is reinitialized and link is checked with a
+ * series of echo tests (see _LinkTest). Negotiation stops at the first rate
+ * that fails and falls back to the last error-free one. If ESP can't be
+ * reached anymore it's restarted, which also restores its default baud-rate.
+ * @note Restart of ESP drops all sockets and server, call this function before
+ * opening any of them (InitHW calls it when asked to)
+ * @param maxBaud highest baud-rate to try
+ * @return baud-rate communication settled on
+ */
+uint32_t ESP8266::NegotiateBaud(uint32_t maxBaud)
+{
+    uint32_t goodBaud = _baud;
+
+    memset((void*)_linkTest, 0, sizeof(_linkTest));
+    for (uint8_t i = 0; i < ESP_BAUD_CAND_NUM; i++)
+        _linkTest[i].baud = _espBaudCand[i];
+
+    for (uint8_t i = 0; i < ESP_BAUD_CAND_NUM; i++)
+    {
+        //  Only try rates faster than the one which already works
+        if ((_espBaudCand[i] <= goodBaud) || (_espBaudCand[i] > maxBaud))
+            continue;
+
+        //  ESP has to confirm new rate before switching to it
+        if (!_InStatus(_SetBaud(_espBaudCand[i]), ESP_STATUS_OK))
+            break;
+
+        if (_LinkTest(&_linkTest[i]))
+        {
+            goodBaud = _espBaudCand[i];
+            continue;
+        }
+
+        //  Rate is not error-free, go back to the last good one
+        if (!_InStatus(_SetBaud(goodBaud), ESP_STATUS_OK) ||
+            !_InStatus(_SendRAW("AT\0", 0, 100), ESP_STATUS_OK))
+        {
+            //  ESP unreachable, restart restores its default baud-rate from
+            //  which the last good one can be set again
+            _RestartAtDefBaud();
+            if ((goodBaud != _defBaud) &&
+                _InStatus(_SetBaud(goodBaud), ESP_STATUS_OK) &&
+                !_InStatus(_SendRAW("AT\0", 0, 100), ESP_STATUS_OK))
+                _RestartAtDefBaud();
+        }
+        break;
+    }
+
+    return _baud;
+}
+
+/**
+ * Enable/disable RTS/CTS flow control on UART link with ESP
+ * ESP is configured with AT+UART_CUR (at current baud-rate) and once it
+ * confirms the change, flow control is switched in HAL as well. While enabled,
+ * ESP is asked to pause transmission while received data is being parsed, so
+ * that RX FIFO doesn't overrun.
+ * @note Requires RTS/CTS lines to be wired (see HAL)
+ * @param enable desired state of flow control
+ * @return status of AT+UART_CUR command
+ */
+uint32_t ESP8266::FlowControl(bool enable)
+{
+    uint32_t retVal;
+    bool prev = _flowCtrl;
+
+    _flowCtrl = enable;
+    retVal = _SetBaud(_baud);
+    if (!_InStatus(retVal, ESP_STATUS_OK))
+    {
+        _flowCtrl = prev;
+        return retVal;
+    }
+
+    HAL_ESP_FlowControl(_port, enable);
+    return retVal;
+}
+
+/**
+ * Get number of RX FIFO overruns (received bytes lost because ISR didn't empty
+ * FIFO in time) since startup
+ * @return number of overruns
+ */
+uint32_t ESP8266::GetRxOverruns()
+{
+    return HAL_ESP_OverrunCount(_port);
+}
+
+/**
+ * Get baud-rate currently used to communicate with ESP
+ * @return baud-rate in bits per second
+ */
+uint32_t ESP8266::GetBaud()
+{
+    return _baud;
+}
+
+/**
+ * Get result of link test done for a candidate baud-rate during the last
+ * baud-rate negotiation
+ * @param index index of candidate baud-rate (0 - (ESP_BAUD_CAND_NUM-1))
+ * @return pointer to link test results, NULL(0) if index is invalid
+ */
+const _espLinkTest* ESP8266::GetLinkTest(uint8_t index)
+{
+    if (index >= ESP_BAUD_CAND_NUM)
+        return 0;
+
+    return &_linkTest[index];
 }
 
 /**
@@ -331,6 +541,51 @@ void ESP8266::AddHook(void((*funPoint)(const uint8_t, const uint8_t*, const uint
     custHook = funPoint;
 }
 
+/**
+ * Register hook to user function, extended with sender of the data
+ * Same as AddHook() above, but hook function also gets IP address (first octet
+ * in MSB) and port data came from. Both are 0 unless reporting of remote
+ * endpoint is enabled with RemoteInfo(). When registered, it's called instead
+ * of the 3-argument hook.
+ * @param funPoint pointer to void function with 5 arguments
+ */
+void ESP8266::AddHookEx(void((*funPoint)(const uint8_t, const uint8_t*,
+                                         const uint16_t, const uint32_t,
+                                         const uint16_t)))
+{
+    custHookEx = funPoint;
+}
+
+/**
+ * Register callback called when a client connects to TCP server of ESP
+ * Callback gets the new client before any of its data is delivered, so it can
+ * set a handler for it (_espClient::SetHandler()). Not called for sockets
+ * opened by this library (OpenTCPSock(), OpenUDPSock()).
+ * @param accept function to call with the new client and [ctx], NULL(0) to
+ * remove it
+ * @param ctx[optional] user-defined context passed to [accept]
+ */
+void ESP8266::OnAccept(void((*accept)(_espClient*, void*)), void *ctx)
+{
+    _acceptCb = accept;
+    _acceptCtx = ctx;
+}
+
+/**
+ * Register callback called when a socket gets closed (by either side, or
+ * because ESP timed it out)
+ * Callback gets the client just before it's deleted. Called from ISR unless
+ * task scheduler is used, so it must not send anything to ESP.
+ * @param close function to call with the closed client and [ctx], NULL(0) to
+ * remove it
+ * @param ctx[optional] user-defined context passed to [close]
+ */
+void ESP8266::OnClose(void((*close)(_espClient*, void*)), void *ctx)
+{
+    _closeCb = close;
+    _closeCtx = ctx;
+}
+
 ///-----------------------------------------------------------------------------
 ///                  Functions used with access points                  [PUBLIC]
 ///-----------------------------------------------------------------------------
@@ -345,11 +600,47 @@ void ESP8266::AddHook(void((*funPoint)(const uint8_t, const uint8_t*, const uint
  */
 uint32_t ESP8266::ConnectAP(char* APname, char* APpass, bool nonBlocking)
 {
-    int8_t retVal = ESP_NO_STATUS;
+    uint32_t retVal = ESP_NO_STATUS;
+    //  Warm join: AP was joined before with fast-join profile, so mode and
+    //  static IP are already in ESP's flash and AP's BSSID is known
+    bool warm = _join.enabled && _join.cached &&
+                (strcmp(_join.ssid, APname) == 0);
+
+    _joinStartMS = HAL_GetMS();
+    _joinWarm = warm;
+    _joinTiming = true;
+
+    //  Set ESP in client mode. On warm join client mode is already in ESP's
+    //  flash, so unknown shadow (after reboot or timeout) doesn't rewrite it
+    if (warm && (_cfg.mode == ESP_CFG_UNKNOWN))
+        _cfg.mode = 1;
+    retVal = _SetConfig(_cfg.mode, 1, "AT+CWMODE_DEF=1\0");
+    if (!_InStatus(retVal, ESP_STATUS_OK))
+    {
+        _joinTiming = false;
+        return retVal;
+    }
 
-    //  Set ESP in client mode
-    retVal = _SendRAW("AT+CWMODE_DEF=1\0");
-    if (!_InStatus(retVal, ESP_STATUS_OK)) return retVal;
+    //  Set static IP, ESP turns its DHCP client off
+    if (_join.enabled && !_join.ipSaved)
+    {
+        memset((void*)_commBuf, 0, sizeof(_commBuf));
+        strcat(_commBuf, "AT+CIPSTA_DEF=\"");
+        strcat(_commBuf, _join.ip);
+        strcat(_commBuf, "\",\"");
+        strcat(_commBuf, _join.gateway);
+        strcat(_commBuf, "\",\"");
+        strcat(_commBuf, _join.netmask);
+        strcat(_commBuf, "\"\0");
+
+        retVal = _SendRAW(_commBuf);
+        if (!_InStatus(retVal, ESP_STATUS_OK))
+        {
+            _joinTiming = false;
+            return retVal;
+        }
+        _join.ipSaved = true;
+    }
 
     wifiStatus = ESP_WIFI_CONNECTING;
 
@@ -359,13 +650,44 @@ uint32_t ESP8266::ConnectAP(char* APname, char* APpass, bool nonBlocking)
     strcat(_commBuf, APname);
     strcat(_commBuf, "\",\"");
     strcat(_commBuf, APpass);
+    if (warm)
+    {
+        strcat(_commBuf, "\",\"");
+        strcat(_commBuf, _join.bssid);
+    }
     strcat(_commBuf, "\"\0");
 
     //  Use standard send function but increase timeout to 6s as acquiring IP
     //  address might take time
-    retVal = _SendRAW(_commBuf, (nonBlocking?ESP_NONBLOCKING_MODE:0), 16000);
-    if (!_InStatus(retVal, ESP_STATUS_OK)) return retVal;
+    retVal = _SendRAW(_commBuf, (nonBlocking?ESP_NONBLOCKING_MODE:0),
+                      (warm ? ESP_FJ_WARM_MS : 16000));
+    if (nonBlocking)
+    {
+        //  Parameters of AP are cached from Service() once connected
+        _joinQuery = _join.enabled && !warm;
+        return retVal;
+    }
+    if (!_InStatus(retVal, ESP_STATUS_OK))
+    {
+        _joinTiming = false;
+        //  AP might have moved to another BSSID, forget it and try cold join
+        if (warm)
+        {
+            _join.cached = false;
+            return ConnectAP(APname, APpass, nonBlocking);
+        }
+        return retVal;
+    }
     wifiStatus = ESP_WIFI_CONNECTED;
+    _JoinDone();
+
+    if (_join.enabled)
+    {
+        //  IP is known in advance, cache parameters of AP for next join
+        _JoinIP();
+        if (!warm)
+            _SendRAW("AT+CWJAP_CUR\?\0");
+    }
 
     //  Read acquired IP address and save it locally
     MyIP();
@@ -408,6 +730,79 @@ uint32_t ESP8266::MyIP()
     return _ipAddress;
 }
 
+/**
+ * Set up fast-join profile used by ConnectAP
+ * ESP is given a static IP, saved in its flash with AT+CIPSTA_DEF (which also
+ * turns its DHCP client off) on the next join. After a successful join SSID,
+ * BSSID and channel of the AP are cached. Next join to the same AP (warm join)
+ * passes the BSSID to AT+CWJAP, doesn't set mode again and doesn't query IP,
+ * so it takes a fraction of the time of a cold one. If warm join fails, cache
+ * is dropped and cold join is tried. Profile isn't lost when ESP is rebooted.
+ * @param ip static IP of ESP ("x.x.x.x"), NULL(0) turns the profile off and
+ * DHCP client back on
+ * @param gateway IP of the gateway ("x.x.x.x")
+ * @param netmask network mask ("x.x.x.x")
+ * @return error code, depending on the outcome
+ */
+uint32_t ESP8266::FastJoin(const char *ip, const char *gateway,
+                           const char *netmask)
+{
+    if (ip == 0)
+    {
+        uint32_t retVal = ESP_STATUS_OK;
+
+        //  Static IP is kept in ESP's flash, DHCP has to be turned on there
+        if (_join.ipSaved)
+            retVal = _SendRAW("AT+CWDHCP_DEF=1,1\0");
+        if (_InStatus(retVal, ESP_STATUS_OK))
+        {
+            _join.enabled = false;
+            _join.ipSaved = false;
+            _join.cached = false;
+        }
+        return retVal;
+    }
+
+    if ((gateway == 0) || (netmask == 0) || (strlen(ip) >= sizeof(_join.ip))
+        || (strlen(gateway) >= sizeof(_join.gateway))
+        || (strlen(netmask) >= sizeof(_join.netmask)))
+        return ESP_STATUS_ERROR;
+
+    //  Configuration is written to ESP on next join, only if it has changed
+    if (!_join.enabled || (strcmp(_join.ip, ip) != 0) ||
+        (strcmp(_join.gateway, gateway) != 0) ||
+        (strcmp(_join.netmask, netmask) != 0))
+        _join.ipSaved = false;
+
+    strcpy(_join.ip, ip);
+    strcpy(_join.gateway, gateway);
+    strcpy(_join.netmask, netmask);
+    _join.enabled = true;
+
+    return ESP_STATUS_OK;
+}
+
+/**
+ * Get duration of the last join to AP, from calling ConnectAP until ESP has
+ * its IP address
+ * @param warm true: get duration of the last warm join (with cached AP
+ * parameters), false: get duration of the last cold join
+ * @return duration of join in ms, 0 if there was no such join yet
+ */
+uint32_t ESP8266::GetJoinTime(bool warm)
+{
+    return (warm ? _join.warmMS : _join.coldMS);
+}
+
+/**
+ * Get fast-join profile, including cached parameters of the AP
+ * @return pointer to fast-join profile
+ */
+const _espJoinProfile* ESP8266::GetJoinProfile()
+{
+    return &_join;
+}
+
 ///-----------------------------------------------------------------------------
 ///                      Functions related to TCP server                [PUBLIC]
 ///-----------------------------------------------------------------------------
@@ -419,23 +814,49 @@ uint32_t ESP8266::MyIP()
  */
 uint32_t ESP8266::StartTCPServer(uint16_t port)
 {
-    int8_t retVal = ESP_STATUS_OK;
+    uint32_t retVal = ESP_STATUS_OK;
     uint8_t portStr[6] = {0};
 
+    //  Server running on another port has to be stopped first
+    if ((_cfg.servPort > 0) && (_cfg.servPort != port))
+    {
+        retVal = StopTCPServer();
+        if (!_InStatus(retVal, ESP_STATUS_OK)) return retVal;
+    }
+
+    //  Max. number of connections can only be set while server is stopped
+    if (_cfg.servPort != port)
+    {
+        memset(_commBuf, 0, sizeof(_commBuf));
+        strcat(_commBuf, "AT+CIPSERVERMAXCONN=");
+        itoa(_servMaxConn, portStr);
+        strcat(_commBuf, (char*)portStr);
+
+        retVal = _SetConfig(_cfg.maxConn, _servMaxConn, _commBuf);
+        if (!_InStatus(retVal, ESP_STATUS_OK)) return retVal;
+        memset(portStr, 0, sizeof(portStr));
+    }
+
     //  Start TCP server, in case of error return
     memset(_commBuf, 0, sizeof(_commBuf));
     strcat(_commBuf, "AT+CIPSERVER=1,");
     itoa(port, portStr);
     strcat(_commBuf, (char*)portStr);
 
-    retVal = _SendRAW(_commBuf);
+    retVal = _SetConfig(_cfg.servPort, port, _commBuf);
     if (!_InStatus(retVal, ESP_STATUS_OK)) return retVal;
 
     _tcpServPort = port;
     _servOpen = true;
 
-    //  Set TCP connection timeout to 0, in case of error return
-    retVal = _SendRAW("AT+CIPSTO=0\0");
+    //  Set TCP connection timeout (0 - never), in case of error return
+    memset(_commBuf, 0, sizeof(_commBuf));
+    strcat(_commBuf, "AT+CIPSTO=");
+    memset(portStr, 0, sizeof(portStr));
+    itoa(_servIdleS, portStr);
+    strcat(_commBuf, (char*)portStr);
+
+    retVal = _SetConfig(_cfg.servTO, _servIdleS, _commBuf);
     if (!_InStatus(retVal, ESP_STATUS_OK)) return retVal;
 
     return retVal;
@@ -447,12 +868,14 @@ uint32_t ESP8266::StartTCPServer(uint16_t port)
  */
 uint32_t ESP8266::StopTCPServer()
 {
-    int8_t retVal = ESP_STATUS_OK;
+    uint32_t retVal = ESP_STATUS_OK;
 
     //  Stop TCP server, in case of error return
-    retVal = _SendRAW("AT+CIPSERVER=0");
+    retVal = _SetConfig(_cfg.servPort, 0, "AT+CIPSERVER=0");
     if (!_InStatus(retVal, ESP_STATUS_OK)) return retVal;
 
+    //  Timeout is only kept while server is running
+    _cfg.servTO = ESP_CFG_UNKNOWN;
     _servOpen = false;
     _tcpServPort = 0;
     return retVal;
@@ -475,10 +898,148 @@ bool ESP8266::ServerOpened()
  */
 void ESP8266::TCPListen(bool enable)
 {
-    HAL_ESP_IntEnable(enable);
+    HAL_ESP_IntEnable(_port, enable);
     _servOpen = enable;
 }
 
+/**
+ * Set limits of TCP server: max. number of connections ESP accepts and time
+ * after which ESP closes a connection with no traffic on it
+ * Limits are applied by ESP itself (AT+CIPSERVERMAXCONN, AT+CIPSTO). If server
+ * is running with a different max. number of connections it's restarted, as
+ * ESP only takes it while server is stopped (established connections stay).
+ * @param maxConn max. number of connections to the server (1-ESP_MAX_CLI)
+ * @param idleS idle timeout in seconds (0-ESP_SERV_TO_MAX), 0 - never
+ * @return error code, depending on the outcome
+ */
+uint32_t ESP8266::ServerLimits(uint8_t maxConn, uint16_t idleS)
+{
+    uint32_t retVal = ESP_STATUS_OK;
+    uint8_t numStr[6] = {0};
+    uint16_t port = _tcpServPort;
+
+    if ((maxConn < 1) || (maxConn > ESP_MAX_CLI) || (idleS > ESP_SERV_TO_MAX))
+        return ESP_STATUS_ERROR;
+
+    _servMaxConn = maxConn;
+    _servIdleS = idleS;
+
+    //  Server not running, limits are applied when it's started
+    if (_cfg.servPort <= 0)
+        return retVal;
+
+    if (_cfg.maxConn != maxConn)
+    {
+        retVal = StopTCPServer();
+        if (!_InStatus(retVal, ESP_STATUS_OK)) return retVal;
+        return StartTCPServer(port);
+    }
+
+    memset(_commBuf, 0, sizeof(_commBuf));
+    strcat(_commBuf, "AT+CIPSTO=");
+    itoa(idleS, numStr);
+    strcat(_commBuf, (char*)numStr);
+
+    return _SetConfig(_cfg.servTO, idleS, _commBuf);
+}
+
+/**
+ * Register policy deciding which connections to the server are kept
+ * Policy is called for every new connection (isNew = true) before accept
+ * callback, and every ESP_POLICY_PERIOD_MS from Service() for each established
+ * one (isNew = false), e.g. to shed connections idle for too long
+ * (_espClient::IdleMS()). Returning false closes the connection; data received
+ * on a refused connection is dropped and accept callback isn't called for it.
+ * For new connections policy is called from ISR (unless task scheduler is
+ * used), closing itself is done from Service().
+ * @param keep function called with the client, whether it's a new connection
+ * and [ctx], returns true to keep the connection; NULL(0) to remove it
+ * @param ctx[optional] user-defined context passed to [keep]
+ */
+void ESP8266::ServerPolicy(bool((*keep)(_espClient*, bool, void*)), void *ctx)
+{
+    _policy = keep;
+    _policyCtx = ctx;
+}
+
+/**
+ * Close a socket from Service() (safe to call from callbacks and ISR), e.g. to
+ * make room for a new connection when server is at its limit
+ * Data received on the socket until it's closed is dropped.
+ * @param sockID ID of socket to close
+ */
+void ESP8266::Evict(uint8_t sockID)
+{
+    if (sockID < ESP_MAX_CLI)
+        _evictMask |= (1 << sockID);
+}
+
+/**
+ * Send the same data to all connected TCP clients
+ * Data goes through each socket's send buffer (_espClient::SendBuffered()), so
+ * sends are pipelined: next socket is served as soon as ESP has taken data of
+ * the previous one, without waiting for it to be acknowledged. Data is written
+ * to each socket straight from [buffer]. Client whose window is full (slow
+ * client) is skipped with ESP_STATUS_BUSY instead of holding up the others.
+ * Socket ESP rejected with "busy..." is tried once more after all the others
+ * have been served, no backoff is waited for.
+ * @param buffer data to send
+ * @param bufLen length of data in [buffer] (max. ESP_SBUF_WIN_BYTES)
+ * @param results[optional] array of ESP_MAX_CLI entries, indexed by socket ID,
+ * to store status of send on each socket in (ESP_STATUS_RECV if data was
+ * taken, ESP_NO_STATUS if there's no TCP client with that ID)
+ * @return number of clients data was sent to
+ */
+uint8_t ESP8266::Broadcast(const char *buffer, uint16_t bufLen,
+                           uint32_t *results)
+{
+    uint32_t status[ESP_MAX_CLI];
+    uint8_t sent = 0, retry = 0;
+
+    for (uint8_t pass = 0; pass < 2; pass++)
+        for (uint8_t id = 0; id < ESP_MAX_CLI; id++)
+        {
+            _espClient *cli = GetClientBySockID(id);
+
+            //  Second pass only retries sockets rejected with "busy..."
+            if ((pass > 0) && !(retry & (1 << id)))
+                continue;
+            status[id] = ESP_NO_STATUS;
+            if ((cli == 0) || !cli->_alive || cli->_udp)
+                continue;
+
+            if (_ptMode || (bufLen == 0) || (bufLen > ESP_SBUF_WIN_BYTES))
+                status[id] = ESP_STATUS_ERROR;
+            //  Don't wait for slow client to free its window
+            else if (((cli->BytesInFlight() + bufLen) > ESP_SBUF_WIN_BYTES) ||
+                     (cli->_segN >= ESP_SBUF_WIN_SEG))
+                status[id] = ESP_STATUS_BUSY;
+            //  Nor for client (or ESP) over its rate limit
+            else if (!_RateAllow(cli, bufLen, ESP_RATE_REFUSE))
+                status[id] = ESP_STATUS_BUSY;
+            else
+            {
+                if (pass > 0)
+                    _cmdStats[ESP_CMD_CIPSEND].retries++;
+                status[id] = cli->SendBuffered(buffer, bufLen);
+                //  "busy..." comes from ESP itself, serving the other sockets
+                //  first gives it time to recover
+                if ((pass == 0) && _IsBusyOnly(status[id]))
+                    retry |= (1 << id);
+                else if (_IsBusyOnly(status[id]))
+                    _cmdStats[ESP_CMD_CIPSEND].giveUp++;
+            }
+
+            if (_InStatus(status[id], ESP_STATUS_RECV))
+                sent++;
+        }
+
+    if (results != 0)
+        memcpy(results, status, sizeof(status));
+
+    return sent;
+}
+
 ///-----------------------------------------------------------------------------
 ///                      Functions related to TCP clients               [PUBLIC]
 ///-----------------------------------------------------------------------------
@@ -491,11 +1052,17 @@ void ESP8266::TCPListen(bool enable)
  * first transfer
  * @param sockID[optional] desired socket ID to assign to this connection, if
  * not specified smallest free ID is used
+ * @param handler[optional] handler of data received on this socket (see
+ * _espClient::SetHandler()), global hook is used if not provided
+ * @param ctx[optional] user-defined context passed to [handler]
  * @return On success socket ID of TCP client in _client vector,
  *         On failure ESP_STATUS_ERROR error code
  */
 uint32_t ESP8266::OpenTCPSock(char *ipAddr, uint16_t port,
-                              bool keepAlive, uint8_t sockID)
+                              bool keepAlive, uint8_t sockID,
+                              void((*handler)(_espClient*, const uint8_t*,
+                                              const uint16_t, void*)),
+                              void *ctx)
 {
     uint32_t retVal;
     uint8_t strNum[6] = {0};
@@ -531,8 +1098,13 @@ uint32_t ESP8266::OpenTCPSock(char *ipAddr, uint16_t port,
     strcat(_commBuf, (char*)strNum);
     strcat(_commBuf, ",7200\0");
 
-    //  Execute command and check outcome
+    //  Execute command and check outcome, handler is set as soon as socket is
+    //  created (in ISR) so that no data misses it
+    _openHandler = handler;
+    _openCtx = ctx;
+    _openID = sockID;
     retVal = _SendRAW(_commBuf);
+    _openID = 0xFF;
     if (_InStatus(retVal, ESP_STATUS_OK) && !_InStatus(retVal, ESP_STATUS_ERROR))
     {
         //  If success, start listening for potential incoming data from server
@@ -544,6 +1116,72 @@ uint32_t ESP8266::OpenTCPSock(char *ipAddr, uint16_t port,
     return retVal;
 }
 
+/**
+ * Open UDP socket for exchanging datagrams with remote host
+ * @param ipAddr IP address of remote host (default destination of datagrams)
+ * @param remotePort port on remote host
+ * @param localPort local port to receive datagrams on
+ * @param sockID[optional] desired socket ID, first free one is used if it's
+ * taken (or not provided)
+ * @return socket ID if successful, error code otherwise
+ */
+uint32_t ESP8266::OpenUDPSock(char *ipAddr, uint16_t remotePort,
+                              uint16_t localPort, uint8_t sockID)
+{
+    uint32_t retVal;
+    uint8_t strNum[6] = {0};
+
+    //  Can't continue if ESP is not connected
+    if (wifiStatus != ESP_WIFI_CONNECTED)
+        return ESP_STATUS_ERROR;
+
+    //  Check if socket with this ID already exists, if not create it, if yes
+    //  fined first free socket ID and use it instead
+    if ((sockID >= ESP_MAX_CLI) || (GetClientBySockID(sockID) != 0))
+    {
+        for (sockID = 0; sockID < ESP_MAX_CLI; sockID++)
+            if (_clients[sockID] == 0)
+                break;
+        //  If loop hit ESP_MAX_CLI there are no free sockets, return error code
+        if (sockID >= ESP_MAX_CLI)
+            return ESP_STATUS_ERROR;
+    }
+
+    //  Assemble command: Open UDP socket to specified IP and ports, remote
+    //  end stays fixed (mode 0)
+    memset(_commBuf, 0, sizeof(_commBuf));
+    strcat(_commBuf, "AT+CIPSTART=");
+    itoa(sockID, strNum);
+    strcat(_commBuf, (char*)strNum);
+    strcat(_commBuf, ",\"UDP\",\"");
+    strcat(_commBuf, ipAddr);
+    strcat(_commBuf, "\",");
+    memset(strNum, 0, sizeof(strNum));
+    itoa(remotePort, strNum);
+    strcat(_commBuf, (char*)strNum);
+    strcat(_commBuf, ",");
+    memset(strNum, 0, sizeof(strNum));
+    itoa(localPort, strNum);
+    strcat(_commBuf, (char*)strNum);
+    strcat(_commBuf, ",0\0");
+
+    //  Execute command and check outcome
+    _openHandler = 0;
+    _openCtx = 0;
+    _openID = sockID;
+    retVal = _SendRAW(_commBuf);
+    _openID = 0xFF;
+    if (_InStatus(retVal, ESP_STATUS_OK) && (GetClientBySockID(sockID) != 0))
+    {
+        //  Start listening for incoming datagrams
+        TCPListen(true);
+        GetClientBySockID(sockID)->_udp = true;
+        retVal = sockID;
+    }
+
+    return retVal;
+}
+
 /**
  * Check if socket with the specified [id] is open (alive)
  * @param id ID of the socket to check
@@ -579,154 +1217,582 @@ _espClient* ESP8266::GetClientBySockID(uint8_t id)
     return GetClientByIndex(id);
 }
 
-///-----------------------------------------------------------------------------
-///                      Miscellaneous functions                        [PUBLIC]
-///-----------------------------------------------------------------------------
-
 /**
- * ESP reply message parser
- * Checks ESP reply stream for commands, actions and events and updates global
- * variables accordingly.
- * @param rxBuffer string containing reply message from ESP
- * @param rxLen length of [rxBuffer] string
- * @return bitwise OR of all statuses(ESP_STATUS_*) found in the message string
+ * Open TCP socket and switch ESP into transparent transmission (passthrough)
+ * In passthrough mode ESP forwards everything it receives on UART to the socket
+ * and vice-versa, without CIPSEND handshake or +IPD framing. Socket is then
+ * accessed as a raw byte stream through client with socket ID 0 (SendTCP writes
+ * data straight to UART, received data is passed to the hook once the line goes
+ * idle). No AT commands can be sent until StopPassthrough() is called.
+ * @note Transparent transmission requires single-connection mode, so it can
+ * only be started while no other socket or server is open
+ * @param ipAddr IP address of remote server
+ * @param port port of remote server
+ * @return error code, depending on the outcome
  */
-uint32_t ESP8266::ParseResponse(char* rxBuffer, uint16_t rxLen)
+uint32_t ESP8266::StartPassthrough(char *ipAddr, uint16_t port)
 {
-    //  Return value
-    uint32_t retVal = ESP_NO_STATUS;
-    //  Flags to be set when the parameter has been found
-    int16_t ipFlag= -1, respFlag = -1, sockOflag = -1, sockCflag = -1;
-    //  Pointer to char, used to temporary store return value of strstr function
-    char *retTemp;
-
-    //  If message is empty return here
-    if (rxLen < 1)
-        return retVal;
+    uint32_t retVal;
+    uint8_t strNum[6] = {0};
 
-    //  IP address embedded, save pointer to its first digit(as string)
-    if ((retTemp = strstr(rxBuffer,"ip:\"")) != NULL)
-        ipFlag = retTemp - rxBuffer + 4;
+    //  Can't continue if ESP is not connected
+    if (wifiStatus != ESP_WIFI_CONNECTED)
+        return ESP_STATUS_ERROR;
+    //  Passthrough only works with a single connection
+    if (_ptMode || _servOpen)
+        return ESP_STATUS_ERROR;
+    for (uint8_t i = 0; i < ESP_MAX_CLI; i++)
+        if (_clients[i] != 0)
+            return ESP_STATUS_ERROR;
 
-    //  Message from one of the sockets, save pointer to first character
-    //  (which is always message length!)
-    if ((retTemp = strstr(rxBuffer,"+IPD,")) != NULL)
-    {
-        respFlag = retTemp - rxBuffer + 5;
-        retVal |= ESP_STATUS_IPD;
-    }
+    retVal = _SetConfig(_cfg.mux, 0, "AT+CIPMUX=0\0");
+    if (!_InStatus(retVal, ESP_STATUS_OK)) return retVal;
 
-    //  Look for general status messages returned by ESP
-    if (strstr(rxBuffer,"WIFI CONN") != NULL)
-    {
-        retVal |= ESP_STATUS_CONNECTED;
-        wifiStatus = ESP_WIFI_CONNECTING;
+    //  Assemble command: Open TCP socket to specified IP and port
+    memset(_commBuf, 0, sizeof(_commBuf));
+    strcat(_commBuf, "AT+CIPSTART=\"TCP\",\"");
+    strcat(_commBuf, ipAddr);
+    strcat(_commBuf, "\",");
+    itoa(port, strNum);
+    strcat(_commBuf, (char*)strNum);
+
+    retVal = _SendRAW(_commBuf);
+    if (_InStatus(retVal, ESP_STATUS_OK))
+        retVal = _SendRAW("AT+CIPMODE=1\0");
+    //  From now on everything written to UART goes to the socket
+    if (_InStatus(retVal, ESP_STATUS_OK))
+        retVal = _SendRAW("AT+CIPSEND\0", ESP_STATUS_RECV);
+    if (!_InStatus(retVal, ESP_STATUS_RECV))
+    {
+        //  Go back to multiple-connection mode
+        _SendRAW("AT+CIPMODE=0\0");
+        _SendRAW("AT+CIPCLOSE\0");
+        _SetConfig(_cfg.mux, 1, "AT+CIPMUX=1\0");
+        return retVal | ESP_STATUS_ERROR;
     }
-    if (strstr(rxBuffer,"WIFI GOT IP") != NULL)
-        wifiStatus = ESP_WIFI_CONNECTED;
-    if (strstr(rxBuffer,"WIFI DISCONN") != NULL)
-        retVal |= ESP_STATUS_DISCN;
-    if (strstr(rxBuffer,"OK") != NULL)
-        retVal |= ESP_STATUS_OK;
-    if (strstr(rxBuffer,"busy...") != NULL)
-        retVal |= ESP_STATUS_BUSY;
-    if (strstr(rxBuffer,"FAIL") != NULL)
-        retVal |= ESP_STATUS_FAIL;
-    if (strstr(rxBuffer,"ERROR") != NULL)
-        retVal |= ESP_STATUS_ERROR;
-    if (strstr(rxBuffer,"READY") != NULL)
-        retVal |= ESP_STATUS_READY;
-    if (strstr(rxBuffer,"SEND OK") != NULL)
-        retVal |= ESP_STATUS_SENDOK;
-    if (strstr(rxBuffer,"SUCCESS") != NULL)
-        retVal |= ESP_RESPOND_SUCC;
-    if (strstr(rxBuffer,">") != NULL)
-        retVal |= ESP_STATUS_RECV;
-
-    //  If new socket is opened save socket id
-    if ((retTemp =strstr(rxBuffer,",CONNECT")) != NULL)
-    {
-        sockOflag = retTemp - rxBuffer - 1; //Sock ID position
-        //  Socket got opened, create new client for it
-        if (sockOflag >= 0)
-            _clients[rxBuffer[sockOflag] - 48] =
-                    new _espClient(rxBuffer[sockOflag] - 48, this);
-
-        retVal |= ESP_STATUS_SOCKOPEN;
-    }
-    //  If socket is closed save socket id
-    if ((retTemp =strstr(rxBuffer,",CLOSED")) != NULL)
-    {
-        //  Handles a case when multiple sockets are closed at the same time
-        //  e.g. when few sockets are opened to the same server, and server
-        //  goes down
-        while (retTemp != NULL)
-        {
-            sockCflag = retTemp - rxBuffer - 1; //Sock ID position
-            //  Socket got closed, find client with this ID and delete it
-            if (sockCflag >= 0)
+
+    //  Single connection doesn't report socket ID, create client manually
+    _clients[0] = new _espClient(0, this);
+    _ptLastTxMS = HAL_GetMS();
+    _ptMode = true;
+    //  Received data is passed on once there's a gap in the stream
+    HAL_ESP_WDControl(_port, false, ESP_PT_RXGAP_MS);
+    TCPListen(true);
+
+    return retVal;
+}
+
+/**
+ * Leave transparent transmission and return to command mode
+ * Sends "+++" escape sequence, which ESP only recognizes when it arrives as a
+ * packet on its own - guarded by a pause before and after it. Socket used in
+ * passthrough is closed afterwards and ESP is returned to multiple-connection
+ * mode used by the rest of this library.
+ * @return error code, depending on the outcome
+ */
+uint32_t ESP8266::StopPassthrough()
+{
+    uint32_t retVal;
+
+    if (!_ptMode)
+        return ESP_STATUS_ERROR;
+
+    //  Pause before escape sequence so it doesn't join previous data
+    while(HAL_ESP_UARTBusy(_port));
+    while ((HAL_GetMS() - _ptLastTxMS) < ESP_PT_GUARD_MS);
+    _RAWPortWrite("+++", 3);
+    while(HAL_ESP_UARTBusy(_port));
+    //  ESP needs time before it accepts the next command
+    HAL_DelayUS(ESP_PT_EXIT_MS * 1000);
+    _ptMode = false;
+
+    retVal = _SendRAW("AT+CIPMODE=0\0");
+    _SendRAW("AT+CIPCLOSE\0");
+    retVal |= _SetConfig(_cfg.mux, 1, "AT+CIPMUX=1\0");
+
+    _DropClient(0);
+
+    return retVal;
+}
+
+/**
+ * Enable/disable passive receive mode (AT+CIPRECVMODE)
+ * In passive mode ESP keeps data received on sockets in its buffer and only
+ * notifies about its length. Data is pulled with AT+CIPRECVDATA from Service()
+ * once the previous data of the socket has been consumed, so a slow consumer
+ * makes ESP shrink its TCP window instead of data being overwritten.
+ * @param enable desired state of passive receive mode
+ * @return error code, depending on the outcome
+ */
+uint32_t ESP8266::PassiveRecv(bool enable)
+{
+    uint32_t retVal;
+
+    retVal = _SendRAW(enable ? "AT+CIPRECVMODE=1\0" : "AT+CIPRECVMODE=0\0");
+    if (_InStatus(retVal, ESP_STATUS_OK))
+        _passiveRx = enable;
+
+    return retVal;
+}
+
+/**
+ * Enable/disable reporting of remote endpoint of received data (AT+CIPDINFO)
+ * When enabled, ESP appends IP address and port of the sender to each +IPD
+ * header. They're stored in the client object (_espClient::RemoteIP(),
+ * _espClient::RemotePort()) and passed to extended hook function. Useful with
+ * UDP sockets where each datagram can come from a different sender.
+ * @param enable desired state of remote endpoint reporting
+ * @return error code, depending on the outcome
+ */
+uint32_t ESP8266::RemoteInfo(bool enable)
+{
+    uint32_t retVal;
+
+    retVal = _SendRAW(enable ? "AT+CIPDINFO=1\0" : "AT+CIPDINFO=0\0");
+    if (_InStatus(retVal, ESP_STATUS_OK))
+        _dinfo = enable;
+
+    return retVal;
+}
+
+/**
+ * Check if ESP is in transparent transmission (passthrough) mode
+ * @return true: if in passthrough mode
+ *        false: if in command mode
+ */
+bool ESP8266::InPassthrough()
+{
+    return _ptMode;
+}
+
+///-----------------------------------------------------------------------------
+///                      Miscellaneous functions                        [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * ESP reply message parser
+ * Splits ESP reply stream into lines and classifies each of them separately
+ * (see _ParseLine) updating global variables accordingly. Data received from
+ * sockets (+IPD) is extracted based on its length and is never checked for
+ * keywords, so payload can't be mistaken for status messages.
+ * @param rxBuffer string containing reply message from ESP
+ * @param rxLen length of [rxBuffer] string
+ * @param complete[optional] whether terminal statuses found in the message
+ * should complete pending commands (in order they appear in the message)
+ * @return bitwise OR of all statuses(ESP_STATUS_*) found in the message string
+ */
+uint32_t ESP8266::ParseResponse(char* rxBuffer, uint16_t rxLen, bool complete)
+{
+    //  Return value
+    uint32_t retVal = ESP_NO_STATUS;
+    uint16_t pos = 0;
+
+    while (pos < rxLen)
+    {
+        uint32_t lineStatus;
+        uint16_t lineLen = 0;
+        _espIPD ipd;
+
+        //  Data from one of the sockets, extract it and skip the payload
+        if (_IPDFrame(rxBuffer, rxLen, pos, &ipd) != 0)
+        {
+            _espClient *cli = GetClientBySockID(ipd.sockID);
+            uint16_t len = ipd.dataLen;
+
+            if (cli != 0)
+                cli->_activeMS = HAL_GetMS();
+            //  Remember who sent the data (only if ESP reported it)
+            if ((cli != 0) && (ipd.remoteIP != 0))
+            {
+                cli->_remoteIP = ipd.remoteIP;
+                cli->_remotePort = ipd.remotePort;
+            }
+
+            //  Passive mode, remember how much data there is to pull
+            if (ipd.lenOnly)
+            {
+                if (cli != 0)
+                    cli->_rxAvail += ipd.dataLen;
+                _EventPush(ESP_EV_IPD, ipd.sockID);
+                retVal |= ESP_STATUS_IPD;
+                pos = ipd.dataPos;
+                continue;
+            }
+
+            //  Frame can be cut short only when watchdog forced parsing
+            if (((uint32_t)ipd.dataPos + len) > rxLen)
+                len = rxLen - ipd.dataPos;
+            pos = ipd.dataPos + len;
+
+            if (cli != 0)
             {
-                delete _clients[rxBuffer[sockCflag] - 48];
-                _clients[rxBuffer[sockCflag] - 48] = 0;
+                //  Data pulled from ESP in passive mode
+                cli->_rxAvail -= (len < cli->_rxAvail) ? len : cli->_rxAvail;
+                _EventPush(ESP_EV_IPD, ipd.sockID);
+                //  RespBody holds anything receive buffer can, so frame is
+                //  always passed on whole (one delivery per +IPD)
+                memcpy((void*)cli->RespBody, rxBuffer + ipd.dataPos, len);
+                cli->RespBody[len] = '\0';
+                cli->RespLen = len;
+                //  Set flag that new response has been received
+                cli->_respRdy = true;
+                _DeliverRx(cli);
             }
 
-            retTemp =strstr(retTemp+1,",CLOSED");
+            retVal |= ESP_STATUS_IPD;
+            continue;
         }
-        retVal |= ESP_STATUS_SOCKCLOSE;
+
+        //  Find end of the line (or end of buffer for '> ' prompt)
+        while (((pos + lineLen) < rxLen) &&
+               !((rxBuffer[pos + lineLen] == '\r') &&
+                 ((pos + lineLen + 1) < rxLen) &&
+                 (rxBuffer[pos + lineLen + 1] == '\n')))
+            lineLen++;
+
+        lineStatus = _ParseLine(rxBuffer + pos, lineLen);
+        retVal |= lineStatus;
+        if (complete)
+            _PendComplete(lineStatus);
+
+        //  Skip line and its terminator
+        pos += lineLen + 2;
+    }
+
+    return retVal;
+}
+
+/**
+ * Get the oldest unsolicited event reported by ESP (socket opened/closed, data
+ * received, change of WiFi status) and remove it from event queue
+ * @note When queue is full newest events are dropped
+ * @param event pointer to structure to fill with event data
+ * @return true: if there was an event in the queue,
+ *        false: if queue is empty
+ */
+bool ESP8266::GetEvent(_espEvent *event)
+{
+    if (_evTail == _evHead)
+        return false;
+
+    *event = _evQ[_evTail];
+    _evTail = (_evTail + 1) % ESP_EVQ_LEN;
+
+    return true;
+}
+
+/**
+ * Get statistics of ESP replies for particular command type
+ * @param cmdType command type, one of ESP_CMD_* values
+ * @return pointer to statistics of given command type or NULL pointer(0) if
+ *         command type is not valid
+ */
+const _espCmdStats* ESP8266::GetCmdStats(uint8_t cmdType)
+{
+    if (cmdType < ESP_CMD_NUM)
+        return &(_cmdStats[cmdType]);
+    else
+        return 0;
+}
+
+/**
+ * Reset statistics of ESP replies for all command types
+ */
+void ESP8266::ResetCmdStats()
+{
+    memset((void*)_cmdStats, 0, sizeof(_cmdStats));
+    for (uint8_t i = 0; i < ESP_CMD_NUM; i++)
+        _cmdStats[i].latMinUS = 0xFFFFFFFF;
+}
+
+/**
+ * Get statistics of priority transmit scheduler for particular class
+ * @param prio priority class, one of ESP_PRIO_* values
+ * @return pointer to statistics of given class or NULL pointer(0) if class is
+ *         not valid
+ */
+const _espTxStats* ESP8266::GetTxStats(uint8_t prio)
+{
+    if (prio < ESP_PRIO_NUM)
+        return &(_txStats[prio]);
+    else
+        return 0;
+}
+
+/**
+ * Reset statistics of priority transmit scheduler for all classes
+ */
+void ESP8266::ResetTxStats()
+{
+    memset((void*)_txStats, 0, sizeof(_txStats));
+}
+
+/**
+ * Limit rate of data sent through all sockets of ESP together (token bucket)
+ * Keeps bursts from one socket from filling up UART and ESP's buffers, which
+ * makes ESP reject commands of every socket with "busy...". Each socket can
+ * have its own limit as well (_espClient::RateLimit(), where it's described
+ * how data over the limit is handled).
+ * @param rate allowed rate in bytes per second, 0 to remove the limit
+ * @param burst[optional] longest burst in bytes sent at full speed, 0 for
+ * one second worth of data
+ */
+void ESP8266::RateLimit(uint32_t rate, uint32_t burst)
+{
+    _RateSet(_rate, rate, burst);
+}
+
+/**
+ * Get rate limit of the whole ESP, including counters of bytes held back
+ * (sent later) and refused by it
+ * @return pointer to rate limit
+ */
+const _espRateLimit* ESP8266::GetRateLimit()
+{
+    return &_rate;
+}
+
+/**
+ * Enable/disable adaptive timeouts
+ * When enabled, timeout of each command type is estimated from latencies
+ * observed so far. Timeout passed to _SendRAW is then only used as an upper
+ * bound and until enough samples have been collected. When disabled, timeout
+ * passed to _SendRAW is used as-is.
+ * @param enable new state of adaptive timeouts
+ */
+void ESP8266::AdaptiveTimeout(bool enable)
+{
+    _rtoEnabled = enable;
+}
+
+/**
+ * Configure bounds of adaptive timeout for particular command type
+ * @param cmdType command type, one of ESP_CMD_* values
+ * @param minMS shortest timeout allowed (ms)
+ * @param maxMS longest timeout allowed (ms)
+ */
+void ESP8266::SetTimeoutBounds(uint8_t cmdType, uint16_t minMS, uint16_t maxMS)
+{
+    if ((cmdType >= ESP_CMD_NUM) || (minMS > maxMS))
+        return;
+
+    _rto[cmdType].minMS = minMS;
+    _rto[cmdType].maxMS = maxMS;
+}
+
+/**
+ * Get timeout to use for a command of given type
+ * @param cmdType command type, one of ESP_CMD_* values
+ * @param timeout[optional] upper bound for timeout, as given by the caller
+ * @return timeout in ms; [timeout] if adaptive timeouts are disabled or not
+ *         enough latency samples have been collected
+ */
+uint32_t ESP8266::GetTimeout(uint8_t cmdType, uint32_t timeout)
+{
+    uint32_t rto;
+
+    if (!_rtoEnabled || (cmdType >= ESP_CMD_NUM)
+        || (_rto[cmdType].samples < ESP_RTO_MIN_SAMPLES))
+        return timeout;
+
+    //  RTO = SRTT + 4*RTTVAR, rounded up to the next ms and doubled for every
+    //  consecutive timeout
+    rto = (_rto[cmdType].srttUS + 4 * _rto[cmdType].rttvarUS + 999) / 1000;
+    rto <<= _rto[cmdType].backoff;
+
+    if (rto < _rto[cmdType].minMS) rto = _rto[cmdType].minMS;
+    if (rto > _rto[cmdType].maxMS) rto = _rto[cmdType].maxMS;
+    if (rto > timeout) rto = timeout;
+
+    return rto;
+}
+
+/**
+ * Forget all settings kept in configuration shadow, so that commands setting
+ * them are sent again (e.g. if ESP was reconfigured behind library's back)
+ */
+void ESP8266::ConfigResync()
+{
+    _CfgForget(true);
+}
+
+/**
+ * Get number of configuration commands skipped because ESP already had the
+ * setting they would set
+ * @return number of skipped commands
+ */
+uint32_t ESP8266::GetConfigSkips()
+{
+    return _cfgSkips;
+}
+
+/**
+ * Service deferred work of the library, has to be called periodically (e.g.
+ * from main loop or task scheduler)
+ * Retries socket sends which were rejected by ESP with "busy..." once their
+ * backoff time expires. Entries are processed in order they were queued, but
+ * a socket waiting for its backoff doesn't block sends of other sockets.
+ * In passive receive mode pulls data waiting in ESP for sockets whose previous
+ * data has been consumed (Receive()/Done() called, or hook is used).
+ * Sends data waiting in coalescing buffers whose deadline has expired, and up
+ * to ESP_TXQ_BURST chunks of data queued for priority transmit scheduler
+ * (_espClient::SendQueued()).
+ */
+void ESP8266::Service()
+{
+    uint32_t now = HAL_GetMS();
+    //  Bit mask of sockets which have an entry in the queue waiting for retry
+    uint8_t blocked = 0;
+    uint8_t i = 0;
+
+    //  Cache parameters of AP joined in non-blocking mode
+    if (_joinQuery && (wifiStatus == ESP_WIFI_CONNECTED))
+    {
+        _joinQuery = false;
+        _SendRAW("AT+CWJAP_CUR\?\0");
     }
 
-    //  IP address embedded, extract it
-    if (ipFlag >= 0)
+    //  Close connections refused or evicted by server policy
+    for (i = 0; i < ESP_MAX_CLI; i++)
+        if (_evictMask & (1 << i))
+        {
+            _espClient *cli = GetClientBySockID(i);
+
+            if ((cli != 0) && cli->_alive)
+                cli->Close();
+            //  Don't retry if ESP refused to close it (or there's no socket)
+            if (GetClientBySockID(i) == cli)
+                _evictMask &= ~(1 << i);
+        }
+
+    //  Let server policy shed established connections (e.g. idle ones)
+    if ((_policy != 0) && ((now - _policyMS) >= ESP_POLICY_PERIOD_MS))
     {
-        int i = ipFlag;
-        memset(_ipStr, 0, 16);
-        while(((rxBuffer[i] == '.') || isdigit(rxBuffer[i])) && (i < rxLen))
-            { _ipStr[i-ipFlag] = rxBuffer[i]; i++; }
+        _policyMS = now;
+        for (i = 0; i < ESP_MAX_CLI; i++)
+        {
+            _espClient *cli = GetClientBySockID(i);
 
-        _ipAddress = _IPtoInt(_ipStr);
-        retVal |= ESP_GOT_IP;
+            if ((cli != 0) && cli->_accepted && cli->_alive &&
+                !_policy(cli, false, _policyCtx))
+                cli->Close();
+        }
     }
-    //  TCP incoming data embedded, extract it
-    //  Data format:> +IPD,socketID,length:message
-    if (respFlag >= 0)
+
+    //  Pull data waiting in ESP for sockets whose consumer has room for it
+    if (_passiveRx)
+        for (i = 0; i < ESP_MAX_CLI; i++)
+            if ((_clients[i] != 0) && (_clients[i]->_rxAvail > 0) &&
+                ((custHook != 0) || (custHookEx != 0) ||
+                 (_clients[i]->_handler != 0) || !_clients[i]->_respRdy))
+                _RxPull(GetClientBySockID(i));
+    i = 0;
+
+    while (i < _retryQLen)
     {
-        int i;
-        //  Get client who sent the incoming data (based on socket ID)
-        _espClient *cli = const_cast<_espClient*>(_clients[_IDtoIndex(rxBuffer[respFlag] - 48)]);
+        _espRetryEntry &ent = _retryQ[i];
+        uint32_t status;
+
+        //  Socket got closed in the meantime, drop the data
+        if (GetClientBySockID(ent.sockID) != ent.cli)
+        {
+            _RetryDequeue(i);
+            continue;
+        }
+        //  Preserve order of data within a socket, and wait for backoff
+        if ((blocked & (1 << ent.sockID)) || ((int32_t)(now - ent.dueMS) < 0))
+        {
+            blocked |= (1 << ent.sockID);
+            i++;
+            continue;
+        }
 
-        //  respFlag points to socket ID (single digit < 5)
-        i = respFlag+2; //Skip comma and go to first digit of length
-        //  Colon marks beginning of the message, everything before it and after
-        //  the current position(i) are digits of message length
-        uint8_t cmsgLen[3] = {0};
-        //  Extract message length
-        while(rxBuffer[i++] != ':') //  ++ here so colon is skipped when done
-            cmsgLen[i-1-respFlag-2] = rxBuffer[i-1];
-        //  Convert message length string to int and save it
-        cli->RespLen = (uint16_t)lroundf(stof(cmsgLen, i-1-respFlag));
-        // i now points to the first char of the actual received message
-        //  Use raspFlag to mark starting point
-        respFlag = i;
-        //  Loop until the end of received message
-        while((i-respFlag) < cli->RespLen)
+        //  Data held back by rate limiter waits for tokens, not backoff
+        if (!_RateAllow(ent.cli, ent.len, 0))
         {
-            cli->RespBody[i - respFlag] = rxBuffer[i];
+            blocked |= (1 << ent.sockID);
             i++;
+            continue;
+        }
+
+        if (ent.rejected)
+            _cmdStats[ESP_CMD_CIPSEND].retries++;
+        status = ent.cli->_Send(ent.buf, ent.len);
+
+        if (_IsBusyOnly(status) && (ent.attempt < ESP_BUSY_MAX_RETRY))
+        {
+            ent.attempt++;
+            ent.rejected = true;
+            ent.dueMS = HAL_GetMS() + _BackoffMS(ent.attempt);
+            blocked |= (1 << ent.sockID);
+            i++;
+        }
+        else
+        {
+            if (_IsBusyOnly(status))
+                _cmdStats[ESP_CMD_CIPSEND].giveUp++;
+            _RetryDequeue(i);
         }
-        //  Set flag that new response has been received
-        cli->_respRdy = true;
     }
 
-    return retVal;
+    //  Send merged small writes which waited long enough
+    for (i = 0; i < ESP_MAX_CLI; i++)
+    {
+        _espClient *cli = GetClientBySockID(i);
+
+        if ((cli != 0) && (cli->_coalLen > 0) &&
+            ((HAL_GetMS() - cli->_coalStartMS) >= cli->_coalDelayMS))
+            cli->Flush();
+    }
+
+    _TxRun(ESP_TXQ_BURST);
 }
 
 ///-----------------------------------------------------------------------------
 ///                      Class constructor & destructor              [PROTECTED]
 ///-----------------------------------------------------------------------------
 
-ESP8266::ESP8266() : custHook(0), flowControl(ESP_NO_STATUS), _tcpServPort(0),
-                     _ipAddress(0), _servOpen(false), wifiStatus(0)
+/**
+ * Create driver for ESP module connected to a given port
+ * Hardware isn't touched until InitHW is called. Use GetI() for the default
+ * module, other instances must each be given a different port.
+ * @param port HAL port (UART, watchdog timer, pins) ESP is connected to
+ */
+ESP8266::ESP8266(HAL_ESP_Port *port)
+                   : flowControl(ESP_NO_STATUS), wifiStatus(0), _port(port),
+                     _inst(0xFF), _rxLen(0), _ready(false),
+                     _bootMS(0), _offMS(0), custHook(0),
+                     custHookEx(0), _acceptCb(0), _acceptCtx(0), _closeCb(0),
+                     _closeCtx(0), _policy(0), _policyCtx(0), _evictMask(0),
+                     _policyMS(0), _openID(0xFF),
+                     _openHandler(0), _openCtx(0), _tcpServPort(0),
+                     _ipAddress(0), _servOpen(false),
+                     _servMaxConn(ESP_MAX_CLI), _servIdleS(0),
+                     _wdFired(false), _rtoEnabled(true), _retryQLen(0),
+                     _rndState(1), _baud(ESP_DEF_BAUD),
+                     _defBaud(ESP_DEF_BAUD), _echoCapture(false),
+                     _flowCtrl(false), _ptMode(false), _ptLastTxMS(0),
+                     _sbSegCapture(false), _sbSegID(0), _sbSegAcked(0),
+                     _passiveRx(false), _rxPullID(0), _dinfo(false),
+                     _cfgSkips(0), _joinTiming(false), _joinWarm(false),
+                     _joinStartMS(0), _joinQuery(false), _pendSeq(0),
+                     _wdSlot(-1), _wdSeq(0), _evHead(0), _evTail(0),
+                     _txHoldMS(0), _txBusyN(0)
 {
+    memset((void*)_pend, 0, sizeof(_pend));
+    memset((void*)&_join, 0, sizeof(_join));
+    _CfgForget(true);
+    ResetCmdStats();
+    ResetTxStats();
+    memset((void*)_txRR, 0, sizeof(_txRR));
+    memset((void*)&_rate, 0, sizeof(_rate));
+    //  Reset timeout estimators and set default bounds
+    memset((void*)_rto, 0, sizeof(_rto));
+    for (uint8_t i = 0; i < ESP_CMD_NUM; i++)
+    {
+        _rto[i].minMS = _espRTOMinMS[i];
+        _rto[i].maxMS = 0xFFFF;
+    }
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_UNINITIALIZED);
 #endif  /* __HAL_USE_EVENTLOG__ */
@@ -734,23 +1800,850 @@ ESP8266::ESP8266() : custHook(0), flowControl(ESP_NO_STATUS), _tcpServPort(0),
 
 ESP8266::~ESP8266()
 {
-    Enable(false);
-}
+    //  Port is only owned by instance which has initialized it
+    if (_inst >= ESP_MAX_INST)
+        return;
+
+    Enable(false);
+    //  Release ISRs so they can serve another instance
+    HAL_ESP_IntEnable(_port, false);
+    _espInst[_inst] = 0;
+}
+
+///-----------------------------------------------------------------------------
+///                      Miscellaneous functions                     [PROTECTED]
+///-----------------------------------------------------------------------------
+
+/**
+ * Set one of ESP settings kept in configuration shadow (_cfg)
+ * Command is only sent if shadow doesn't say setting already has this value.
+ * If command fails the setting is forgotten.
+ * @param setting member of _cfg holding the setting
+ * @param value new value of the setting
+ * @param cmd null-terminated command which sets [value]
+ * @return error code, ESP_STATUS_OK if command was skipped
+ */
+uint32_t ESP8266::_SetConfig(int32_t &setting, int32_t value, const char *cmd)
+{
+    uint32_t retVal;
+
+    if (setting == value)
+    {
+        _cfgSkips++;
+        return ESP_STATUS_OK;
+    }
+
+    retVal = _SendRAW(cmd);
+    if (_InStatus(retVal, ESP_STATUS_OK))
+        setting = value;
+    else
+        setting = ESP_CFG_UNKNOWN;
+
+    return retVal;
+}
+
+/**
+ * Forget settings kept in configuration shadow
+ * @param all true: forget all settings, false: forget only settings which ESP
+ * loses on restart (all but those saved in its flash)
+ */
+void ESP8266::_CfgForget(bool all)
+{
+    _cfg.echo = ESP_CFG_UNKNOWN;
+    _cfg.mux = ESP_CFG_UNKNOWN;
+    _cfg.servPort = ESP_CFG_UNKNOWN;
+    _cfg.servTO = ESP_CFG_UNKNOWN;
+    _cfg.maxConn = ESP_CFG_UNKNOWN;
+    if (all)
+        _cfg.mode = ESP_CFG_UNKNOWN;
+}
+
+/**
+ * Wait for ESP to boot after it has been powered up
+ * ESP prints "ready" once it accepts commands. If it doesn't come (banner got
+ * garbled, or firmware doesn't print it) ESP is probed with "AT" after
+ * ESP_BOOT_PROBE_MS. Waiting is given up after ESP_BOOT_MAX_MS.
+ * @return true: if ESP has booted
+ *        false: if ESP didn't respond in time
+ */
+bool ESP8266::_WaitReady()
+{
+    uint32_t start = HAL_GetMS();
+    bool ready = false;
+
+    _ready = false;
+    _rxLen = 0;
+    HAL_ESP_IntEnable(_port, true);
+
+    while (!ready && ((HAL_GetMS() - start) < ESP_BOOT_MAX_MS))
+    {
+        if ((HAL_GetMS() - start) >= ESP_BOOT_PROBE_MS)
+            ready = _InStatus(_SendRAW("AT\0", 0,
+                                       ESP_BOOT_PROBE_TO_MS), ESP_STATUS_OK);
+        else
+            HAL_DelayUS(1000);
+        ready |= _ready;
+    }
+
+    _bootMS = HAL_GetMS() - start;
+    _ready = ready;
+
+    return ready;
+}
+
+/**
+ * Switch ESP and UART port to a new baud-rate
+ * ESP replies to AT+UART_CUR at the old rate and only then switches to the new
+ * one, so port is reinitialized once the reply has been received.
+ * @param baud new baud-rate
+ * @return status of AT+UART_CUR command, port is only reinitialized if it is
+ * ESP_STATUS_OK
+ */
+uint32_t ESP8266::_SetBaud(uint32_t baud)
+{
+    uint8_t numStr[12] = {0};
+    uint32_t retVal;
+
+    //  8 data bits, 1 stop bit, no parity, RTS/CTS flow control (3) or none
+    memset((void*)_commBuf, 0, sizeof(_commBuf));
+    strcat(_commBuf, "AT+UART_CUR=");
+    itoa(baud, numStr);
+    strcat(_commBuf, (char*)numStr);
+    strcat(_commBuf, (_flowCtrl ? ",8,1,0,3\0" : ",8,1,0,0\0"));
+
+    retVal = _SendRAW(_commBuf, 0, 200);
+    if (!_InStatus(retVal, ESP_STATUS_OK))
+        return retVal;
+
+    //  Reinitializing the port resets UART peripheral, register ISR again
+    while(HAL_ESP_UARTBusy(_port));
+    HAL_ESP_InitPort(_port, baud);
+    HAL_ESP_RegisterIntHandler(_port, _espRxISR[_inst]);
+    _baud = baud;
+
+    return retVal;
+}
+
+/**
+ * Restart ESP chip and resume communication at its default baud-rate
+ * Echo is turned off and multiple connections are allowed again, as in InitHW,
+ * flow control is enabled again if it was in use
+ */
+void ESP8266::_RestartAtDefBaud()
+{
+    Enable(false);
+    //  ESP starts without flow control
+    if (_flowCtrl)
+        HAL_ESP_FlowControl(_port, false);
+    //  Port has to be at default baud-rate to see ESP reporting it's ready
+    HAL_ESP_InitPort(_port, _defBaud);
+    HAL_ESP_RegisterIntHandler(_port, _espRxISR[_inst]);
+    _baud = _defBaud;
+    Enable(true);
+
+    if (!_ready)
+        _SendRAW("AT\0");
+    _SetConfig(_cfg.echo, 0, "ATE0\0");
+    _SetConfig(_cfg.mux, 1, "AT+CIPMUX=1\0");
+    if (_flowCtrl)
+        FlowControl(true);
+}
+
+/**
+ * Check quality of the link at the current baud-rate
+ * With echo turned on, ESP returns every command it receives. Each test round
+ * sends a command carrying random payload (which ESP rejects as unknown) and
+ * compares CRC of the echoed command with the one sent. Link passes if all
+ * rounds are echoed back without errors.
+ * @param result structure to store the outcome of the test in
+ * @return true: if all test rounds passed
+ *        false: otherwise
+ */
+bool ESP8266::_LinkTest(_espLinkTest *result)
+{
+    static const char charset[] =
+            "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    char cmd[ESP_BAUD_TEST_LEN + 12];
+    uint16_t cmdLen;
+    uint32_t status;
+
+    //  Turn echo on, this is also the first check of the link
+    status = _SendRAW("ATE1\0", 0, 100);
+    _cfg.echo = (_InStatus(status, ESP_STATUS_OK) ? 1 : ESP_CFG_UNKNOWN);
+    if (!_InStatus(status, ESP_STATUS_OK))
+    {
+        result->errors++;
+        return false;
+    }
+
+    for (uint8_t i = 0; i < ESP_BAUD_TEST_ROUNDS; i++)
+    {
+        //  Assemble test command with random payload
+        memset((void*)cmd, 0, sizeof(cmd));
+        strcat(cmd, "AT+LINKTEST=");
+        cmdLen = strlen(cmd);
+        while (cmdLen < (sizeof(cmd) - 1))
+            cmd[cmdLen++] = charset[_Rand() % (sizeof(charset) - 1)];
+
+        _echoLen = 0;
+        _echoCapture = true;
+        status = _SendRAW(cmd, 0, 100);
+        _echoCapture = false;
+
+        result->rounds++;
+        //  Command has to be echoed back unchanged and answered
+        if (_InStatus(status, ESP_NORESPONSE) ||
+            !(status & (ESP_STATUS_OK | ESP_STATUS_ERROR)) ||
+            (_echoLen != cmdLen) || (_echoCRC != _CRC16(cmd, cmdLen)))
+            result->errors++;
+    }
+
+    //  Turn echo back off
+    status = _SendRAW("ATE0\0", 0, 100);
+    _cfg.echo = (_InStatus(status, ESP_STATUS_OK) ? 0 : ESP_CFG_UNKNOWN);
+    if (!_InStatus(status, ESP_STATUS_OK))
+        result->errors++;
+
+    return (result->errors == 0);
+}
+
+/**
+ * Calculate CRC-16/CCITT checksum of given data
+ * @param data data to calculate checksum of
+ * @param len length of [data]
+ * @return checksum
+ */
+uint16_t ESP8266::_CRC16(const char *data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)((uint8_t)*data++) << 8;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+    }
+
+    return crc;
+}
+
+/**
+ * Get next number from pseudo-random generator (xorshift32)
+ * @return pseudo-random number
+ */
+uint32_t ESP8266::_Rand()
+{
+    _rndState ^= _rndState << 13;
+    _rndState ^= _rndState >> 17;
+    _rndState ^= _rndState << 5;
+
+    return _rndState;
+}
+
+/**
+ * Check whether the [flag]s are set in the [status] message
+ * @param status to check for flags
+ * @param flag bitwise OR of ESP_STATUS_* values to look for in status
+ * @return true: if ALL flags are set in status
+ *        false: if at least on flag is not set in status
+ */
+bool ESP8266::_InStatus(const uint32_t status, const uint32_t flag)
+{
+    return ((status & flag) > 0);
+}
+
+/**
+ * Classify a single line received from ESP and act on it
+ * Only whole lines are matched against known messages (with the exception of
+ * prefix of "busy..." message), text within a line is never searched for
+ * keywords.
+ * @param line pointer to first char of the line (not null-terminated)
+ * @param len length of the line excluding \r\n terminator
+ * @return ESP_STATUS_* value for the line, ESP_NO_STATUS if it's not known
+ */
+uint32_t ESP8266::_ParseLine(const char *line, uint16_t len)
+{
+    uint32_t nums[2];
+    uint16_t numLen;
+
+    //  Empty lines are used by ESP as separators
+    if (len == 0)
+        return ESP_NO_STATUS;
+
+    //  Echo of link test command, only its checksum is of interest. ESP
+    //  echoes command with the \r it received, followed by \r\n
+    if (_echoCapture && (len > 3) && (strncmp(line, "AT+", 3) == 0))
+    {
+        while ((len > 0) && (line[len - 1] == '\r'))
+            len--;
+        _echoCRC = _CRC16(line, len);
+        _echoLen = len;
+        return ESP_NO_STATUS;
+    }
+
+    //  Terminal statuses of commands
+    if (_LineIs(line, len, "OK"))
+        return ESP_STATUS_OK;
+    if (_LineIs(line, len, "ERROR"))
+        return ESP_STATUS_ERROR;
+    if (_LineIs(line, len, "FAIL") || _LineIs(line, len, "SEND FAIL"))
+        return ESP_STATUS_FAIL;
+    if (_LineIs(line, len, "SEND OK"))
+        return ESP_STATUS_SENDOK;
+    //  ESP replies "busy p..." (processing) or "busy s..." (sending)
+    if ((len >= 5) && (strncmp(line, "busy ", 5) == 0))
+        return ESP_STATUS_BUSY;
+    //  Prompt for socket data ("> " without terminator)
+    if (line[0] == '>')
+        return ESP_STATUS_RECV;
+
+    //  WiFi status messages
+    if (_LineIs(line, len, "WIFI CONNECTED"))
+    {
+        wifiStatus = ESP_WIFI_CONNECTING;
+        _EventPush(ESP_EV_WIFICONN, 0);
+        return ESP_STATUS_CONNECTED;
+    }
+    if (_LineIs(line, len, "WIFI GOT IP"))
+    {
+        wifiStatus = ESP_WIFI_CONNECTED;
+        _JoinDone();
+        if (_join.enabled && _join.ipSaved)
+            _JoinIP();
+        _EventPush(ESP_EV_WIFIGOTIP, 0);
+        return ESP_NO_STATUS;
+    }
+    if (_LineIs(line, len, "WIFI DISCONNECT"))
+    {
+        _EventPush(ESP_EV_WIFIDISCN, 0);
+        return ESP_STATUS_DISCN;
+    }
+    if (_LineIs(line, len, "ready") || _LineIs(line, len, "READY"))
+    {
+        _ready = true;
+        _CfgForget(false);
+        return ESP_STATUS_READY;
+    }
+    if (_LineIs(line, len, "SUCCESS"))
+        return ESP_RESPOND_SUCC;
+
+    //  Reply to AT+CIPSENDBUF: "<segment ID>,<last segment ID sent>"
+    if (_sbSegCapture && (_LineNums(line, len, nums, 2) == len))
+    {
+        _sbSegID = nums[0];
+        _sbSegAcked = nums[1];
+        return ESP_NO_STATUS;
+    }
+
+    //  Buffered segment sent (or failed): "<id>,<segment ID>,SEND OK/FAIL"
+    numLen = _LineNums(line, len, nums, 2);
+    if ((numLen > 0) && (nums[0] < ESP_MAX_CLI))
+    {
+        _espClient *cli = GetClientBySockID(nums[0]);
+        bool ok = _LineIs(line + numLen, len - numLen, ",SEND OK");
+
+        if (ok || _LineIs(line + numLen, len - numLen, ",SEND FAIL"))
+        {
+            if (cli != 0)
+            {
+                //  Segments are sent in order, acknowledgment is cumulative
+                if (nums[1] > cli->_segAcked)
+                    cli->_segAcked = nums[1];
+                if (!ok)
+                    cli->_segFailed++;
+            }
+            _EventPush(ok ? ESP_EV_SEGACK : ESP_EV_SEGFAIL, nums[0]);
+            return ESP_NO_STATUS;
+        }
+    }
+
+    //  Socket opened/closed: "<id>,CONNECT" or "<id>,CLOSED"
+    if (isdigit(line[0]) && (_IDtoIndex(line[0] - 48) < ESP_MAX_CLI))
+    {
+        uint8_t id = line[0] - 48;
+
+        if (_LineIs(line + 1, len - 1, ",CONNECT"))
+        {
+            //  Socket got opened, create new client for it
+            if (_clients[id] == 0)
+            {
+                _espClient *cli = new _espClient(id, this);
+
+                _clients[id] = cli;
+                //  Socket opened by this library gets the handler it was
+                //  opened with, anything else is a connection to the server
+                if (id == _openID)
+                    cli->SetHandler(_openHandler, _openCtx);
+                else
+                {
+                    cli->_accepted = true;
+                    if ((_policy != 0) && !_policy(cli, true, _policyCtx))
+                        Evict(id);
+                    else if (_acceptCb != 0)
+                        _acceptCb(cli, _acceptCtx);
+                }
+            }
+            _EventPush(ESP_EV_SOCKOPEN, id);
+            return ESP_STATUS_SOCKOPEN;
+        }
+        if (_LineIs(line + 1, len - 1, ",CLOSED"))
+        {
+            //  Socket got closed, find client with this ID and delete it
+            _DropClient(id);
+            return ESP_STATUS_SOCKCLOSE;
+        }
+    }
+
+    //  Joining AP failed ("+CWJAP:<error code>"), if AP was joined with
+    //  cached parameters they might be stale
+    if ((len > 7) && (strncmp(line, "+CWJAP:", 7) == 0))
+    {
+        if (_joinTiming && _joinWarm)
+            _join.cached = false;
+        _joinTiming = false;
+        return ESP_NO_STATUS;
+    }
+    //  Parameters of AP currently joined (+CWJAP_CUR:"ssid","bssid",ch,rssi)
+    if ((len > 11) && (strncmp(line, "+CWJAP_CUR:", 11) == 0))
+    {
+        _JoinCache(line, len);
+        return ESP_NO_STATUS;
+    }
+
+    //  IP address embedded in reply to a query (+CIPSTA:ip:"x.x.x.x"),
+    //  extract it
+    if ((line[0] == '+') && (len > 4))
+        for (uint16_t i = 0; i < (len - 4); i++)
+            if (strncmp(line + i, "ip:\"", 4) == 0)
+            {
+                uint16_t j = 0;
+                i += 4;
+                memset(_ipStr, 0, sizeof(_ipStr));
+                while ((i < len) && (j < (sizeof(_ipStr) - 1)) &&
+                       ((line[i] == '.') || isdigit(line[i])))
+                    _ipStr[j++] = line[i++];
+
+                _ipAddress = _IPtoInt(_ipStr);
+                return ESP_GOT_IP;
+            }
+
+    return ESP_NO_STATUS;
+}
+
+/**
+ * Check if line received from ESP is exactly equal to given message
+ * @param line pointer to first char of the line (not null-terminated)
+ * @param len length of the line excluding \r\n terminator
+ * @param msg null-terminated message to compare line with
+ * @return true: if line and message are equal
+ *        false: otherwise
+ */
+bool ESP8266::_LineIs(const char *line, uint16_t len, const char *msg)
+{
+    return ((strlen(msg) == len) && (strncmp(line, msg, len) == 0));
+}
+
+/**
+ * Parse comma-separated unsigned numbers at the beginning of a line
+ * @param line pointer to first char of the line (not null-terminated)
+ * @param len length of the line excluding \r\n terminator
+ * @param nums array to store parsed numbers in
+ * @param n number of numbers to parse
+ * @return number of chars taken by [n] numbers (and commas between them), 0 if
+ * line doesn't start with [n] numbers
+ */
+uint16_t ESP8266::_LineNums(const char *line, uint16_t len, uint32_t *nums,
+                            uint8_t n)
+{
+    uint16_t pos = 0;
+
+    for (uint8_t i = 0; i < n; i++)
+    {
+        //  Numbers are separated by a single comma
+        if (i > 0)
+        {
+            if ((pos >= len) || (line[pos] != ','))
+                return 0;
+            pos++;
+        }
+        //  Each number has at least one digit
+        if ((pos >= len) || !isdigit(line[pos]))
+            return 0;
+        nums[i] = 0;
+        while ((pos < len) && isdigit(line[pos]))
+            nums[i] = nums[i] * 10 + (line[pos++] - 48);
+    }
+
+    return pos;
+}
+
+/**
+ * Check if there's a frame of socket data at given position in the buffer
+ * Frame has format: +IPD,<socket ID>,<length>:<data> (pushed by ESP) or
+ * +CIPRECVDATA,<length>:<data> (reply to AT+CIPRECVDATA in passive mode), where
+ * data is exactly <length> bytes long. In passive mode ESP only notifies about
+ * new data with +IPD,<socket ID>,<length>\r\n. With AT+CIPDINFO=1 +IPD header
+ * also carries remote IP and port: +IPD,<socket ID>,<length>,<IP>,<port>:
+ * @param buf buffer containing data received from ESP
+ * @param len length of data in [buf]
+ * @param pos position in [buf] at which to look for the frame
+ * @param ipd structure filled with description of the frame
+ * @return 0 if there is no frame at [pos],
+ *        -1 if there is a frame, but it has not been received completely,
+ *         1 if there is a complete frame
+ */
+int8_t ESP8266::_IPDFrame(const char *buf, uint16_t len, uint16_t pos,
+                          _espIPD *ipd)
+{
+    static const char *header[2] = { "+IPD,", "+CIPRECVDATA," };
+    //  Numeric fields of header in order they appear (IP address excluded)
+    uint32_t field[4] = {0, 0, 0, 0};
+    uint8_t fieldN = 0;
+    //  Remote IP address is the only field containing dots
+    uint32_t ip = 0;
+    bool ipField = false, hasIP = false;
+    uint8_t h, hLen = 0;
+    uint16_t i;
+
+    //  Incomplete header describes no data, rest of buffer belongs to frame
+    ipd->sockID = 0xFF;
+    ipd->dataPos = len;
+    ipd->dataLen = 0;
+    ipd->lenOnly = false;
+    ipd->remoteIP = 0;
+    ipd->remotePort = 0;
+
+    //  Check for header, allow for it to be cut short at the end of buffer
+    for (h = 0; h < 2; h++)
+    {
+        hLen = strlen(header[h]);
+        for (i = 0; i < hLen; i++)
+            if (((pos + i) >= len) || (buf[pos + i] != header[h][i]))
+                break;
+        if (i == hLen)
+            break;
+        if (((pos + i) >= len) && (i > 0))
+            return -1;
+    }
+    if (h >= 2)
+        return 0;
+
+    //  Parse fields of header up to colon that precedes the data (or up to the
+    //  end of line of length-only notification)
+    for (i = pos + hLen; (i < len) && (buf[i] != ':') && (buf[i] != '\r'); i++)
+    {
+        if ((buf[i] == ',') || (buf[i] == '.'))
+        {
+            //  Octet of IP address is complete, field is reused for next one
+            if ((buf[i] == '.') || ipField)
+            {
+                ip = (ip << 8) | (field[fieldN] & 0xFF);
+                field[fieldN] = 0;
+                ipField = hasIP = true;
+            }
+            //  Next field starts, IP address doesn't take a numeric field
+            if ((buf[i] == ',') && !ipField && (++fieldN >= 4))
+                return 0;
+            if (buf[i] == ',')
+                ipField = false;
+        }
+        else if (isdigit(buf[i]))
+        {
+            //  Saturate instead of overflowing on bogus lengths
+            if (field[fieldN] < 0x10000)
+                field[fieldN] = field[fieldN] * 10 + (buf[i] - 48);
+        }
+        else
+            return 0;
+    }
+    //  Header not received completely
+    if (i >= len)
+        return -1;
+
+    //  Remote port is the last field, following the IP address
+    if (hasIP)
+    {
+        if (ipField || (fieldN == 0))
+            return 0;
+        ipd->remoteIP = ip;
+        ipd->remotePort = (field[fieldN] > 0xFFFF) ? 0 : field[fieldN];
+        fieldN--;
+    }
+
+    //  Pulled data belongs to the socket it was requested from, with a single
+    //  connection there's no socket ID in the header
+    if (fieldN == 0)
+    {
+        ipd->sockID = (h == 1) ? _rxPullID : 0;
+        ipd->dataLen = (field[0] > 0xFFFF) ? 0xFFFF : field[0];
+    }
+    else if (fieldN == 1)
+    {
+        ipd->sockID = (field[0] > 0xFF) ? 0xFF : field[0];
+        ipd->dataLen = (field[1] > 0xFFFF) ? 0xFFFF : field[1];
+    }
+    else
+        return 0;
+
+    //  Notification only, data is waiting in ESP to be pulled
+    if (buf[i] == '\r')
+    {
+        ipd->lenOnly = true;
+        ipd->dataPos = i;
+        return 1;
+    }
+    ipd->dataPos = i + 1;
+
+    return (((uint32_t)ipd->dataPos + ipd->dataLen) <= len) ? 1 : -1;
+}
+
+/**
+ * Pull data waiting in ESP for given socket (passive receive mode)
+ * Data arrives as +CIPRECVDATA frame and is passed on the same way as data
+ * pushed with +IPD
+ * @param cli client to pull data for
+ * @return status of AT+CIPRECVDATA command
+ */
+uint32_t ESP8266::_RxPull(_espClient *cli)
+{
+    uint8_t numStr[6] = {0};
+    uint16_t len = cli->_rxAvail;
+
+    //  Pull at most what fits into receive buffer together with echo of the
+    //  command, +CIPRECVDATA header and OK that follows data
+    if (len > (sizeof(_rxBuf) / 2))
+        len = sizeof(_rxBuf) / 2;
+
+    memset(_commBuf, 0, sizeof(_commBuf));
+    strcat(_commBuf, "AT+CIPRECVDATA=");
+    itoa(cli->_id, numStr);
+    strcat(_commBuf, (char*)numStr);
+    strcat(_commBuf, ",");
+    memset(numStr, 0, sizeof(numStr));
+    itoa(len, numStr);
+    strcat(_commBuf, (char*)numStr);
+
+    //  Reply doesn't carry socket ID, parser takes it from here
+    _rxPullID = cli->_id;
+    return _SendRAW(_commBuf);
+}
+
+/**
+ * Check if buffer of data received from ESP contains only complete messages
+ * and is ready to be parsed. Message is complete when it is a line terminated
+ * with \r\n, a '> ' prompt at the end of buffer or a +IPD frame whose data has
+ * been received completely.
+ * @param buf buffer containing data received from ESP
+ * @param len length of data in [buf]
+ * @return true: if buffer can be parsed
+ *        false: if more data is expected
+ */
+bool ESP8266::_RxComplete(const char *buf, uint16_t len)
+{
+    uint16_t pos = 0, end;
+
+    while (pos < len)
+    {
+        _espIPD ipd;
+        int8_t frame = _IPDFrame(buf, len, pos, &ipd);
+
+        if (frame < 0)
+            return false;
+        if (frame > 0)
+        {
+            pos = ipd.dataPos + ipd.dataLen;
+            continue;
+        }
+
+        //  Look for end of the line, unterminated line stays at [pos]
+        end = pos;
+        while (((end + 1) < len) && !((buf[end] == '\r') && (buf[end + 1] == '\n')))
+            end++;
+        if ((end + 1) >= len)
+            break;
+        pos = end + 2;
+    }
+
+    //  Either everything is consumed, or only '> ' prompt is left (without
+    //  space when entering passthrough)
+    return ((pos >= len) ||
+            (((pos + 2) == len) && (buf[pos] == '>') && (buf[pos + 1] == ' ')) ||
+            (((pos + 1) == len) && (buf[pos] == '>')));
+}
+
+/**
+ * Pass data received on a socket to user-defined hook function (or schedule
+ * it to be passed if using task scheduler)
+ * @param cli client which received data
+ */
+void ESP8266::_DeliverRx(_espClient *cli)
+{
+    if ((cli->_handler == 0) && (custHook == 0) && (custHookEx == 0))
+        return;
+    //  Socket is being closed by server policy, nobody expects its data
+    if (_evictMask & (1 << cli->_id))
+        return;
+
+#if defined(__USE_TASK_SCHEDULER__)
+    //  If using task scheduler, schedule receiving outside this ISR
+    volatile TaskEntry tE(ESP_UID, ESP_T_RECVSOCK, 0);
+    tE.AddArg(&cli->_id, 1);
+    TaskScheduler::GetP()->SyncTask(tE);
+#else
+    //  If no task scheduler do everything in here
+    _CallHandler(cli);
+#endif  /* __USE_TASK_SCHEDULER__ */
+}
+
+/**
+ * Pass data received on a socket to its handler, or to the global hook if the
+ * socket has no handler
+ * @param cli client data was received on
+ */
+void ESP8266::_CallHandler(_espClient *cli)
+{
+    if (cli->_handler != 0)
+        cli->_handler(cli, (const uint8_t*)cli->RespBody, cli->RespLen,
+                      cli->_handlerCtx);
+    else if (custHookEx != 0)
+        custHookEx(cli->_id, (const uint8_t*)cli->RespBody, (cli->RespLen),
+                   cli->_remoteIP, cli->_remotePort);
+    else if (custHook != 0)
+        custHook(cli->_id, (const uint8_t*)cli->RespBody, (cli->RespLen));
+}
+
+/**
+ * Delete client of a socket which got closed, after passing it to close
+ * callback
+ * @param id socket ID of the closed socket
+ */
+void ESP8266::_DropClient(uint8_t id)
+{
+    _espClient *cli = GetClientBySockID(id);
+
+    if ((cli != 0) && (_closeCb != 0))
+        _closeCb(cli, _closeCtx);
+    //  Data still queued for transmit scheduler is lost with the socket
+    if (cli != 0)
+        for (uint8_t p = 0; p < ESP_PRIO_NUM; p++)
+            _txStats[p].dropped += cli->_txqLen[p];
+    _evictMask &= ~(1 << id);
+    delete _clients[id];
+    _clients[id] = 0;
+    _EventPush(ESP_EV_SOCKCLOSE, id);
+}
+
+/**
+ * Determine type of command (used for statistics) from the command string
+ * @param txBuffer null-terminated string with command sent to ESP
+ * @return one of ESP_CMD_* values
+ */
+uint8_t ESP8266::_CmdType(const char* txBuffer)
+{
+    if (strncmp(txBuffer, "AT+CWJAP", 8) == 0)
+    {
+        uint16_t len = strlen(txBuffer);
+
+        //  Query of joined AP is as quick as any other command
+        if (txBuffer[len - 1] == '?')
+            return ESP_CMD_GENERIC;
+        //  Warm join ends with BSSID: ..."xx:xx:xx:xx:xx:xx"
+        if ((len > 20) && (txBuffer[len - 20] == ',') &&
+            (txBuffer[len - 19] == '"') && (txBuffer[len - 16] == ':') &&
+            (txBuffer[len - 4] == ':'))
+            return ESP_CMD_CWJAPWARM;
+        return ESP_CMD_CWJAP;
+    }
+    if (strncmp(txBuffer, "AT+CIPSTART", 11) == 0)
+        return ESP_CMD_CIPSTART;
+    if (strncmp(txBuffer, "AT+CIPSEND", 10) == 0)
+        return ESP_CMD_CIPSEND;
+    if (strncmp(txBuffer, "AT+CIPCLOSE", 11) == 0)
+        return ESP_CMD_CIPCLOSE;
+    if (strncmp(txBuffer, "AT+CIPSERVER", 12) == 0)
+        return ESP_CMD_CIPSERVER;
+
+    return ESP_CMD_GENERIC;
+}
+
+/**
+ * Record outcome and latency of a command into statistics
+ * @param cmdType type of command, one of ESP_CMD_* values
+ * @param status bitwise OR of ESP_STATUS_* values received for the command
+ * @param startTick value of HAL_GetTicks() when command was written to ESP
+ */
+void ESP8266::_StatsRecord(uint8_t cmdType, uint32_t status, uint32_t startTick)
+{
+    uint32_t latUS = HAL_TicksToUS(HAL_GetTicks() - startTick);
+    _espCmdStats &st = _cmdStats[cmdType];
+    uint8_t bin;
 
-///-----------------------------------------------------------------------------
-///                      Miscellaneous functions                     [PROTECTED]
-///-----------------------------------------------------------------------------
+    st.count++;
+    if (_InStatus(status, ESP_STATUS_BUSY))
+        st.busy++;
+
+    _RTOUpdate(cmdType, status, latUS);
+
+    //  Watchdog timeout - there is no terminal status so latency is meaningless
+    if (_InStatus(status, ESP_NORESPONSE))
+    {
+        st.timeout++;
+        return;
+    }
+    if (_InStatus(status, ESP_STATUS_ERROR))
+        st.error++;
+    else if (_InStatus(status, ESP_STATUS_FAIL))
+        st.fail++;
+    else if (_InStatus(status, ESP_STATUS_OK | ESP_STATUS_SENDOK | ESP_STATUS_RECV))
+        st.ok++;
+
+    //  Update latency statistics
+    if (latUS < st.latMinUS) st.latMinUS = latUS;
+    if (latUS > st.latMaxUS) st.latMaxUS = latUS;
+    st.latSumUS += latUS;
+    //  Find histogram bin, last bin collects everything above the last limit
+    for (bin = 0; bin < (ESP_STAT_HIST_BINS - 1); bin++)
+        if (latUS < ((uint32_t)_espHistLimMS[bin] * 1000))
+            break;
+    st.hist[bin]++;
+}
 
 /**
- * Check whether the [flag]s are set in the [status] message
- * @param status to check for flags
- * @param flag bitwise OR of ESP_STATUS_* values to look for in status
- * @return true: if ALL flags are set in status
- *        false: if at least on flag is not set in status
+ * Update timeout estimator of a command type with new latency sample
+ * Follows RFC 6298: RTTVAR = 3/4*RTTVAR + 1/4*|SRTT - R|, SRTT = 7/8*SRTT + 1/8*R
+ * Samples of commands interrupted by watchdog are not used (there is no
+ * terminal status), instead timeout is doubled until next valid sample.
+ * @param cmdType type of command, one of ESP_CMD_* values
+ * @param status bitwise OR of ESP_STATUS_* values received for the command
+ * @param latUS latency of the command in us
  */
-bool ESP8266::_InStatus(const uint32_t status, const uint32_t flag)
+void ESP8266::_RTOUpdate(uint8_t cmdType, uint32_t status, uint32_t latUS)
 {
-    return ((status & flag) > 0);
+    _espRTOEst &est = _rto[cmdType];
+
+    if (_InStatus(status, ESP_NORESPONSE))
+    {
+        if (est.backoff < ESP_RTO_MAX_BACKOFF)
+            est.backoff++;
+        return;
+    }
+
+    if (est.samples == 0)
+    {
+        est.srttUS = latUS;
+        est.rttvarUS = latUS / 2;
+    }
+    else
+    {
+        uint32_t delta = (est.srttUS > latUS) ? (est.srttUS - latUS)
+                                              : (latUS - est.srttUS);
+        est.rttvarUS = (3 * est.rttvarUS + delta) / 4;
+        est.srttUS = (7 * est.srttUS + latUS) / 8;
+    }
+
+    if (est.samples < 0xFFFF)
+        est.samples++;
+    est.backoff = 0;
 }
 
 /**
@@ -759,55 +2652,545 @@ bool ESP8266::_InStatus(const uint32_t status, const uint32_t flag)
  * function, awaiting reply from ESP. Function returns when status OK or ERROR
  * or any other status passed in [flags] have been received from ESP. Timeout
  * is value at which watchdog timer interrupts the process and returns ERROR flag.
+ * If adaptive timeouts are enabled, timeout learned for this type of command is
+ * used instead, while [timeout] is its upper bound. Command rejected with
+ * "busy..." is not retried here (waiting for backoff would block the caller),
+ * ESP_STATUS_BUSY is returned and the command can be sent again later.
  * @param txBuffer null-terminated string with command to execute
  * @param flags bitwise OR of ESP_STATUS_* values
- * @param timeout time in ms before the sending process is interrupted by WD timer
+ * @param timeout max time in ms before the sending process is interrupted by WD
  * @return bitwise OR of ESP_STATUS_* returned by the ESP module
  */
 uint32_t ESP8266::_SendRAW(const char* txBuffer, uint32_t flags, uint32_t timeout)
 {
-    uint16_t txLen = 0;
+    uint16_t txLen;
+    uint32_t startTick, retVal;
+    uint32_t waitFor, absorb = ESP_NO_STATUS;
+    uint8_t cmdType = _CmdType(txBuffer);
+    int8_t slot;
+
+    //  In passthrough mode commands would be sent to the socket as data
+    if (_ptMode)
+        return ESP_STATUS_ERROR;
+
+    //  Shorten timeout to the one learned from latency of this command type
+    timeout = GetTimeout(cmdType, timeout);
+
+    //  Statuses terminating this command, if caller waits for '>' prompt then
+    //  OK preceding the prompt is only an intermediate status
+    waitFor = ESP_STATUS_OK | ESP_STATUS_ERROR | ESP_STATUS_FAIL |
+              ESP_STATUS_BUSY | (flags & ESP_TERMINAL_MASK);
+    //  "busy..." is never routed to a detached command
+    if (flags & ESP_NONBLOCKING_MODE)
+        waitFor &= ~(ESP_STATUS_BUSY);
+    if (flags & ESP_STATUS_RECV)
+    {
+        waitFor &= ~(ESP_STATUS_OK);
+        absorb = ESP_STATUS_OK;
+    }
 
-    HAL_ESP_WDControl(false, timeout);
+    HAL_ESP_WDControl(_port, false, timeout);
 
-    //  Reset global status
-    flowControl = ESP_NO_STATUS;
     //  Wait for any ongoing transmission then flush UART port
-    while(HAL_ESP_UARTBusy());
+    while(HAL_ESP_UARTBusy(_port));
     _FlushUART();
-    while(HAL_ESP_UARTBusy());
+    while(HAL_ESP_UARTBusy(_port));
 #ifdef __DEBUG_SESSION__
     DEBUG_WRITE("Sending: %s \n", txBuffer);
 #endif
+    //  Register command as pending before writing it so that the reply
+    //  always finds its entry. Nobody waits for non-blocking commands
+    slot = _PendPush(cmdType, waitFor, absorb,
+                     (flags & ESP_NONBLOCKING_MODE) > 0);
+    if (slot < 0)
+        return ESP_STATUS_ERROR;
     //  Send char-by-char until reaching end of command
+    txLen = 0;
     while (*(txBuffer + txLen) != '\0')
     {
-        HAL_ESP_SendChar(*(txBuffer + txLen));
+        HAL_ESP_SendChar(_port, *(txBuffer + txLen));
         txLen++;
     }
     //  ESP messages terminated by \r\n
-    HAL_ESP_SendChar('\r');
-    HAL_ESP_SendChar('\n');
+    HAL_ESP_SendChar(_port, '\r');
+    HAL_ESP_SendChar(_port, '\n');
+    startTick = HAL_GetTicks();
 
     //  Start listening for reply
-    HAL_ESP_IntEnable(true);
+    HAL_ESP_IntEnable(_port, true);
+
+    //  If non-blocking mode is enabled don't wait for status
+    if (flags & ESP_NONBLOCKING_MODE)
+        return ESP_NONBLOCKING_MODE;
+
+    //  Start watchdog timer
+    HAL_ESP_WDControl(_port, true, timeout);
+
+    //  Wait for terminal status, "busy..." also terminates the command
+    //  as ESP has dropped it
+    retVal = _PendWait(slot);
+
+    _StatsRecord(cmdType, retVal, startTick);
+    //  ESP might have restarted, its settings aren't known anymore
+    if (_InStatus(retVal, ESP_NORESPONSE))
+        _CfgForget(true);
+
+    HAL_DelayUS(1000);
+    //  Stop watchdog timer
+    HAL_ESP_WDControl(_port, false, timeout);
+
+    return retVal;
+}
+
+/**
+ * Register a command as pending (waiting for terminal status from ESP)
+ * @param cmdType type of command, one of ESP_CMD_* values
+ * @param waitFor bitwise OR of ESP_STATUS_* values which terminate the command
+ * @param absorb bitwise OR of ESP_STATUS_* values which are consumed by the
+ * command without terminating it
+ * @param detached[optional] nobody will wait for the command, entry is freed
+ * as soon as command is terminated
+ * @return index of entry in pending-command table, or -1 if table is full
+ */
+int8_t ESP8266::_PendPush(uint8_t cmdType, uint32_t waitFor, uint32_t absorb,
+                          bool detached)
+{
+    for (int8_t i = 0; i < ESP_PEND_LEN; i++)
+        if (!_pend[i].used)
+        {
+            _pend[i].done = false;
+            _pend[i].detached = detached;
+            _pend[i].cmdType = cmdType;
+            _pend[i].seq = _pendSeq++;
+            _pend[i].waitFor = waitFor;
+            _pend[i].absorb = absorb;
+            _pend[i].status = ESP_NO_STATUS;
+            //  Mark as used last, entry is now visible to ISR
+            _pend[i].used = true;
+            return i;
+        }
+
+    return -1;
+}
+
+/**
+ * Wait until pending command gets its terminal status and free its entry
+ * @param slot index of entry in pending-command table (from _PendPush)
+ * @return bitwise OR of ESP_STATUS_* received for the command
+ */
+uint32_t ESP8266::_PendWait(int8_t slot)
+{
+    uint32_t retVal;
+
+    while (!_pend[slot].done);
+
+    retVal = _pend[slot].status;
+    _pend[slot].used = false;
+
+    return retVal;
+}
+
+/**
+ * Check if there's any pending command somebody is waiting for (i.e. that was
+ * not sent in non-blocking mode)
+ * @return true: if there's a blocking command waiting for its terminal status
+ *        false: otherwise
+ */
+bool ESP8266::_PendWaiting()
+{
+    for (uint8_t i = 0; i < ESP_PEND_LEN; i++)
+        if (_pend[i].used && !_pend[i].done && !_pend[i].detached)
+            return true;
+
+    return false;
+}
+
+/**
+ * Find the oldest pending command which is waiting for (or absorbs) any of the
+ * statuses in [status]
+ * @param status bitwise OR of ESP_STATUS_* values
+ * @return index of entry in pending-command table, or -1 if there's none
+ */
+int8_t ESP8266::_PendOldest(uint32_t status)
+{
+    int8_t retVal = -1;
+
+    for (int8_t i = 0; i < ESP_PEND_LEN; i++)
+    {
+        if (!_pend[i].used || _pend[i].done)
+            continue;
+        if (!((_pend[i].waitFor | _pend[i].absorb) & status))
+            continue;
+        //  Compare age through difference so that wrap-around doesn't matter
+        if ((retVal < 0) || ((int32_t)(_pend[i].seq - _pend[retVal].seq) < 0))
+            retVal = i;
+    }
+
+    return retVal;
+}
+
+/**
+ * Find the newest blocking pending command (one somebody waits for), which
+ * hasn't been terminated yet
+ * @return index of entry in pending-command table, or -1 if there's none
+ */
+int8_t ESP8266::_PendBlocking()
+{
+    int8_t retVal = -1;
+
+    for (int8_t i = 0; i < ESP_PEND_LEN; i++)
+    {
+        if (!_pend[i].used || _pend[i].done || _pend[i].detached)
+            continue;
+        if ((retVal < 0) || ((int32_t)(_pend[i].seq - _pend[retVal].seq) > 0))
+            retVal = i;
+    }
+
+    return retVal;
+}
+
+/**
+ * Complete pending commands with statuses received from ESP
+ * Every terminal status completes the oldest command waiting for it, except
+ * "busy..." which rejects the command just sent, i.e. the newest blocking one.
+ * Other (non-terminal) statuses found in the same message are passed along.
+ * @param status bitwise OR of ESP_STATUS_* values parsed from ESP message
+ */
+void ESP8266::_PendComplete(uint32_t status)
+{
+    uint32_t terminal = status & ESP_TERMINAL_MASK;
+    uint32_t other = status & ~(ESP_TERMINAL_MASK);
+
+    //  Process terminal statuses one by one, lowest bit first
+    while (terminal)
+    {
+        uint32_t bit = terminal & (~terminal + 1);
+        int8_t slot = (bit == ESP_STATUS_BUSY) ? _PendBlocking()
+                                               : _PendOldest(bit);
+
+        terminal &= ~bit;
+        if (slot < 0)
+            continue;
+
+        _espPendCmd &cmd = _pend[slot];
+        cmd.status |= bit | other;
+        //  Intermediate status, command keeps waiting
+        if (!(cmd.waitFor & bit))
+            continue;
+
+        cmd.done = true;
+        if (cmd.detached)
+            cmd.used = false;
+    }
+}
+
+/**
+ * Put unsolicited event into the event queue (called from ISR)
+ * @param type type of event, one of ESP_EV_* values
+ * @param sockID socket ID the event refers to
+ */
+void ESP8266::_EventPush(uint8_t type, uint8_t sockID)
+{
+    uint8_t next = (_evHead + 1) % ESP_EVQ_LEN;
+
+    //  Queue full, drop event
+    if (next == _evTail)
+        return;
+
+    _evQ[_evHead].type = type;
+    _evQ[_evHead].sockID = sockID;
+    _evHead = next;
+}
+
+/**
+ * Check if ESP rejected the command with "busy..." without executing it
+ * @param status bitwise OR of ESP_STATUS_* values received for the command
+ * @return true: if "busy..." is the only outcome of the command
+ *        false: if command got its terminal status
+ */
+bool ESP8266::_IsBusyOnly(uint32_t status)
+{
+    return (_InStatus(status, ESP_STATUS_BUSY) &&
+           !_InStatus(status, ESP_STATUS_OK | ESP_STATUS_ERROR | ESP_STATUS_RECV));
+}
+
+/**
+ * Calculate time to wait before retrying a command rejected with "busy..."
+ * Backoff is doubled on every attempt, up to ESP_BUSY_MAX_MS, and a random
+ * jitter of up to half of the backoff is added to avoid retrying in lockstep
+ * @param attempt number of retries done so far
+ * @return backoff time in ms
+ */
+uint32_t ESP8266::_BackoffMS(uint8_t attempt)
+{
+    uint32_t backoff = ESP_BUSY_BASE_MS << attempt;
+
+    if ((attempt > 15) || (backoff > ESP_BUSY_MAX_MS))
+        backoff = ESP_BUSY_MAX_MS;
+
+    //  Pseudo-random jitter
+    return backoff + (_Rand() % (backoff / 2 + 1));
+}
+
+/**
+ * Put socket data rejected with "busy..." into retry queue (or data queued
+ * behind it, to preserve order of data within the socket)
+ * Data is copied into the queue, so caller's [buffer] (a stack buffer, or
+ * arguments of a scheduled task) can be reused as soon as this returns
+ * @param cli client through which data is sent
+ * @param buffer data to send
+ * @param bufLen length of data in [buffer]
+ * @param rejected whether ESP has rejected the data with "busy..."
+ * @return ESP_STATUS_BUSY if data was queued, ESP_STATUS_ERROR if queue is full
+ *         or data is longer than ESP_RETRYQ_DATA_LEN (data is dropped)
+ */
+uint32_t ESP8266::_RetryQueue(_espClient *cli, const char *buffer,
+                              uint16_t bufLen, bool rejected)
+{
+    if ((_retryQLen >= ESP_RETRYQ_LEN) || (bufLen > ESP_RETRYQ_DATA_LEN))
+    {
+        _cmdStats[ESP_CMD_CIPSEND].giveUp++;
+        return ESP_STATUS_ERROR;
+    }
+
+    _espRetryEntry &ent = _retryQ[_retryQLen++];
+    ent.cli = cli;
+    ent.sockID = cli->_id;
+    memcpy(ent.buf, buffer, bufLen);
+    ent.len = bufLen;
+    ent.attempt = 0;
+    ent.rejected = rejected;
+    ent.dueMS = HAL_GetMS() + _BackoffMS(0);
+
+    return ESP_STATUS_BUSY;
+}
+
+/**
+ * Remove entry from retry queue, keeping order of remaining entries
+ * @param index index of entry in retry queue
+ */
+void ESP8266::_RetryDequeue(uint8_t index)
+{
+    for (uint8_t i = index; (i + 1) < _retryQLen; i++)
+        _retryQ[i] = _retryQ[i + 1];
+    _retryQLen--;
+}
+
+/**
+ * Find socket whose queued data is to be sent next
+ * Classes are served in order of priority, sockets within a class round-robin.
+ * Socket is skipped while it has data waiting for retry (SendTCP()), an entry
+ * of another class partly sent, or its next chunk is over rate limit.
+ * @param prio output, priority class of the entry to send
+ * @return client to send from, NULL(0) if there's nothing to send
+ */
+_espClient* ESP8266::_TxPick(uint8_t *prio)
+{
+    for (uint8_t p = 0; p < ESP_PRIO_NUM; p++)
+        for (uint8_t k = 0; k < ESP_MAX_CLI; k++)
+        {
+            uint8_t id = (_txRR[p] + k) % ESP_MAX_CLI;
+            _espClient *cli = GetClientBySockID(id);
+            int8_t partial;
+
+            if ((cli == 0) || (cli->_txqLen[p] == 0) || cli->SendPending())
+                continue;
+            partial = cli->_TxPartial();
+            if ((partial >= 0) && (partial != p))
+                continue;
+
+            //  Chunk held back by rate limiter is only counted once
+            _espTxEntry &ent = cli->_txq[p][cli->_txqHead[p]];
+            uint16_t n = ent.len - ent.sent;
+
+            if (n > ESP_TXQ_CHUNK)
+                n = ESP_TXQ_CHUNK;
+            if (!_RateAllow(cli, n, ent.held ? 0 : ESP_RATE_DEFER))
+            {
+                ent.held = true;
+                continue;
+            }
+
+            _txRR[p] = (id + 1) % ESP_MAX_CLI;
+            *prio = p;
+            return cli;
+        }
+
+    return 0;
+}
+
+/**
+ * Send chunks of data queued for priority transmit scheduler
+ * Sockets are picked again before every chunk, so higher priority data queued
+ * in the meantime goes first. If ESP rejects a chunk with "busy..." sending is
+ * paused for the backoff time.
+ * @param maxChunks max number of chunks to send
+ */
+void ESP8266::_TxRun(uint8_t maxChunks)
+{
+    if ((int32_t)(HAL_GetMS() - _txHoldMS) < 0)
+        return;
+
+    while (maxChunks-- > 0)
+    {
+        uint8_t prio, id;
+        _espClient *cli = _TxPick(&prio);
+        uint32_t status, waitMS;
+        uint16_t n;
+
+        if (cli == 0)
+            break;
+
+        _espTxEntry &ent = cli->_txq[prio][cli->_txqHead[prio]];
+        _espTxStats &st = _txStats[prio];
+
+        id = cli->_id;
+        n = ent.len - ent.sent;
+        if (n > ESP_TXQ_CHUNK)
+            n = ESP_TXQ_CHUNK;
+        waitMS = HAL_GetMS() - ent.queuedMS;
+
+        status = cli->_Send(ent.buf + ent.sent, n);
+        //  Socket got closed while sending, its queue is gone with it
+        if (GetClientBySockID(id) != cli)
+            continue;
+
+        if (_IsBusyOnly(status))
+        {
+            if (_txBusyN < ESP_BUSY_MAX_RETRY)
+                _txBusyN++;
+            _txHoldMS = HAL_GetMS() + _BackoffMS(_txBusyN);
+            break;
+        }
+        _txBusyN = 0;
+
+        if (!_InStatus(status, ESP_STATUS_SENDOK))
+        {
+            st.dropped++;
+            cli->_TxPop(prio);
+            continue;
+        }
+
+        //  First chunk of the entry, it's no longer waiting in queue
+        if (ent.sent == 0)
+        {
+            st.waitSumMS += waitMS;
+            if (waitMS > st.waitMaxMS)
+                st.waitMaxMS = waitMS;
+        }
+        st.chunks++;
+        st.bytes += n;
+        ent.sent += n;
+        ent.held = false;
+
+        if (ent.sent >= ent.len)
+        {
+            waitMS = HAL_GetMS() - ent.queuedMS;
+            st.doneSumMS += waitMS;
+            if (waitMS > st.doneMaxMS)
+                st.doneMaxMS = waitMS;
+            st.sent++;
+            cli->_TxPop(prio);
+        }
+    }
+}
+
+/**
+ * Configure token bucket, bucket starts full
+ * @param rl rate limit to configure
+ * @param rate allowed rate in bytes per second, 0 to remove the limit
+ * @param burst size of bucket in bytes, 0 for one second worth of data
+ */
+void ESP8266::_RateSet(_espRateLimit &rl, uint32_t rate, uint32_t burst)
+{
+    rl.rate = rate;
+    rl.burst = (burst > 0) ? burst : rate;
+    //  Tokens are kept in a signed integer
+    if (rl.burst > 0x7FFFFFFF)
+        rl.burst = 0x7FFFFFFF;
+    rl.tokens = rl.burst;
+    rl.lastMS = HAL_GetMS();
+}
+
+/**
+ * Add tokens for time passed since they were last added
+ * Time is only advanced by what the added tokens are worth, so fractions of a
+ * token aren't lost when refilled often at low rates.
+ * @param rl rate limit to refill
+ */
+void ESP8266::_RateRefill(_espRateLimit &rl)
+{
+    uint32_t now = HAL_GetMS();
+    uint64_t add = ((uint64_t)rl.rate * (now - rl.lastMS)) / 1000;
 
-    //  If non-blocking mode is not enabled wait for status
-    if (!(flags & ESP_NONBLOCKING_MODE))
+    if (add == 0)
+        return;
+
+    if (((int64_t)rl.tokens + (int64_t)add) >= (int64_t)rl.burst)
+    {
+        rl.tokens = rl.burst;
+        rl.lastMS = now;
+    }
+    else
+    {
+        rl.tokens += (int32_t)add;
+        rl.lastMS += (uint32_t)((add * 1000) / rl.rate);
+    }
+}
+
+/**
+ * Check if data can be sent through a socket without exceeding its rate limit
+ * and rate limit of the whole ESP (tokens aren't taken, see _RateTake())
+ * Data bigger than a bucket is allowed once the bucket is full.
+ * @param cli client to send data through
+ * @param len length of data
+ * @param flags ESP_RATE_DEFER/ESP_RATE_REFUSE to add [len] to counter of
+ * deferred/refused bytes of the limit(s) not allowing it, 0 not to count it
+ * @return true: if data can be sent now
+ *        false: if data has to wait for tokens
+ */
+bool ESP8266::_RateAllow(_espClient *cli, uint16_t len, uint8_t flags)
+{
+    _espRateLimit *rl[2] = { &_rate, &(cli->_rate) };
+    bool allow = true;
+
+    for (uint8_t i = 0; i < 2; i++)
     {
-        //  Start watchdog timer
-        HAL_ESP_WDControl(true, timeout);
+        uint32_t need = (len < rl[i]->burst) ? len : rl[i]->burst;
 
-        while( !(flowControl & ESP_STATUS_OK) &&
-                !(flowControl & ESP_STATUS_ERROR) &&
-                !(flowControl & flags));
+        if (rl[i]->rate == 0)
+            continue;
 
-        HAL_DelayUS(1000);
-        //  Stop watchdog timer
-        HAL_ESP_WDControl(false, timeout);
-        return flowControl;
+        _RateRefill(*rl[i]);
+        if (rl[i]->tokens < (int32_t)need)
+        {
+            allow = false;
+            if (flags & ESP_RATE_DEFER)
+                rl[i]->deferred += len;
+            if (flags & ESP_RATE_REFUSE)
+                rl[i]->refused += len;
+        }
     }
-    else return ESP_NONBLOCKING_MODE;
+
+    return allow;
+}
+
+/**
+ * Take tokens for data written to ESP from rate limits of the socket and of
+ * the whole ESP
+ * @param cli client data was sent through
+ * @param len length of data
+ */
+void ESP8266::_RateTake(_espClient *cli, uint16_t len)
+{
+    _espRateLimit *rl[2] = { &_rate, &(cli->_rate) };
+
+    for (uint8_t i = 0; i < 2; i++)
+        if (rl[i]->rate != 0)
+        {
+            _RateRefill(*rl[i]);
+            rl[i]->tokens -= len;
+        }
 }
 
 /**
@@ -823,9 +3206,39 @@ void ESP8266::_RAWPortWrite(const char* buffer, uint16_t bufLen)
 
     for (uint16_t i = 0; i < bufLen; i++)
     {
-        while(HAL_ESP_UARTBusy());
-        HAL_ESP_SendChar(buffer[i]);
+        while(HAL_ESP_UARTBusy(_port));
+        HAL_ESP_SendChar(_port, buffer[i]);
+    }
+}
+
+/**
+ * Write data to socket in passthrough mode
+ * ESP sends data as a packet once it has 2048 bytes or when there's a 20ms gap
+ * in the stream. Packet consisting of "+++" only would make ESP leave
+ * passthrough, so data which would produce such packet is split with a pause
+ * so that "+++" ends up in a longer packet (or in two shorter ones).
+ * @param buffer data to send
+ * @param bufLen length of data in [buffer]
+ */
+void ESP8266::_PTWrite(const char *buffer, uint16_t bufLen)
+{
+    uint16_t split = 0;
+
+    //  Last packet would consist of "+++" only
+    if (((bufLen % ESP_PT_PACKET_LEN) == 3) &&
+        (strncmp(buffer + bufLen - 3, "+++", 3) == 0))
+        split = (bufLen > 3) ? (bufLen - 4) : 2;
+
+    if (split > 0)
+    {
+        _RAWPortWrite(buffer, split);
+        while(HAL_ESP_UARTBusy(_port));
+        //  Let ESP close the packet before sending the rest
+        HAL_DelayUS(ESP_PT_GAP_MS * 1000);
     }
+    _RAWPortWrite(buffer + split, bufLen - split);
+
+    _ptLastTxMS = HAL_GetMS();
 }
 
 /**
@@ -835,8 +3248,8 @@ void ESP8266::_FlushUART()
 {
     char temp = 0;
     UNUSED(temp);   //    Suppress unused variable warning
-    while (HAL_ESP_CharAvail())
-        temp = HAL_ESP_GetChar();
+    while (HAL_ESP_CharAvail(_port))
+        temp = HAL_ESP_GetChar(_port);
 }
 
 /**
@@ -868,6 +3281,70 @@ uint32_t ESP8266::_IPtoInt(char *ipAddr)
     return retVal;
 }
 
+/**
+ * Finish timing of join to AP (if one is being timed) and record its duration
+ */
+void ESP8266::_JoinDone()
+{
+    uint32_t ms;
+
+    if (!_joinTiming)
+        return;
+    _joinTiming = false;
+
+    ms = HAL_GetMS() - _joinStartMS;
+    if (_joinWarm)
+        _join.warmMS = ms;
+    else
+        _join.coldMS = ms;
+}
+
+/**
+ * Set IP address of ESP to the static one from fast-join profile
+ */
+void ESP8266::_JoinIP()
+{
+    memset(_ipStr, 0, sizeof(_ipStr));
+    strcpy(_ipStr, _join.ip);
+    _ipAddress = _IPtoInt(_ipStr);
+}
+
+/**
+ * Cache parameters of AP from reply to AT+CWJAP_CUR?
+ * SSID can contain any character, so BSSID is found by its format instead
+ * @param line reply line: +CWJAP_CUR:"ssid","xx:xx:xx:xx:xx:xx",channel,rssi
+ * @param len length of the line excluding \r\n terminator
+ * @return true: if parameters were cached
+ *        false: if line couldn't be parsed
+ */
+bool ESP8266::_JoinCache(const char *line, uint16_t len)
+{
+    const uint16_t ssidPos = 12;    //  Length of +CWJAP_CUR:"
+    uint16_t bssidPos = 0;
+    uint32_t channel;
+
+    for (uint16_t i = ssidPos + 2; (i + 20) < len; i++)
+        if ((line[i] == '"') && (line[i + 18] == '"') &&
+            (line[i + 19] == ',') && (line[i + 3] == ':') &&
+            (line[i + 15] == ':') && (line[i - 1] == ',') &&
+            (line[i - 2] == '"'))
+            bssidPos = i + 1;
+
+    if ((bssidPos == 0) ||
+        ((uint32_t)(bssidPos - 3 - ssidPos) >= sizeof(_join.ssid)) ||
+        (_LineNums(line + bssidPos + 19, len - bssidPos - 19, &channel, 1) == 0))
+        return false;
+
+    memcpy(_join.ssid, line + ssidPos, bssidPos - 3 - ssidPos);
+    _join.ssid[bssidPos - 3 - ssidPos] = '\0';
+    memcpy(_join.bssid, line + bssidPos, 17);
+    _join.bssid[17] = '\0';
+    _join.channel = channel;
+    _join.cached = true;
+
+    return true;
+}
+
 /**
  * Get client index in _clients vector based on its socket ID
  * @param sockID socket ID
@@ -886,33 +3363,60 @@ uint8_t ESP8266::_IDtoIndex(uint8_t sockID)
 /// Interrupt service routine for handling incoming data on UART (Tx)  [PRIVATE]
 ///-----------------------------------------------------------------------------
 
-void UART7RxIntHandler(void)
+/**
+ * Receive data from ESP (called from ISR of the port instance is bound to)
+ * @param __esp instance whose port raised the interrupt
+ */
+void ESPRxISR(ESP8266 &__esp)
 {
-    //  Grab a pointer to singleton
-    ESP8266 &__esp = ESP8266::GetI();
-
-    static char rxBuffer[1024] ;
-    static uint16_t rxLen = 0;
+    //  Receiving buffer and its size belong to the instance
+    char (&rxBuffer)[sizeof(__esp._rxBuf)] = __esp._rxBuf;
+    uint16_t &rxLen = __esp._rxLen;
+    //  Check (and clear) notification from watchdog timer
+    bool wdFired = __esp._wdFired;
+    __esp._wdFired = false;
 
-    HAL_ESP_ClearInt();             //  Clear interrupt
+    HAL_ESP_ClearInt(__esp._port);             //  Clear interrupt
 
     //  Loop while there are characters in receiving buffer
-    while (HAL_ESP_CharAvail())
+    while (HAL_ESP_CharAvail(__esp._port))
     {
-        char temp = HAL_ESP_GetChar();
+        char temp = HAL_ESP_GetChar(__esp._port);
         //   Reset watchdog timer on every char - bus is active
-        HAL_ESP_WDControl(true, 0);
+        HAL_ESP_WDControl(__esp._port, true, 0);
 
         rxBuffer[rxLen++] = temp;
-        //  Keep in mind buffer size
-        rxLen %= sizeof(rxBuffer);
+        //  Keep in mind buffer size (and room for terminator added on timeout)
+        rxLen %= (sizeof(rxBuffer) - 2);
+    }
+
+    //  In passthrough mode everything received is data of the only socket,
+    //  pass it on when the stream goes idle (WD) or the buffer is half full
+    //  (RespBody holds all of it, so it's passed on in one piece)
+    if (__esp._ptMode)
+    {
+        _espClient *cli = __esp.GetClientBySockID(0);
+
+        if ((cli != 0) && (rxLen > 0) &&
+            (wdFired || (rxLen >= (sizeof(rxBuffer) / 2))))
+        {
+            memcpy((void*)cli->RespBody, rxBuffer, rxLen);
+            cli->RespBody[rxLen] = '\0';
+            cli->RespLen = rxLen;
+            cli->_respRdy = true;
+            cli->_activeMS = HAL_GetMS();
+            __esp._EventPush(ESP_EV_IPD, 0);
+            __esp._DeliverRx(cli);
+            rxLen = 0;
+        }
+        return;
     }
 
     /*
      * If watchdog timer times out, artificially produce terminating sequence at
      * the end of the buffer in order to trigger next if to read the content
      */
-    if (( __esp.flowControl == ESP_STATUS_ERROR))
+    if (wdFired)
     {
         rxBuffer[rxLen++] = '\r';
         rxBuffer[rxLen++] = '\n';
@@ -926,7 +3430,9 @@ void UART7RxIntHandler(void)
     {
         if ((rxBuffer[rxLen-2] == '\r') && (rxBuffer[rxLen-1] == '\n'))
         {
-            HAL_ESP_WDControl(false, 0);    //   Stop watchdog timer
+            //   Stop watchdog timer unless a command still waits for reply
+            if (!__esp._PendWaiting())
+                HAL_ESP_WDControl(__esp._port, false, 0);
             //  Reset receiving buffer and its size
             memset(rxBuffer, '\0', sizeof(rxBuffer));
             rxLen = 0;
@@ -936,22 +3442,26 @@ void UART7RxIntHandler(void)
     //  No point in starting parser for messages with such small size, return
     else if (rxLen < 2)
     {
-        HAL_ESP_WDControl(false, 0);    //   Stop watchdog timer
+        //   Stop watchdog timer unless a command still waits for reply
+        if (!__esp._PendWaiting())
+            HAL_ESP_WDControl(__esp._port, false, 0);
         return;
     }
 
     /*
      *  There are 3 occasions when we want to process data in input buffer:
-     *  1) We've reached terminator sequence of the message (\r\n)
+     *  1) We've reached terminator sequence of the message (\r\n) and there
+     *      is no +IPD frame still waiting for the rest of its data
      *  2) ESP returned '> ' (without terminator) and awaits data
      *  3) Watchdog timer has timed out changing 'flowControl' to "error"
-     *      (on timeout WD timer also recalls this interrupt)
+     *      and setting '_wdFired' (on timeout WD timer also recalls this
+     *      interrupt)
      */
-    if (((rxBuffer[rxLen-2] == '\r') && (rxBuffer[rxLen-1] == '\n'))
-      || ((rxBuffer[rxLen-2] == '>') && (rxBuffer[rxLen-1] == ' ' ))
-      || ( __esp.flowControl == ESP_STATUS_ERROR) )
+    if (__esp._RxComplete(rxBuffer, rxLen) || wdFired)
     {
-        HAL_ESP_WDControl(false, 0);    //   Stop watchdog timer
+        HAL_ESP_WDControl(__esp._port, false, 0);    //   Stop watchdog timer
+        //  Pause ESP while RX FIFO isn't emptied (if using flow control)
+        HAL_ESP_RxHold(__esp._port, true);
 
 
 #ifdef __DEBUG_SESSION__
@@ -964,38 +3474,30 @@ void UART7RxIntHandler(void)
 #endif
         //  Parse data in receiving buffer - if there was an error from WD timer
         //  leave it in so that we know there was a problem
-        if (__esp.flowControl == ESP_STATUS_ERROR)
-            __esp.flowControl |= __esp.ParseResponse(rxBuffer, rxLen);
-        else
-            __esp.flowControl = __esp.ParseResponse(rxBuffer, rxLen);
-
-        //  If some data came from one of opened TCP sockets receive it and
-        //  pass it to a user-defined function for further processing
-        if ((__esp.custHook != 0) && (__esp.flowControl & ESP_STATUS_IPD))
+        //  Pending commands are completed by parser line by line, except on
+        //  timeout when the reply belongs to the command which timed out
+        uint32_t status = __esp.ParseResponse(rxBuffer, rxLen, !wdFired);
+        if (wdFired)
         {
-            for (uint8_t i = 0; i < ESP_MAX_CLI; i++)
-                //  Skip null pointers
-                if (__esp.GetClientByIndex(i) != 0)
-                //  Check which socket received data
-                if (__esp.GetClientByIndex(i)->Ready())
-                {
-#if defined(__USE_TASK_SCHEDULER__)
-                //  If using task scheduler, schedule receiving outside this ISR
-                    volatile TaskEntry tE(ESP_UID, ESP_T_RECVSOCK, 0);
-                    tE.AddArg(&__esp.GetClientByIndex(i)->_id, 1);
-                    TaskScheduler::GetP()->SyncTask(tE);
-#else
-                    //  If no task scheduler do everything in here
-                    _espClient* cli = __esp.GetClientByIndex(i);
-                    __esp.custHook(i, (const uint8_t*)cli->RespBody, (cli->RespLen));
-#endif  /* __USE_TASK_SCHEDULER__ */
-                }
-            }
-
+            __esp.flowControl |= status;
+            //  Whatever arrived belongs to the command which timed out
+            if ((__esp._wdSlot >= 0) && __esp._pend[__esp._wdSlot].used
+                && (__esp._pend[__esp._wdSlot].seq == __esp._wdSeq))
+                __esp._pend[__esp._wdSlot].status |= status;
+        }
+        else
+            __esp.flowControl = status;
+        //  Unsolicited messages don't terminate pending commands, keep watching
+        //  for their reply
+        if (__esp._PendWaiting())
+            HAL_ESP_WDControl(__esp._port, true, 0);
 
+        //  Data received on sockets has already been passed to user-defined
+        //  hook by the parser (one call per +IPD frame)
 
         //  Reset receiving buffer and its size
         memset(rxBuffer, '\0', sizeof(rxBuffer));
         rxLen = 0;
+        HAL_ESP_RxHold(__esp._port, false);
     }
 }
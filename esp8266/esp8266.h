@@ -5,7 +5,7 @@
  *      Author: Vedran Mikov
  *
  *  ESP8266 WiFi module communication library
- *  @version 1.4.5
+ *  @version 1.7.3
  *  V1.1.4
  *  +Connect/disconnect from AP, get acquired IP as string/int
  *	+Start TCP server and allow multiple connections, keep track of
@@ -54,8 +54,110 @@
  *  +Stability improvements, different placement of watchdog resets
  *  V1.4.5 - 2.9.2017
  *  +Bugfix in parser, fixed problem with multiple sockets closing at the same time
- *
- *  TODO:Add interface to send UDP packet
+ *  V1.5.0 - 19.10.2026
+ *  +Per-command statistics: number of issued commands, outcome counters and
+ *  latency histogram (command write -> terminal status) for each command type
+ *  +Watchdog timeout is reported to the caller as ESP_NORESPONSE status
+ *  V1.5.1
+ *  +Adaptive watchdog timeouts: timeout for each command type is estimated
+ *  from smoothed latency and its variance (as TCP RTO), timeout passed to
+ *  _SendRAW becomes an upper bound
+ *  V1.5.2
+ *  +Socket sends rejected with "busy..." are put into a retry queue serviced
+ *  from Service() with exponential backoff and jitter, so that sends on other
+ *  sockets are not blocked in the meantime. Other commands return busy to the
+ *  caller instead of blocking for backoff
+ *  V1.5.3
+ *  +Pending-command table: every command waits for its own terminal status
+ *  (OK/ERROR/FAIL/SEND OK/busy/'>'), completed in the order commands were sent.
+ *  Unsolicited messages (socket opened/closed, +IPD, WiFi status) are put into
+ *  a separate event queue and no longer interfere with pending commands
+ *  V1.5.4
+ *  +Line-oriented parser: replies are split into lines and each line is matched
+ *  as a whole, +IPD data is extracted by its length and never searched for
+ *  keywords, so socket payload can no longer be mistaken for status messages.
+ *  Parsing of a +IPD frame split across several UART interrupts is deferred
+ *  until all of its data arrives
+ *  V1.5.5
+ *  +Runtime baud-rate negotiation: ESP is switched to faster baud-rates with
+ *  AT+UART_CUR and each one is verified with echo/CRC link test, fastest
+ *  error-free one is kept (InitHW(baud, true) or NegotiateBaud())
+ *  V1.5.6
+ *  +Optional RTS/CTS flow control (FlowControl()), ESP is paused while received
+ *  data is parsed in ISR. RX FIFO overruns are counted (GetRxOverruns())
+ *  V1.5.7
+ *  +Transparent transmission (passthrough, AT+CIPMODE=1) for a single socket
+ *  used as raw byte stream, with "+++" escape back to command mode
+ *  (StartPassthrough()/StopPassthrough())
+ *  V1.5.8
+ *  +Buffered sends (AT+CIPSENDBUF): several segments can be outstanding in
+ *  ESP's TCP buffer, acknowledged by "<id>,<segment>,SEND OK", window limited
+ *  by number of segments and bytes in flight (_espClient::SendBuffered())
+ *  V1.5.9
+ *  +Passive receive mode (AT+CIPRECVMODE=1): ESP keeps socket data and only
+ *  notifies about its length, data is pulled with AT+CIPRECVDATA from Service()
+ *  once consumer has room for it (PassiveRecv())
+ *  V1.6.0
+ *  +UDP sockets (OpenUDPSock(), _espClient::SendUDP()), one datagram per send
+ *  and per received +IPD frame. Receive() copies data by its length (binary
+ *  safe)
+ *  V1.6.1
+ *  +Remote IP and port of received data (AT+CIPDINFO=1, RemoteInfo()), kept
+ *  in the client object and passed to extended hook (AddHookEx())
+ *  V1.6.2
+ *  +Multiple instances, each bound to its own HAL port (HAL_ESP_Port) with its
+ *  own ISRs, receive and command buffers and client table. Singleton (GetI())
+ *  stays as the default instance on HAL_ESP_PORT0
+ *  V1.6.3
+ *  +Fast-join profile (FastJoin()): static IP saved with AT+CIPSTA_DEF instead
+ *  of DHCP, BSSID and channel of the AP cached after a successful join and
+ *  passed to AT+CWJAP on the next (warm) join. Durations of the last cold and
+ *  warm join are kept (GetJoinTime())
+ *  V1.6.4
+ *  +Readiness-based boot: instead of fixed delays (2s + 70ms + 50ms on power-up,
+ *  1s on power-down) library waits for "ready" banner, probing ESP with "AT"
+ *  if it doesn't come. Old delays are kept as upper bound, duration of the
+ *  last boot is measured (GetBootTime())
+ *  V1.6.5
+ *  +Configuration shadow: echo, multiple connections, WiFi mode, TCP server
+ *  port and timeout are remembered and commands which wouldn't change them are
+ *  skipped. Settings are forgotten (resynced) when ESP reboots or a command
+ *  times out (ConfigResync(), GetConfigSkips())
+ *  V1.6.6
+ *  +Broadcast(): the same data is sent to all connected TCP clients through
+ *  their send buffers (AT+CIPSENDBUF) without waiting for any of them to
+ *  acknowledge it, status of each socket is returned separately
+ *  V1.6.7
+ *  +Per-socket handlers of received data, function and its context
+ *  (_espClient::SetHandler()), given to OpenTCPSock() or set from accept
+ *  callback for connections to the server (OnAccept()). Global hook is only
+ *  called for sockets without a handler
+ *  V1.6.8
+ *  +Close callback (OnClose()) and server policy hook (ServerPolicy()) which
+ *  can refuse new connections or evict established ones (e.g. idle ones) by
+ *  closing them (Evict()). Max. number of connections and idle timeout of
+ *  the server are configurable (ServerLimits())
+ *  V1.6.9
+ *  +Priority transmit scheduler: data queued per socket in priority classes
+ *  (_espClient::SendQueued()) is sent from Service() in chunks, so control
+ *  traffic preempts bulk transfers between chunks. Queueing delay is measured
+ *  per class (GetTxStats())
+ *  V1.7.0
+ *  +Token-bucket rate limiting of sent data, per socket
+ *  (_espClient::RateLimit()) and for the whole ESP (RateLimit()), with
+ *  counters of bytes held back or refused by the limiter
+ *  V1.7.1
+ *  +Coalescing of small writes (_espClient::Coalesce()): data of SendTCP() is
+ *  merged in a per-socket buffer and sent with one AT+CIPSEND once it reaches
+ *  a size threshold or its deadline expires, or on _espClient::Flush()
+ *  V1.7.2
+ *  +Message framing (espFrame.h, espFrameRx.h): length-prefixed messages with
+ *  optional CRC, reassembled in place from received data
+ *  +_espClient::SendGather() sends several pieces of data with one AT+CIPSEND
+ *  V1.7.3
+ *  +Request/response calls over a socket (espRPC.h): call IDs, several calls
+ *  in flight completed in any order through callbacks, per-call timeouts
+ *  +ESPFrame::SendV() frames a message made of several pieces
  */
 #include <stdint.h>
 #include <stdbool.h>
@@ -66,15 +168,123 @@
 
 //  Define class prototype
 class ESP8266;
-//  Shared buffer for ESP library to assemble text requests in (declared extern
-//  because it's shared with espClient library
-extern char _commBuf[2048];
+//  Port (UART, watchdog timer, pins) ESP is connected to, defined by HAL
+typedef struct _halEspPort HAL_ESP_Port;
+
+/*		Buffered sends (AT+CIPSENDBUF) settings		*/
+//  Max number of segments outstanding per socket
+#define ESP_SBUF_WIN_SEG        4
+//  Max number of bytes outstanding per socket (ESP's TCP send buffer)
+#define ESP_SBUF_WIN_BYTES      2920
+
+/**
+ * Segment of data sent through ESP's TCP send buffer (AT+CIPSENDBUF)
+ */
+struct _espSegment
+{
+    uint32_t    id;         //  Segment ID assigned by ESP
+    uint16_t    len;        //  Length of data in segment
+};
+
+/*		Priority transmit scheduler settings		*/
+//  Priority classes, lower number is served first
+#define ESP_PRIO_CONTROL        0
+#define ESP_PRIO_BULK           1
+#define ESP_PRIO_NUM            2
+//  Max number of entries queued per socket in each priority class
+#define ESP_TXQ_LEN             4
+//  Max number of bytes sent with one AT+CIPSEND, higher priority data can
+//  preempt an entry between its chunks
+#define ESP_TXQ_CHUNK           512
+//  Max number of chunks sent on each call of Service()
+#define ESP_TXQ_BURST           4
+
+/**
+ * Data queued for priority transmit scheduler (_espClient::SendQueued())
+ */
+struct _espTxEntry
+{
+    const char  *buf;       //  Data to send (not copied!)
+    uint16_t    len;        //  Length of data in [buf]
+    uint16_t    sent;       //  Bytes of [buf] sent so far
+    uint32_t    queuedMS;   //  Time entry was queued (HAL_GetMS())
+    bool        held;       //  Current chunk was held back by rate limiter
+};
+
+/*		Rate limiting settings		*/
+//  Flags of ESP8266::_RateAllow(): count bytes as deferred/refused if send
+//  isn't allowed
+#define ESP_RATE_DEFER          1<<0
+#define ESP_RATE_REFUSE         1<<1
+
+/**
+ * Token bucket limiting rate of sent data, of one socket or the whole ESP
+ * Bucket holds up to [burst] bytes and is refilled at [rate]. Data bigger than
+ * the bucket is let through once the bucket is full, leaving it in debt.
+ */
+struct _espRateLimit
+{
+    uint32_t    rate;       //  Allowed rate (B/s), 0 - unlimited
+    uint32_t    burst;      //  Size of bucket, longest burst (B)
+    int32_t     tokens;     //  Bytes which can be sent right away
+    uint32_t    lastMS;     //  Time tokens were last added (HAL_GetMS())
+    uint32_t    deferred;   //  Bytes held back, sent later by the library
+    uint32_t    refused;    //  Bytes refused, returned to caller as busy
+};
+
+/*		Send coalescing settings		*/
+//  Size of per-socket buffer small writes are merged in (max. threshold)
+#define ESP_COAL_LEN            512
+
+//  Size of buffer data from ESP is received in, also of socket's RespBody so
+//  that any +IPD received is passed on whole
+#define ESP_RX_BUF_LEN          2048
 
 //  Include client library
 #include "espClient.h"
 
 /*		Communication settings	 	*/
 #define ESP_DEF_BAUD			1000000
+//  Highest baud-rate tried in baud-rate negotiation
+#define ESP_MAX_BAUD            3000000
+//  Number of candidate baud-rates in _espBaudCand
+#define ESP_BAUD_CAND_NUM       8
+//  Number of echo test rounds each baud-rate has to pass
+#define ESP_BAUD_TEST_ROUNDS    4
+//  Length of test command (incl. random payload) echoed in each round
+#define ESP_BAUD_TEST_LEN       96
+//  Candidate baud-rates for negotiation, ascending
+extern const uint32_t _espBaudCand[];
+
+/*		Boot settings		*/
+//  Upper bound of time ESP takes to boot after power-up (ms), sum of fixed
+//  delays used before library started watching for "ready"
+#define ESP_BOOT_MAX_MS         2120
+//  Time after power-up when ESP is probed with "AT" if "ready" didn't come,
+//  e.g. because it got garbled (ms)
+#define ESP_BOOT_PROBE_MS       500
+//  Timeout of a single "AT" probe (ms)
+#define ESP_BOOT_PROBE_TO_MS    50
+//  Min. time ESP is kept powered down before it's powered up again (ms)
+#define ESP_OFF_MIN_MS          20
+
+/*		Transparent transmission (passthrough) settings		*/
+//  ESP sends a packet when it collects this many bytes...
+#define ESP_PT_PACKET_LEN       2048
+//  ...or after this long gap in the stream (ms)
+#define ESP_PT_GAP_MS           20
+//  Pause before "+++" escape sequence (ms)
+#define ESP_PT_GUARD_MS         ESP_PT_GAP_MS
+//  Time ESP needs after "+++" before accepting next command (ms)
+#define ESP_PT_EXIT_MS          1000
+//  Gap in received stream after which received data is passed on (ms)
+#define ESP_PT_RXGAP_MS         2
+
+/*		TCP server settings		*/
+//  Longest idle timeout of connections to the server ESP accepts (s)
+#define ESP_SERV_TO_MAX         7200
+//  Period at which server policy is asked about established connections (ms)
+#define ESP_POLICY_PERIOD_MS    1000
 
 /*		ESP8266 error codes		*/
 #define ESP_STATUS_LENGTH		13
@@ -96,12 +306,237 @@ extern char _commBuf[2048];
 #define ESP_STATUS_IPD          1<<14
 #define ESP_GOT_IP              1<<15
 
+//  Statuses which terminate a command waiting for reply from ESP
+#define ESP_TERMINAL_MASK       (ESP_STATUS_OK | ESP_STATUS_ERROR | \
+                                 ESP_STATUS_FAIL | ESP_STATUS_BUSY | \
+                                 ESP_STATUS_SENDOK | ESP_STATUS_RECV)
+
+/*      Unsolicited events reported by ESP (_espEvent::type)        */
+#define ESP_EV_NONE             0
+#define ESP_EV_WIFICONN         1   //  Connected to AP
+#define ESP_EV_WIFIGOTIP        2   //  Acquired IP address
+#define ESP_EV_WIFIDISCN        3   //  Disconnected from AP
+#define ESP_EV_SOCKOPEN         4   //  Socket opened ("n,CONNECT")
+#define ESP_EV_SOCKCLOSE        5   //  Socket closed ("n,CLOSED")
+#define ESP_EV_IPD              6   //  Data received on socket ("+IPD")
+#define ESP_EV_SEGACK           7   //  Buffered segment sent ("n,s,SEND OK")
+#define ESP_EV_SEGFAIL          8   //  Buffered segment failed ("n,s,SEND FAIL")
+
+//  Max number of commands waiting for reply from ESP at the same time
+#define ESP_PEND_LEN            8
+//  Max number of unsolicited events waiting to be read by application
+#define ESP_EVQ_LEN             16
+
 #define ESP_WIFI_NONE           0
 #define ESP_WIFI_CONNECTING     1
 #define ESP_WIFI_CONNECTED      2
 
 //  Max number of clients allowed by ESP8266
 #define ESP_MAX_CLI     5
+//  Max number of ESP8266 instances (modules) used at the same time
+#define ESP_MAX_INST    2
+
+/*      Command types used to keep statistics of ESP replies    */
+#define ESP_CMD_GENERIC         0   //  Any command not listed below
+#define ESP_CMD_CWJAP           1   //  Connecting to AP
+#define ESP_CMD_CIPSTART        2   //  Opening a socket
+#define ESP_CMD_CIPSEND         3   //  Send request, up to '>' prompt
+#define ESP_CMD_SENDDATA        4   //  Socket data, from write to SEND OK
+#define ESP_CMD_CIPCLOSE        5   //  Closing a socket
+#define ESP_CMD_CIPSERVER       6   //  Starting/stopping TCP server
+#define ESP_CMD_CWJAPWARM       7   //  Connecting to AP with cached BSSID
+#define ESP_CMD_NUM             8
+
+//  Number of bins in latency histogram, last bin collects everything above
+//  the highest bin limit in _espHistLimMS
+#define ESP_STAT_HIST_BINS      14
+//  Upper limit (in ms, exclusive) of each histogram bin but the last one
+extern const uint16_t _espHistLimMS[ESP_STAT_HIST_BINS - 1];
+
+/*      Adaptive timeout settings       */
+//  Number of latency samples required before estimated timeout is used
+#define ESP_RTO_MIN_SAMPLES     3
+//  Max number of timeout doublings after consecutive watchdog timeouts
+#define ESP_RTO_MAX_BACKOFF     4
+
+/*      Fast-join profile settings      */
+//  Upper bound of time joining AP with cached BSSID may take (ms), cold join is
+//  tried if it doesn't succeed in time
+#define ESP_FJ_WARM_MS          5000
+
+/*      Retrying commands rejected with "busy..."       */
+//  Max number of retries before giving up on a command
+#define ESP_BUSY_MAX_RETRY      5
+//  Backoff before first retry, doubled on every next one (ms)
+#define ESP_BUSY_BASE_MS        10
+//  Upper bound of backoff, excluding jitter (ms)
+#define ESP_BUSY_MAX_MS         500
+//  Max number of socket sends waiting for retry, and max length of data of
+//  one (data is copied into the queue)
+#define ESP_RETRYQ_LEN          8
+#define ESP_RETRYQ_DATA_LEN     2048
+
+/**
+ * Statistics kept for every command type (ESP_CMD_*)
+ * Outcome counters are exclusive (timeout > error > fail > ok) except for
+ * [busy] which is counted whenever ESP replied with "busy..." while executing
+ * the command. Latency is only recorded for commands which received a terminal
+ * status from ESP (i.e. not for watchdog timeouts).
+ */
+struct _espCmdStats
+{
+    uint32_t    count;      //  Number of issued commands
+    uint32_t    ok;         //  Finished with OK/SEND OK/'>'
+    uint32_t    error;      //  Finished with ERROR
+    uint32_t    fail;       //  Finished with FAIL/SEND FAIL
+    uint32_t    busy;       //  ESP replied "busy..."
+    uint32_t    timeout;    //  Interrupted by watchdog timer
+    uint32_t    retries;    //  Resent after "busy..." reply
+    uint32_t    giveUp;     //  Dropped after too many "busy..." replies
+    uint32_t    latMinUS;   //  Shortest latency seen (us)
+    uint32_t    latMaxUS;   //  Longest latency seen (us)
+    uint64_t    latSumUS;   //  Sum of all latencies, for calculating mean (us)
+    uint32_t    hist[ESP_STAT_HIST_BINS];
+};
+
+/**
+ * Timeout estimator kept for every command type (ESP_CMD_*), follows the RTO
+ * estimation of TCP (RFC 6298): timeout = SRTT + 4*RTTVAR, clamped to bounds
+ */
+struct _espRTOEst
+{
+    uint32_t    srttUS;     //  Smoothed latency (us)
+    uint32_t    rttvarUS;   //  Smoothed mean deviation of latency (us)
+    uint16_t    samples;    //  Number of latency samples taken so far
+    uint8_t     backoff;    //  Number of consecutive watchdog timeouts
+    uint16_t    minMS;      //  Lower bound of timeout (ms)
+    uint16_t    maxMS;      //  Upper bound of timeout (ms)
+};
+
+/**
+ * Command sent to ESP which is waiting for its terminal status
+ * Terminal statuses received from ESP complete the oldest pending command
+ * waiting for them. Statuses in [absorb] are consumed by the command without
+ * completing it (e.g. OK preceding '>' prompt of CIPSEND). "busy..." and
+ * watchdog timeout only complete the blocking command being waited for, never
+ * a detached one (ESP answers busy to commands sent while it's still executing
+ * a detached one).
+ */
+struct _espPendCmd
+{
+    volatile bool       used;       //  Entry holds a pending command
+    volatile bool       done;       //  Terminal status has been received
+    bool                detached;   //  Nobody waits for it, free when done
+    uint8_t             cmdType;    //  Type of command, one of ESP_CMD_*
+    uint32_t            seq;        //  Sequence number, defines age of entry
+    uint32_t            waitFor;    //  Statuses terminating the command
+    uint32_t            absorb;     //  Intermediate statuses of the command
+    volatile uint32_t   status;     //  Statuses received for the command
+};
+
+/**
+ * Unsolicited event reported by ESP
+ */
+struct _espEvent
+{
+    uint8_t     type;       //  Type of event, one of ESP_EV_* values
+    uint8_t     sockID;     //  Socket ID the event refers to (if any)
+};
+
+/**
+ * Description of +IPD frame (socket data) found in data received from ESP
+ */
+struct _espIPD
+{
+    uint8_t     sockID;     //  Socket ID data was received on
+    uint16_t    dataPos;    //  Position of first byte of data in the buffer
+    uint16_t    dataLen;    //  Length of data as declared in frame header
+    bool        lenOnly;    //  Notification only, data waits in ESP (passive)
+    uint32_t    remoteIP;   //  Sender's IP (AT+CIPDINFO=1), 0 if not reported
+    uint16_t    remotePort; //  Sender's port (AT+CIPDINFO=1), 0 if not reported
+};
+
+/**
+ * Result of link test done at one of candidate baud-rates
+ */
+struct _espLinkTest
+{
+    uint32_t    baud;       //  Baud-rate tested
+    uint8_t     rounds;     //  Number of echo test rounds done
+    uint8_t     errors;     //  Number of rounds (and commands) that failed
+};
+
+//  Setting in configuration shadow whose value on ESP isn't known
+#define ESP_CFG_UNKNOWN         -1
+
+/**
+ * Shadow of ESP settings, each one is ESP_CFG_UNKNOWN until it's set
+ * Commands which wouldn't change a known setting are skipped. Settings lost on
+ * restart are forgotten when ESP reports it has (re)booted, a setting whose
+ * command failed is forgotten, all are forgotten when a command times out.
+ */
+struct _espConfig
+{
+    int32_t     echo;       //  Echo of commands (ATE)
+    int32_t     mux;        //  Multiple connections (AT+CIPMUX)
+    int32_t     mode;       //  WiFi mode saved in flash (AT+CWMODE_DEF)
+    int32_t     servPort;   //  Port of TCP server, 0 if stopped (AT+CIPSERVER)
+    int32_t     servTO;     //  Timeout of TCP server in s (AT+CIPSTO)
+    int32_t     maxConn;    //  Max. connections to server (AT+CIPSERVERMAXCONN)
+};
+
+/**
+ * Fast-join profile
+ * Static IP is used instead of DHCP, and SSID, BSSID and channel of the AP are
+ * cached after a successful join. Next join to the same AP (warm join) names
+ * the BSSID so ESP doesn't have to look for the AP, and doesn't wait for DHCP.
+ */
+struct _espJoinProfile
+{
+    bool        enabled;    //  Profile is used by ConnectAP
+    bool        ipSaved;    //  Static IP is saved in ESP's flash (CIPSTA_DEF)
+    char        ip[16];     //  Static IP, gateway and netmask ("x.x.x.x")
+    char        gateway[16];
+    char        netmask[16];
+    bool        cached;     //  SSID, BSSID and channel below are valid
+    char        ssid[33];   //  SSID of AP joined last
+    char        bssid[18];  //  BSSID of AP joined last ("xx:xx:xx:xx:xx:xx")
+    uint8_t     channel;    //  Channel of AP joined last
+    uint32_t    coldMS;     //  Duration of the last cold join, 0 if none (ms)
+    uint32_t    warmMS;     //  Duration of the last warm join, 0 if none (ms)
+};
+
+/**
+ * Statistics of priority transmit scheduler, one per priority class
+ * Queueing delay is time from queuing an entry until its first chunk is sent,
+ * completion delay until its last chunk is sent.
+ */
+struct _espTxStats
+{
+    uint32_t    queued;     //  Entries queued
+    uint32_t    sent;       //  Entries sent completely
+    uint32_t    dropped;    //  Entries dropped (send failed, socket closed)
+    uint32_t    chunks;     //  Chunks sent (one AT+CIPSEND each)
+    uint32_t    bytes;      //  Bytes sent
+    uint32_t    waitMaxMS;  //  Longest queueing delay (ms)
+    uint64_t    waitSumMS;  //  Sum of queueing delays, for calculating mean
+    uint32_t    doneMaxMS;  //  Longest completion delay (ms)
+    uint64_t    doneSumMS;  //  Sum of completion delays, for calculating mean
+};
+
+/**
+ * Socket send rejected with "busy..." and waiting in retry queue
+ */
+struct _espRetryEntry
+{
+    _espClient  *cli;       //  Client through which data is sent
+    uint8_t     sockID;     //  Socket ID of the client when data was queued
+    char        buf[ESP_RETRYQ_DATA_LEN];   //  Copy of data to send
+    uint16_t    len;        //  Length of data in [buf]
+    uint8_t     attempt;    //  Number of retries done so far
+    bool        rejected;   //  ESP rejected the data at least once
+    uint32_t    dueMS;      //  Time of next retry (HAL_GetMS())
+};
 
 /**
  * ESP8266 class definition
@@ -115,60 +550,194 @@ class ESP8266
 {
     /// Functions & classes needing direct access to all members
     friend class    _espClient;
-    friend void     UART7RxIntHandler(void);
+    friend void     ESPRxISR(ESP8266 &esp);
+    friend void     ESPWDISR(ESP8266 &esp);
     friend void     _ESP_KernelCallback(void);
 	public:
+        ESP8266(HAL_ESP_Port *port);
+        ~ESP8266();
         //  Functions for returning static instance
         static ESP8266& GetI();
         static ESP8266* GetP();
         //  Functions for configuring ESP8266
-		uint32_t    InitHW(int32_t baud = ESP_DEF_BAUD);
+		uint32_t    InitHW(int32_t baud = ESP_DEF_BAUD, bool negotiate = false);
         void        Enable(bool enable);
         bool        IsEnabled();
+        uint32_t    GetBootTime();
+        uint32_t    NegotiateBaud(uint32_t maxBaud = ESP_MAX_BAUD);
+        uint32_t    GetBaud();
+        uint32_t    FlowControl(bool enable);
+        uint32_t    GetRxOverruns();
+        const _espLinkTest* GetLinkTest(uint8_t index);
         void        AddHook(void((*funPoint)(const uint8_t, const uint8_t*,
                                              const uint16_t)));
+        void        AddHookEx(void((*funPoint)(const uint8_t, const uint8_t*,
+                                               const uint16_t, const uint32_t,
+                                               const uint16_t)));
+        void        OnAccept(void((*accept)(_espClient*, void*)),
+                             void *ctx = 0);
+        void        OnClose(void((*close)(_espClient*, void*)),
+                            void *ctx = 0);
 		//  Functions used with access points
 		uint32_t    ConnectAP(char* APname, char* APpass, bool nonBlocking=false);
 		bool        IsConnected();
 		uint32_t    DisconnectAP();
 		uint32_t    MyIP();
+		uint32_t    FastJoin(const char *ip, const char *gateway,
+		                     const char *netmask);
+		uint32_t    GetJoinTime(bool warm);
+		const _espJoinProfile* GetJoinProfile();
 		//  Functions related to TCP server
 		uint32_t    StartTCPServer(uint16_t port);
 		uint32_t    StopTCPServer();
 		bool        ServerOpened();
 		void        TCPListen(bool enable);
+		uint32_t    ServerLimits(uint8_t maxConn, uint16_t idleS);
+		void        ServerPolicy(bool((*keep)(_espClient*, bool, void*)),
+		                         void *ctx = 0);
+		void        Evict(uint8_t sockID);
+		uint8_t     Broadcast(const char *buffer, uint16_t bufLen,
+		                      uint32_t *results = 0);
 		//  Functions to interface opened TCP sockets (clients)
 		_espClient* GetClientByIndex(uint8_t index);
 		_espClient* GetClientBySockID(uint8_t id);
+		uint32_t    StartPassthrough(char *ipAddr, uint16_t port);
+		uint32_t    StopPassthrough();
+		bool        InPassthrough();
+		uint32_t    PassiveRecv(bool enable);
+		uint32_t    RemoteInfo(bool enable);
 		//  Functions related to TCP clients(sockets)
 		uint32_t    OpenTCPSock(char *ipAddr, uint16_t port,
-		                        bool keepAlive=true, uint8_t sockID = 9);
+		                        bool keepAlive=true, uint8_t sockID = 9,
+		                        void((*handler)(_espClient*, const uint8_t*,
+		                                        const uint16_t, void*)) = 0,
+		                        void *ctx = 0);
+		uint32_t    OpenUDPSock(char *ipAddr, uint16_t remotePort,
+		                        uint16_t localPort, uint8_t sockID = 9);
 		bool        ValidSocket(uint8_t id);
 		uint32_t    Send(const char* arg, ...) { return ESP_NO_STATUS; }
 		//  Miscellaneous functions
-		uint32_t 	ParseResponse(char* rxBuffer, uint16_t rxLen);
-uint32_t	_SendRAW(const char* txBuffer, uint32_t flags = 0,
+		uint32_t 	ParseResponse(char* rxBuffer, uint16_t rxLen,
+		                      bool complete = true);
+		const _espCmdStats* GetCmdStats(uint8_t cmdType);
+		void        ResetCmdStats();
+		const _espTxStats* GetTxStats(uint8_t prio);
+		void        ResetTxStats();
+		void        RateLimit(uint32_t rate, uint32_t burst = 0);
+		const _espRateLimit* GetRateLimit();
+		void        AdaptiveTimeout(bool enable);
+		void        SetTimeoutBounds(uint8_t cmdType, uint16_t minMS,
+		                             uint16_t maxMS);
+		void        ConfigResync();
+		uint32_t    GetConfigSkips();
+		uint32_t    GetTimeout(uint8_t cmdType, uint32_t timeout = 0xFFFF);
+		void        Service();
+		bool        GetEvent(_espEvent *event);
+		uint32_t	_SendRAW(const char* txBuffer, uint32_t flags = 0,
 		                     uint32_t timeout = 250);//150
-		//  Status variable for error codes returned by ESP
+		//  Statuses (ESP_STATUS_*) found in the last message parsed from ESP
 		volatile uint32_t	flowControl;
 		//  Status of connecting to AP
 		volatile uint32_t    wifiStatus;
 
 	protected:
-        ESP8266();
-        ~ESP8266();
         ESP8266(ESP8266 &arg) {}                //  No definition - forbid this
         void operator=(ESP8266 const &arg) {}   //  No definition - forbid this
 
 		bool        _InStatus(const uint32_t status, const uint32_t flag);
+		bool        _WaitReady();
+		uint32_t    _SetConfig(int32_t &setting, int32_t value,
+		                       const char *cmd);
+		void        _CfgForget(bool all);
+		uint32_t    _SetBaud(uint32_t baud);
+		void        _RestartAtDefBaud();
+		bool        _LinkTest(_espLinkTest *result);
+		uint16_t    _CRC16(const char *data, uint16_t len);
+		uint32_t    _Rand();
+		uint8_t     _CmdType(const char* txBuffer);
+		void        _StatsRecord(uint8_t cmdType, uint32_t status,
+		                         uint32_t startTick);
+		void        _RTOUpdate(uint8_t cmdType, uint32_t status,
+		                       uint32_t latUS);
+		bool        _IsBusyOnly(uint32_t status);
+		uint32_t    _BackoffMS(uint8_t attempt);
+		uint32_t    _RetryQueue(_espClient *cli, const char *buffer,
+		                        uint16_t bufLen, bool rejected);
+		void        _RetryDequeue(uint8_t index);
+		_espClient* _TxPick(uint8_t *prio);
+		void        _RateSet(_espRateLimit &rl, uint32_t rate, uint32_t burst);
+		void        _RateRefill(_espRateLimit &rl);
+		bool        _RateAllow(_espClient *cli, uint16_t len, uint8_t flags);
+		void        _RateTake(_espClient *cli, uint16_t len);
+		void        _TxRun(uint8_t maxChunks);
+		int8_t      _PendPush(uint8_t cmdType, uint32_t waitFor,
+		                      uint32_t absorb, bool detached = false);
+		uint32_t    _PendWait(int8_t slot);
+		bool        _PendWaiting();
+		int8_t      _PendOldest(uint32_t status);
+		int8_t      _PendBlocking();
+		void        _PendComplete(uint32_t status);
+		void        _EventPush(uint8_t type, uint8_t sockID);
+		uint32_t    _ParseLine(const char *line, uint16_t len);
+		bool        _LineIs(const char *line, uint16_t len, const char *msg);
+		uint16_t    _LineNums(const char *line, uint16_t len, uint32_t *nums,
+		                      uint8_t n);
+		int8_t      _IPDFrame(const char *buf, uint16_t len, uint16_t pos,
+		                      _espIPD *ipd);
+		bool        _RxComplete(const char *buf, uint16_t len);
+		uint32_t    _RxPull(_espClient *cli);
+		void        _DeliverRx(_espClient *cli);
+		void        _CallHandler(_espClient *cli);
+		void        _DropClient(uint8_t id);
 
 		void        _RAWPortWrite(const char* buffer, uint16_t bufLen);
+		void        _PTWrite(const char *buffer, uint16_t bufLen);
 		void	    _FlushUART();
 		uint32_t    _IPtoInt(char *ipAddr);
+		void        _JoinDone();
+		void        _JoinIP();
+		bool        _JoinCache(const char *line, uint16_t len);
 		uint8_t     _IDtoIndex(uint8_t sockID);
 
+        //  Port ESP is connected to and index of ISRs serving it (0xFF until
+        //  InitHW is called)
+        HAL_ESP_Port        *_port;
+        uint8_t             _inst;
+        //  Buffer used to assemble commands
+        //  2048 is max allowed length for a continuous stream ESP can handle
+        char                _commBuf[2048];
+        //  Buffer for data received from ESP, filled in ISR
+        char                _rxBuf[ESP_RX_BUF_LEN];
+        uint16_t            _rxLen;
+        //  Set by parser when ESP reports it has booted ("ready")
+        volatile bool       _ready;
+        //  Duration of the last boot (ms), time ESP was last powered down
+        uint32_t            _bootMS;
+        uint32_t            _offMS;
         //  Hook to user routine called when data from socket is received
         void    ((*custHook)(const uint8_t, const uint8_t*, const uint16_t));
+        //  Extended hook, also gets IP address and port of the sender
+        void    ((*custHookEx)(const uint8_t, const uint8_t*, const uint16_t,
+                               const uint32_t, const uint16_t));
+        //  Callback (and its context) called when client connects to server
+        void    ((*_acceptCb)(_espClient*, void*));
+        void    *_acceptCtx;
+        //  Callback (and its context) called when socket gets closed
+        void    ((*_closeCb)(_espClient*, void*));
+        void    *_closeCtx;
+        //  Server policy deciding which connections are kept, and its context
+        bool    ((*_policy)(_espClient*, bool, void*));
+        void    *_policyCtx;
+        //  Bit mask of sockets to be closed from Service(), time policy was
+        //  last asked about established connections
+        volatile uint8_t    _evictMask;
+        uint32_t            _policyMS;
+        //  Socket being opened by this library (not an incoming connection),
+        //  0xFF if none, and handler it gets once opened
+        volatile uint8_t    _openID;
+        void    ((*_openHandler)(_espClient*, const uint8_t*, const uint16_t,
+                                 void*));
+        void    *_openCtx;
 		//  IP address in decimal and string format
 		uint32_t    _ipAddress;
 		char        _ipStr[16];
@@ -176,10 +745,79 @@ uint32_t	_SendRAW(const char* txBuffer, uint32_t flags = 0,
 		uint16_t    _tcpServPort;
 		//  Specifies whether the TCP server is currently running
 		bool        _servOpen;
+		//  Max. connections and idle timeout (s) applied when server starts
+		uint8_t     _servMaxConn;
+		uint16_t    _servIdleS;
 		//  List of all opened sockets (clients) currently communicating with
 		//  ESP. It's important that pointers itself are volatile, not _espClient
 		//  object because pointers get changed within ISR. Array index is socket ID!
 		_espClient volatile *_clients[ESP_MAX_CLI];
+		//  Set by watchdog ISR to notify UART ISR that communication timed out
+		volatile bool       _wdFired;
+		//  Statistics of ESP replies, one entry per command type (ESP_CMD_*)
+		_espCmdStats        _cmdStats[ESP_CMD_NUM];
+		//  Timeout estimators, one entry per command type (ESP_CMD_*)
+		_espRTOEst          _rto[ESP_CMD_NUM];
+		//  Specifies whether timeouts are adapted to measured latency
+		bool                _rtoEnabled;
+		//  Socket sends waiting to be retried after "busy...", in queuing order
+		_espRetryEntry      _retryQ[ESP_RETRYQ_LEN];
+		uint8_t             _retryQLen;
+		//  State of pseudo-random generator (backoff jitter, link test)
+		uint32_t            _rndState;
+		//  Current and ESP's default (after restart) baud-rate
+		uint32_t            _baud;
+		uint32_t            _defBaud;
+		//  Results of link tests from the last baud-rate negotiation
+		_espLinkTest        _linkTest[ESP_BAUD_CAND_NUM];
+		//  Echo of link test command is captured by parser (CRC and length)
+		volatile bool       _echoCapture;
+		volatile uint16_t   _echoCRC;
+		volatile uint16_t   _echoLen;
+		//  Specifies whether RTS/CTS flow control is in use
+		bool                _flowCtrl;
+		//  Specifies whether ESP is in passthrough mode, time of last write
+		volatile bool       _ptMode;
+		uint32_t            _ptLastTxMS;
+		//  Reply to AT+CIPSENDBUF ("<segment>,<last sent segment>") is captured
+		//  by parser
+		volatile bool       _sbSegCapture;
+		volatile uint32_t   _sbSegID;
+		volatile uint32_t   _sbSegAcked;
+		//  Specifies whether passive receive mode is used, socket ID data is
+		//  being pulled from
+		bool                _passiveRx;
+		volatile uint8_t    _rxPullID;
+		//  Specifies whether ESP reports remote IP and port in +IPD header
+		bool                _dinfo;
+		//  Shadow of ESP settings, number of commands skipped thanks to it
+		_espConfig          _cfg;
+		uint32_t            _cfgSkips;
+		//  Fast-join profile; start of join being timed and its kind
+		_espJoinProfile     _join;
+		volatile bool       _joinTiming;
+		bool                _joinWarm;
+		uint32_t            _joinStartMS;
+		//  AP joined in non-blocking mode, cache its parameters once connected
+		bool                _joinQuery;
+		//  Commands waiting for their terminal status from ESP
+		_espPendCmd         _pend[ESP_PEND_LEN];
+		uint32_t            _pendSeq;
+		//  Entry (and its sequence number) completed by the last WD timeout
+		volatile int8_t     _wdSlot;
+		volatile uint32_t   _wdSeq;
+		//  Queue of unsolicited events, written in ISR and read by application
+		_espEvent           _evQ[ESP_EVQ_LEN];
+		volatile uint8_t    _evHead;
+		volatile uint8_t    _evTail;
+		//  Transmit scheduler: statistics and socket to serve next in each
+		//  priority class, backoff after ESP rejected a chunk with "busy..."
+		_espTxStats         _txStats[ESP_PRIO_NUM];
+		uint8_t             _txRR[ESP_PRIO_NUM];
+		uint32_t            _txHoldMS;
+		uint8_t             _txBusyN;
+		//  Rate limit of data sent through all sockets of this ESP
+		_espRateLimit       _rate;
 		//  Interface with task scheduler - provides memory space and function
 		//  to call in order for task scheduler to request service from this module
 #if defined(__USE_TASK_SCHEDULER__)
@@ -0,0 +1,280 @@
+/**
+ * espBond.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ */
+#include "espBond.h"
+#include "espClient.h"
+
+#include <string.h>
+
+///-----------------------------------------------------------------------------
+///                      Class constructor & destructor                [PUBLIC]
+///-----------------------------------------------------------------------------
+ESPBond::ESPBond()
+{
+    Reset();
+}
+
+///-----------------------------------------------------------------------------
+///                      Bonded stream                                  [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Add socket to the bond
+ * Socket has to be an open TCP socket, normally on a different ESP than other
+ * links (bonding sockets of the same ESP gives no extra throughput). Links
+ * should be added before anything is written.
+ * @param esp ESP instance socket is opened on
+ * @param sockID socket ID on [esp]
+ * @return true: if link was added
+ *        false: if there's no room for more links or socket doesn't exist
+ */
+bool ESPBond::AddLink(ESP8266 *esp, uint8_t sockID)
+{
+    if ((_linkN >= ESP_BOND_MAX_LINKS) || (esp == 0) ||
+        (esp->GetClientBySockID(sockID) == 0))
+        return false;
+
+    _esp[_linkN] = esp;
+    _sockID[_linkN] = sockID;
+    _up[_linkN] = true;
+    _sent[_linkN] = 0;
+    _unackHead[_linkN] = 0;
+    _unackN[_linkN] = 0;
+    _unackBytes[_linkN] = 0;
+    _linkN++;
+
+    return true;
+}
+
+/**
+ * Remove all links and start a new stream (sequence number 0)
+ */
+void ESPBond::Reset()
+{
+    memset((void*)_esp, 0, sizeof(_esp));
+    memset((void*)_up, 0, sizeof(_up));
+    memset((void*)_sent, 0, sizeof(_sent));
+    memset((void*)_unackHead, 0, sizeof(_unackHead));
+    memset((void*)_unackN, 0, sizeof(_unackN));
+    memset((void*)_unackBytes, 0, sizeof(_unackBytes));
+    _linkN = 0;
+    _seq = 0;
+}
+
+/**
+ * Write data to bonded stream
+ * Data is cut into frames of up to ESP_BOND_MAX_PAYLOAD bytes, each one sent on
+ * the link with the least data in flight. Doesn't wait for frames to be sent,
+ * only for ESP to take them into its buffer. If all links are full (or down),
+ * or ESP_BOND_RX_WIN frames after the oldest unacknowledged one were already
+ * sent, function returns early; the rest of the data should be written again
+ * later.
+ * @param buffer data to write
+ * @param bufLen length of data in [buffer]
+ * @return number of bytes from [buffer] taken into the stream
+ */
+uint16_t ESPBond::Write(const char *buffer, uint16_t bufLen)
+{
+    uint16_t written = 0;
+
+    while (written < bufLen)
+    {
+        uint16_t len = bufLen - written;
+        uint8_t tried = 0;
+        int8_t link;
+
+        if (len > ESP_BOND_MAX_PAYLOAD)
+            len = ESP_BOND_MAX_PAYLOAD;
+
+        //  Receiver can't hold frames further ahead of a missing one
+        for (uint8_t i = 0; i < _linkN; i++)
+            _Acked(i);
+        if (!_InWindow())
+            break;
+
+        //  Header: sequence number and length, both big endian
+        _frame[0] = (char)(_seq >> 24);
+        _frame[1] = (char)(_seq >> 16);
+        _frame[2] = (char)(_seq >> 8);
+        _frame[3] = (char)_seq;
+        _frame[4] = (char)(len >> 8);
+        _frame[5] = (char)len;
+        memcpy(_frame + ESP_BOND_HDR_LEN, buffer + written, len);
+
+        //  Try links from the least loaded one until one takes the frame
+        while ((link = _PickLink(len + ESP_BOND_HDR_LEN, tried)) >= 0)
+        {
+            _espClient *cli = _esp[link]->GetClientBySockID(_sockID[link]);
+            uint32_t status;
+
+            tried |= (1 << link);
+            if (cli == 0)
+            {
+                _up[link] = false;
+                continue;
+            }
+
+            status = cli->SendBuffered(_frame, len + ESP_BOND_HDR_LEN);
+            if (status & ESP_STATUS_RECV)
+                break;
+        }
+
+        //  No link could take the frame at the moment
+        if (link < 0)
+            break;
+
+        //  Link's frames are acknowledged in order they were sent
+        {
+            uint8_t i = (_unackHead[link] + _unackN[link]) % ESP_BOND_RX_WIN;
+
+            _unacked[link][i].seq = _seq;
+            _unacked[link][i].len = len + ESP_BOND_HDR_LEN;
+            _unackN[link]++;
+            _unackBytes[link] += len + ESP_BOND_HDR_LEN;
+        }
+        _sent[link] += len;
+        _seq++;
+        written += len;
+    }
+
+    return written;
+}
+
+/**
+ * Get number of links in the bond
+ * @return number of links
+ */
+uint8_t ESPBond::Links()
+{
+    return _linkN;
+}
+
+/**
+ * Check if link is still usable (its socket is open)
+ * @param link index of link, in order links were added
+ * @return true: if link is up
+ *        false: if link is down or doesn't exist
+ */
+bool ESPBond::LinkUp(uint8_t link)
+{
+    if (link >= _linkN)
+        return false;
+
+    if (_up[link] && (_esp[link]->GetClientBySockID(_sockID[link]) == 0))
+        _up[link] = false;
+
+    return _up[link];
+}
+
+/**
+ * Get number of payload bytes sent on a link (used to check how stream is
+ * distributed between links)
+ * @param link index of link, in order links were added
+ * @return number of bytes
+ */
+uint32_t ESPBond::BytesSent(uint8_t link)
+{
+    if (link >= _linkN)
+        return 0;
+
+    return _sent[link];
+}
+
+/**
+ * Get sequence number of the next frame
+ * @return sequence number (equals number of frames sent so far)
+ */
+uint32_t ESPBond::NextSeq()
+{
+    return _seq;
+}
+
+///-----------------------------------------------------------------------------
+///                      Bonded stream                                 [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Find link with the least data in flight which has room for a frame
+ * @param frameLen length of frame to send
+ * @param tried bit mask of links already tried for this frame
+ * @return index of link, -1 if no link can take the frame
+ */
+int8_t ESPBond::_PickLink(uint16_t frameLen, uint8_t tried)
+{
+    int8_t best = -1;
+    uint16_t bestLoad = 0xFFFF;
+
+    for (uint8_t i = 0; i < _linkN; i++)
+    {
+        _espClient *cli;
+        uint16_t load;
+
+        if (!_up[i] || (tried & (1 << i)))
+            continue;
+
+        cli = _esp[i]->GetClientBySockID(_sockID[i]);
+        if (cli == 0)
+        {
+            _up[i] = false;
+            continue;
+        }
+
+        load = cli->BytesInFlight();
+        if (((uint32_t)load + frameLen) > ESP_SBUF_WIN_BYTES)
+            continue;
+        if (load < bestLoad)
+        {
+            best = i;
+            bestLoad = load;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Drop frames of a link which ESP has acknowledged, or all of them if the link
+ * is down (they'll never be acknowledged)
+ * Each frame is one segment of ESP's send buffer and the socket carries only
+ * frames of the bond, so frames whose bytes are no longer in flight are
+ * acknowledged.
+ * @param link index of link
+ */
+void ESPBond::_Acked(uint8_t link)
+{
+    _espClient *cli = 0;
+    uint16_t inFlight = 0;
+
+    if (LinkUp(link))
+        cli = _esp[link]->GetClientBySockID(_sockID[link]);
+    if (cli != 0)
+        inFlight = cli->BytesInFlight();
+
+    while ((_unackN[link] > 0) &&
+           ((_unackBytes[link] - _unacked[link][_unackHead[link]].len) >=
+            inFlight))
+    {
+        _unackBytes[link] -= _unacked[link][_unackHead[link]].len;
+        _unackHead[link] = (_unackHead[link] + 1) % ESP_BOND_RX_WIN;
+        _unackN[link]--;
+    }
+}
+
+/**
+ * Check if next frame is within ESP_BOND_RX_WIN frames of the oldest one not
+ * acknowledged on any link
+ * @return true: if next frame can be sent
+ *        false: otherwise
+ */
+bool ESPBond::_InWindow()
+{
+    for (uint8_t i = 0; i < _linkN; i++)
+        if ((_unackN[i] > 0) &&
+            ((_seq - _unacked[i][_unackHead[i]].seq) >= ESP_BOND_RX_WIN))
+            return false;
+
+    return true;
+}
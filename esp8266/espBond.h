@@ -0,0 +1,70 @@
+/**
+ * espBond.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Bonding of TCP sockets opened on several ESP8266 modules into one logical
+ *  stream, to get throughput above what a single module can do. Stream is cut
+ *  into frames with sequence numbers (format in espBondRx.h), each frame is
+ *  sent on the link with the least data in flight. Receiving side puts frames
+ *  back in order with ESPBondRx.
+ */
+
+#ifndef ROVERKERNEL_ESP8266_ESPBOND_H_
+#define ROVERKERNEL_ESP8266_ESPBOND_H_
+
+#include "esp8266.h"
+#include "espBondRx.h"
+
+/**
+ * ESPBond class - sender of a stream striped across sockets of several ESPs
+ * Frames are sent through ESP's TCP send buffer (_espClient::SendBuffered())
+ * so writing to one module doesn't wait for the other one to send its data.
+ * Faster link acknowledges its data sooner and therefore gets more frames.
+ * Sequence numbers of frames in flight span at most ESP_BOND_RX_WIN frames,
+ * so receiver can hold every frame arriving ahead of a missing one. Frames
+ * in flight on a link that goes down are lost and no longer hold the window.
+ */
+class ESPBond
+{
+    public:
+        ESPBond();
+
+        bool        AddLink(ESP8266 *esp, uint8_t sockID);
+        void        Reset();
+        uint16_t    Write(const char *buffer, uint16_t bufLen);
+        uint8_t     Links();
+        bool        LinkUp(uint8_t link);
+        uint32_t    BytesSent(uint8_t link);
+        uint32_t    NextSeq();
+
+    private:
+        int8_t      _PickLink(uint16_t frameLen, uint8_t tried);
+        void        _Acked(uint8_t link);
+        bool        _InWindow();
+
+        //  Links - sockets are looked up on every use as they can be closed
+        ESP8266     *_esp[ESP_BOND_MAX_LINKS];
+        uint8_t     _sockID[ESP_BOND_MAX_LINKS];
+        bool        _up[ESP_BOND_MAX_LINKS];
+        uint8_t     _linkN;
+        //  Payload bytes sent on each link
+        uint32_t    _sent[ESP_BOND_MAX_LINKS];
+        //  Frames sent on each link and not yet acknowledged by ESP, oldest
+        //  first (ring buffer), and their total length
+        struct
+        {
+            uint32_t    seq;
+            uint16_t    len;
+        }           _unacked[ESP_BOND_MAX_LINKS][ESP_BOND_RX_WIN];
+        uint8_t     _unackHead[ESP_BOND_MAX_LINKS];
+        uint8_t     _unackN[ESP_BOND_MAX_LINKS];
+        uint32_t    _unackBytes[ESP_BOND_MAX_LINKS];
+        //  Sequence number of the next frame
+        uint32_t    _seq;
+        //  Frame being sent (header and payload)
+        char        _frame[ESP_BOND_FRAME_LEN];
+};
+
+#endif /* ROVERKERNEL_ESP8266_ESPBOND_H_ */
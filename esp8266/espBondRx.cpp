@@ -0,0 +1,272 @@
+/**
+ * espBondRx.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ */
+#include "espBondRx.h"
+
+#include <string.h>
+
+///-----------------------------------------------------------------------------
+///                      Class constructor & destructor                [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Create reassembler passing reassembled stream to a given function
+ * @param out function called with each piece of in-order payload, its length
+ * and [ctx]
+ * @param ctx[optional] user-defined context passed to [out]
+ */
+ESPBondRx::ESPBondRx(void((*out)(const uint8_t*, const uint16_t, void*)),
+                     void *ctx) : _out(out), _ctx(ctx)
+{
+    Reset();
+}
+
+///-----------------------------------------------------------------------------
+///                      Reassembling stream                            [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Feed data received on one of the links
+ * Data doesn't have to contain whole frames, partial frame is kept until the
+ * rest of it arrives on the same link.
+ * @param link index of the link data was received on
+ * @param data received data
+ * @param len length of [data]
+ */
+void ESPBondRx::Feed(uint8_t link, const uint8_t *data, uint16_t len)
+{
+    if ((link >= ESP_BOND_MAX_LINKS) || (_down & (1 << link)))
+        return;
+
+    uint8_t *buf = _link[link].buf;
+    uint16_t &bufLen = _link[link].len;
+
+    while (len > 0)
+    {
+        uint16_t need = ESP_BOND_HDR_LEN;
+        uint16_t n;
+
+        //  Once header is complete, length of the rest of frame is known
+        if (bufLen >= ESP_BOND_HDR_LEN)
+            need += ((uint16_t)buf[4] << 8) | buf[5];
+
+        n = need - bufLen;
+        if (n > len)
+            n = len;
+        memcpy(buf + bufLen, data, n);
+        bufLen += n;
+        data += n;
+        len -= n;
+
+        if (bufLen == ESP_BOND_HDR_LEN)
+        {
+            //  Stream is out of sync, nothing on this link can be trusted
+            if ((((uint16_t)buf[4] << 8) | buf[5]) > ESP_BOND_MAX_PAYLOAD)
+            {
+                _invalid++;
+                bufLen = 0;
+                return;
+            }
+        }
+
+        if ((bufLen >= ESP_BOND_HDR_LEN) &&
+            (bufLen == (ESP_BOND_HDR_LEN + (((uint16_t)buf[4] << 8) | buf[5]))))
+        {
+            uint32_t seq = ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) |
+                           ((uint32_t)buf[2] << 8) | buf[3];
+            _Frame(link, seq, buf + ESP_BOND_HDR_LEN,
+                   bufLen - ESP_BOND_HDR_LEN);
+            bufLen = 0;
+        }
+    }
+}
+
+/**
+ * Declare link down (e.g. its socket was closed)
+ * Frames sent on it which didn't arrive are given up on once other links
+ * deliver frames past them. Data fed for the link afterwards is ignored.
+ * @param link index of the link
+ */
+void ESPBondRx::LinkDown(uint8_t link)
+{
+    if (link >= ESP_BOND_MAX_LINKS)
+        return;
+
+    _down |= (1 << link);
+    _link[link].len = 0;
+    _Advance();
+}
+
+/**
+ * Drop all partially received and held frames, bring all links back up and
+ * expect sequence number 0
+ */
+void ESPBondRx::Reset()
+{
+    _nextSeq = 0;
+    _down = 0;
+    for (uint8_t i = 0; i < ESP_BOND_MAX_LINKS; i++)
+    {
+        _link[i].len = 0;
+        _link[i].seen = false;
+    }
+    for (uint8_t i = 0; i < ESP_BOND_RX_WIN; i++)
+        _win[i].used = false;
+    _delivered = 0;
+    _skipped = 0;
+    _invalid = 0;
+}
+
+/**
+ * Get sequence number of the next frame to be delivered
+ * @return sequence number
+ */
+uint32_t ESPBondRx::NextSeq()
+{
+    return _nextSeq;
+}
+
+/**
+ * Get number of payload bytes delivered in order so far
+ * @return number of bytes
+ */
+uint32_t ESPBondRx::BytesDelivered()
+{
+    return _delivered;
+}
+
+/**
+ * Get number of frames given up on because link they were sent on went down
+ * @return number of frames
+ */
+uint32_t ESPBondRx::FramesSkipped()
+{
+    return _skipped;
+}
+
+/**
+ * Get number of frames with invalid header (link was resynchronized), or
+ * dropped because they were too far ahead of the window
+ * @return number of frames
+ */
+uint32_t ESPBondRx::FramesInvalid()
+{
+    return _invalid;
+}
+
+///-----------------------------------------------------------------------------
+///                      Reassembling stream                           [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Handle complete frame received on one of the links
+ * @param link index of the link frame was received on
+ * @param seq sequence number of the frame
+ * @param payload payload of the frame
+ * @param len length of [payload]
+ */
+void ESPBondRx::_Frame(uint8_t link, uint32_t seq, const uint8_t *payload,
+                       uint16_t len)
+{
+    if (!_link[link].seen || ((int32_t)(seq - _link[link].lastSeq) > 0))
+        _link[link].lastSeq = seq;
+    _link[link].seen = true;
+
+    //  Already delivered (or given up on)
+    if ((int32_t)(seq - _nextSeq) < 0)
+        return;
+
+    //  Frame can be that far ahead only if ones before it were lost with a
+    //  link that went down, sender never goes past the window otherwise
+    if ((seq - _nextSeq) >= ESP_BOND_RX_WIN)
+        _Advance();
+    if ((seq - _nextSeq) >= ESP_BOND_RX_WIN)
+    {
+        _invalid++;
+        return;
+    }
+
+    //  Expected frame is delivered straight from link buffer, others wait
+    if (seq == _nextSeq)
+    {
+        _Deliver(payload, len);
+        _nextSeq++;
+    }
+    else
+    {
+        uint8_t i = seq % ESP_BOND_RX_WIN;
+
+        _win[i].used = true;
+        _win[i].seq = seq;
+        _win[i].len = len;
+        memcpy(_win[i].payload, payload, len);
+    }
+
+    _Advance();
+}
+
+/**
+ * Deliver frames held in the window which are next in order, and give up on
+ * missing ones which can't arrive anymore
+ */
+void ESPBondRx::_Advance()
+{
+    while (true)
+    {
+        uint8_t i = _nextSeq % ESP_BOND_RX_WIN;
+
+        if (_win[i].used && (_win[i].seq == _nextSeq))
+        {
+            _Deliver(_win[i].payload, _win[i].len);
+            _win[i].used = false;
+        }
+        else if (_Lost(_nextSeq))
+            _skipped++;
+        else
+            break;
+        _nextSeq++;
+    }
+}
+
+/**
+ * Check if frame which didn't arrive was lost with a link that went down
+ * Links deliver their frames in order, so the frame can still come on any link
+ * which is up and hasn't delivered a frame past it yet.
+ * @param seq sequence number of the frame
+ * @return true: if frame can't arrive anymore
+ *        false: otherwise
+ */
+bool ESPBondRx::_Lost(uint32_t seq)
+{
+    bool ahead = false;
+
+    if (_down == 0)
+        return false;
+
+    for (uint8_t i = 0; i < ESP_BOND_MAX_LINKS; i++)
+    {
+        bool up = !(_down & (1 << i));
+
+        if (_link[i].seen && ((int32_t)(_link[i].lastSeq - seq) > 0))
+            ahead = true;
+        else if (up)
+            return false;
+    }
+
+    return ahead;
+}
+
+/**
+ * Pass in-order payload to output function
+ * @param payload payload to pass
+ * @param len length of [payload]
+ */
+void ESPBondRx::_Deliver(const uint8_t *payload, uint16_t len)
+{
+    _delivered += len;
+    if ((_out != 0) && (len > 0))
+        _out(payload, len, _ctx);
+}
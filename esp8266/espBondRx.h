@@ -0,0 +1,95 @@
+/**
+ * espBondRx.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Reassembler of a stream striped across several links by ESPBond (see
+ *  espBond.h). Doesn't depend on ESP8266 library nor HAL so it can be used on
+ *  the receiving host as well as on the board itself.
+ *
+ *  Every frame of bonded stream is: <seq><len><payload>
+ *      seq - sequence number of the frame, 4B big endian, starts at 0
+ *      len - length of payload, 2B big endian (max. ESP_BOND_MAX_PAYLOAD)
+ */
+
+#ifndef ROVERKERNEL_ESP8266_ESPBONDRX_H_
+#define ROVERKERNEL_ESP8266_ESPBONDRX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*		Bonded stream settings		*/
+//  Max number of links stream is striped across
+#define ESP_BOND_MAX_LINKS      2
+//  Length of frame header (sequence number and length of payload)
+#define ESP_BOND_HDR_LEN        6
+//  Max length of frame, including header (fits in one TCP segment)
+#define ESP_BOND_FRAME_LEN      1460
+#define ESP_BOND_MAX_PAYLOAD    (ESP_BOND_FRAME_LEN - ESP_BOND_HDR_LEN)
+//  Max number of frames received ahead of the next expected one (sender never
+//  has more than this many frames unacknowledged)
+#define ESP_BOND_RX_WIN         8
+
+/**
+ * ESPBondRx class - puts frames received on several links back in order
+ * Data received on each link is fed to Feed() as it comes (frames can be split
+ * arbitrarily). Payload is passed to output function in order of sequence
+ * numbers. Frames arriving ahead of the expected one are held in a window of
+ * ESP_BOND_RX_WIN frames (ESPBond doesn't send further ahead). Each link
+ * delivers its frames in order, so a missing frame is only given up on (and
+ * counted as skipped) once the link it was sent on is declared down with
+ * LinkDown() and every other link has already delivered frames past it.
+ */
+class ESPBondRx
+{
+    public:
+        ESPBondRx(void((*out)(const uint8_t*, const uint16_t, void*)),
+                  void *ctx = 0);
+
+        void        Feed(uint8_t link, const uint8_t *data, uint16_t len);
+        void        LinkDown(uint8_t link);
+        void        Reset();
+        uint32_t    NextSeq();
+        uint32_t    BytesDelivered();
+        uint32_t    FramesSkipped();
+        uint32_t    FramesInvalid();
+
+    private:
+        void        _Frame(uint8_t link, uint32_t seq, const uint8_t *payload,
+                           uint16_t len);
+        void        _Advance();
+        bool        _Lost(uint32_t seq);
+        void        _Deliver(const uint8_t *payload, uint16_t len);
+
+        //  Output function for reassembled stream, and its context
+        void        ((*_out)(const uint8_t*, const uint16_t, void*));
+        void        *_ctx;
+        //  Sequence number of the next frame to deliver
+        uint32_t    _nextSeq;
+        //  Frame being received on each link (header and payload), sequence
+        //  number of the last complete one
+        struct
+        {
+            uint8_t     buf[ESP_BOND_FRAME_LEN];
+            uint16_t    len;
+            bool        seen;
+            uint32_t    lastSeq;
+        }           _link[ESP_BOND_MAX_LINKS];
+        //  Bit mask of links declared down
+        uint8_t     _down;
+        //  Frames received ahead of the next expected one, index is seq % win
+        struct
+        {
+            bool        used;
+            uint32_t    seq;
+            uint16_t    len;
+            uint8_t     payload[ESP_BOND_MAX_PAYLOAD];
+        }           _win[ESP_BOND_RX_WIN];
+        //  Statistics
+        uint32_t    _delivered;
+        uint32_t    _skipped;
+        uint32_t    _invalid;
+};
+
+#endif /* ROVERKERNEL_ESP8266_ESPBONDRX_H_ */
@@ -20,20 +20,44 @@
 ///-----------------------------------------------------------------------------
 ///                      Class constructor & destructor                [PUBLIC]
 ///-----------------------------------------------------------------------------
-_espClient::_espClient() : KeepAlive(true), _parent(0), _id(0) ,_alive(false)
+_espClient::_espClient() : KeepAlive(true), _parent(0), _id(0) ,_alive(false),
+                           _udp(false), _segN(0), _segAcked(0), _segFailed(0),
+                           _rxAvail(0), _remoteIP(0), _remotePort(0),
+                           _handler(0), _handlerCtx(0), _accepted(false),
+                           _activeMS(0), _coalLen(0), _coalThresh(0),
+                           _coalDelayMS(0), _coalStartMS(0)
 {
     _Clear();
+    memset((void*)_txqHead, 0, sizeof(_txqHead));
+    memset((void*)_txqLen, 0, sizeof(_txqLen));
+    memset((void*)&_rate, 0, sizeof(_rate));
 }
 
 _espClient::_espClient(uint8_t id, ESP8266 *par)
-    : KeepAlive(true), _parent(par), _id(id), _alive(true)
+    : KeepAlive(true), _parent(par), _id(id), _alive(true), _udp(false),
+      _segN(0), _segAcked(0), _segFailed(0), _rxAvail(0), _remoteIP(0),
+      _remotePort(0), _handler(0), _handlerCtx(0), _accepted(false),
+      _activeMS(HAL_GetMS()), _coalLen(0), _coalThresh(0), _coalDelayMS(0),
+      _coalStartMS(0)
 {
     _Clear();
+    memset((void*)_txqHead, 0, sizeof(_txqHead));
+    memset((void*)_txqLen, 0, sizeof(_txqLen));
+    memset((void*)&_rate, 0, sizeof(_rate));
 }
 _espClient::_espClient(const _espClient &arg)
-    : KeepAlive(arg.KeepAlive), _parent(arg._parent), _id(arg._id), _alive(arg._alive)
+    : KeepAlive(arg.KeepAlive), _parent(arg._parent), _id(arg._id),
+      _alive(arg._alive), _udp(arg._udp), _segN(0), _segAcked(0),
+      _segFailed(0), _rxAvail(0), _remoteIP(arg._remoteIP),
+      _remotePort(arg._remotePort), _handler(arg._handler),
+      _handlerCtx(arg._handlerCtx), _accepted(arg._accepted),
+      _activeMS(arg._activeMS), _coalLen(0), _coalThresh(arg._coalThresh),
+      _coalDelayMS(arg._coalDelayMS), _coalStartMS(0)
 {
     _Clear();
+    memset((void*)_txqHead, 0, sizeof(_txqHead));
+    memset((void*)_txqLen, 0, sizeof(_txqLen));
+    memset((void*)&_rate, 0, sizeof(_rate));
 }
 
 void _espClient::operator= (const _espClient &arg)
@@ -41,6 +65,13 @@ void _espClient::operator= (const _espClient &arg)
     _parent = arg._parent;
     _id = arg._id;
     _alive = arg._alive;
+    _udp = arg._udp;
+    _remoteIP = arg._remoteIP;
+    _remotePort = arg._remotePort;
+    _handler = arg._handler;
+    _handlerCtx = arg._handlerCtx;
+    _accepted = arg._accepted;
+    _activeMS = arg._activeMS;
     _respRdy = arg._respRdy;
     KeepAlive = arg.KeepAlive;
     memcpy((void*)RespBody, (void*)(arg.RespBody), sizeof(RespBody));
@@ -52,6 +83,15 @@ void _espClient::operator= (const _espClient &arg)
 
 /**
  * Send data to a client over open TCP socket
+ * If ESP rejects the request with "busy..." data is put into retry queue and
+ * sent from ESP8266::Service() after backoff expires. In that case (or if
+ * earlier data of this socket is still waiting in the queue) data is copied
+ * into the queue and ESP_STATUS_BUSY is returned; [buffer] can be reused right
+ * away. If data can't be queued it's dropped and ESP_STATUS_ERROR is returned.
+ * If coalescing is enabled (Coalesce()), writes shorter than its threshold are
+ * copied into coalescing buffer instead: ESP_STATUS_OK is returned once data
+ * is taken, ESP_STATUS_BUSY if it couldn't be (buffered data is still waiting
+ * to be sent) and the call has to be repeated.
  * @param buffer NULL-TERMINATED(!) data to send
  * @param bufferLen[optional] len of the buffer, if not provided function looks
  * for first occurrence of \0 in buffer and takes that as length
@@ -60,7 +100,6 @@ void _espClient::operator= (const _espClient &arg)
 uint32_t _espClient::SendTCP(char *buffer, uint16_t bufferLen)
 {
     uint16_t bufLen = bufferLen;
-    uint8_t numStr[6] = {0};
 
     //  If buffer length is not provided find it by looking for \0 char in string
     if (bufferLen == 0)
@@ -70,41 +109,441 @@ uint32_t _espClient::SendTCP(char *buffer, uint16_t bufferLen)
         bufLen--;   //Exclude \0 char from size of buffer
     }
 
-    memset(_commBuf, 0, sizeof(_commBuf));
-    strcat(_commBuf, "AT+CIPSEND=");
+    //  In passthrough mode socket is a raw byte stream, no handshake needed
+    if (_parent->_ptMode)
+    {
+        _parent->_PTWrite(buffer, bufLen);
+        _activeMS = HAL_GetMS();
+        return ESP_STATUS_OK;
+    }
+
+    //  (data can be left in buffer after coalescing got disabled)
+    if ((_coalThresh > 0) || (_coalLen > 0))
+    {
+        //  Buffered data goes first if new data doesn't fit with it
+        if ((_coalLen + bufLen) > _coalThresh)
+        {
+            Flush();
+            if (_coalLen > 0)
+                return ESP_STATUS_BUSY;
+        }
+        //  Small write is merged, the rest is sent on its own
+        if (bufLen < _coalThresh)
+        {
+            if (_coalLen == 0)
+                _coalStartMS = HAL_GetMS();
+            memcpy(_coal + _coalLen, buffer, bufLen);
+            _coalLen += bufLen;
+            if (_coalLen >= _coalThresh)
+                Flush();
+            return ESP_STATUS_OK;
+        }
+    }
+
+    return _SendNow(buffer, bufLen);
+}
+
+/**
+ * Merge small writes of SendTCP() and send them together (Nagle-style)
+ * Writes shorter than [threshold] are copied into a buffer, which is sent with
+ * a single AT+CIPSEND once it holds [threshold] bytes, once the oldest data in
+ * it waited [delayMS] (sent from ESP8266::Service()), or on Flush(). Saves the
+ * command, '>' prompt and SEND OK round trip for every tiny write.
+ * @param threshold size at which buffered data is sent (max. ESP_COAL_LEN),
+ * 0 to disable coalescing (buffered data is flushed)
+ * @param delayMS longest time data is kept in buffer (ms)
+ * @return status of flushing buffered data when coalescing is disabled,
+ *         ESP_STATUS_OK otherwise
+ */
+uint32_t _espClient::Coalesce(uint16_t threshold, uint16_t delayMS)
+{
+    if (threshold > ESP_COAL_LEN)
+        threshold = ESP_COAL_LEN;
+
+    //  Data already buffered shouldn't wait for a bigger threshold
+    if ((threshold == 0) || (threshold < _coalLen))
+    {
+        _coalDelayMS = 0;
+        _coalThresh = threshold;
+        return Flush();
+    }
+
+    _coalThresh = threshold;
+    _coalDelayMS = delayMS;
+    return ESP_STATUS_OK;
+}
+
+/**
+ * Send data waiting in coalescing buffer right away, e.g. before a latency
+ * sensitive message or one that should go out together with buffered data
+ * If it can't be sent now (ESP busy, older data waiting for retry or over rate
+ * limit) data stays in buffer and is tried again from ESP8266::Service().
+ * @return status of send process, ESP_STATUS_OK if there's nothing to send,
+ *         ESP_STATUS_BUSY if data stays in buffer
+ */
+uint32_t _espClient::Flush()
+{
+    uint32_t retVal;
+
+    if (_coalLen == 0)
+        return ESP_STATUS_OK;
+
+    //  Older data waiting for retry (or for tokens) goes first
+    if (SendPending() || !_parent->_RateAllow(this, _coalLen, 0))
+        return ESP_STATUS_BUSY;
+
+    retVal = _Send(_coal, _coalLen);
+    if (_parent->_IsBusyOnly(retVal))
+        return retVal;
+
+    _coalLen = 0;
+    return retVal;
+}
+
+/**
+ * Send a single datagram through UDP socket
+ * Each call results in exactly one datagram. Datagrams are not retried: if ESP
+ * is busy (or datagram is over rate limit), ESP_STATUS_BUSY is returned and
+ * datagram is dropped.
+ * @param buffer data to send
+ * @param bufLen length of data in [buffer] (max. 2048 bytes)
+ * @param ipAddr[optional] IP address to send datagram to, if different from
+ * the one socket was opened with
+ * @param port[optional] port to send datagram to (used with [ipAddr])
+ * @return status of send process (binary or of ESP_* flags received while
+ *         sending)
+ */
+uint32_t _espClient::SendUDP(const char *buffer, uint16_t bufLen, char *ipAddr,
+                             uint16_t port)
+{
+    if (!_udp || _parent->_ptMode || (bufLen > 2048))
+        return ESP_STATUS_ERROR;
+    if (!_parent->_RateAllow(this, bufLen, ESP_RATE_REFUSE))
+        return ESP_STATUS_BUSY;
+
+    return _Send(buffer, bufLen, ipAddr, port);
+}
+
+/**
+ * Check whether this is a UDP socket
+ * @return true: if socket is UDP
+ *        false: if socket is TCP
+ */
+bool _espClient::IsUDP()
+{
+    return _udp;
+}
+
+/**
+ * Check if any data sent through this socket is waiting in the retry queue
+ * @return true: if there's data waiting to be retried
+ *        false: otherwise
+ */
+bool _espClient::SendPending()
+{
+    for (uint8_t i = 0; i < _parent->_retryQLen; i++)
+        if (_parent->_retryQ[i].cli == this)
+            return true;
+
+    return false;
+}
+
+/**
+ * Send data through ESP's TCP send buffer (AT+CIPSENDBUF) without waiting for
+ * it to be sent
+ * ESP assigns each buffered segment an ID and reports "<id>,<segment>,SEND OK"
+ * once it's been sent. Segments not yet acknowledged are kept in a window, so
+ * several of them can be outstanding at the same time (limited by number of
+ * segments and bytes in flight, see ESP_SBUF_*).
+ * @note Data is copied into ESP's buffer, [buffer] can be reused on return
+ * @param buffer data to send
+ * @param bufLen length of data in [buffer]
+ * @return status of send process, ESP_STATUS_BUSY if window is full (or ESP
+ * replied with "busy...", or data is over rate limit), call again once some
+ * segments are acknowledged
+ */
+uint32_t _espClient::SendBuffered(const char *buffer, uint16_t bufLen)
+{
+    uint8_t numStr[6] = {0};
+    uint32_t retVal;
+
+    if (_parent->_ptMode || (bufLen == 0) || (bufLen > ESP_SBUF_WIN_BYTES))
+        return ESP_STATUS_ERROR;
+
+    //  Keep window within limits, ESP would reject data otherwise
+    _SegPrune();
+    if ((_segN >= ESP_SBUF_WIN_SEG) ||
+        ((BytesInFlight() + bufLen) > ESP_SBUF_WIN_BYTES))
+        return ESP_STATUS_BUSY;
+    if (!_parent->_RateAllow(this, bufLen, ESP_RATE_REFUSE))
+        return ESP_STATUS_BUSY;
+
+    memset(_parent->_commBuf, 0, sizeof(_parent->_commBuf));
+    strcat(_parent->_commBuf, "AT+CIPSENDBUF=");
     itoa(_id, numStr);
-    strcat(_commBuf, (char*)numStr);
-    strcat(_commBuf, ",");
+    strcat(_parent->_commBuf, (char*)numStr);
+    strcat(_parent->_commBuf, ",");
     memset(numStr, 0, sizeof(numStr));
     itoa(bufLen, numStr);
-    strcat(_commBuf, (char*)numStr);
+    strcat(_parent->_commBuf, (char*)numStr);
 
-    if (_parent->_SendRAW(_commBuf, ESP_STATUS_RECV, 600))
-    {
-        _parent->flowControl = ESP_NO_STATUS;
-        HAL_ESP_WDControl(true, 600);
+    //  ESP replies with ID of this segment and the last one sent
+    _parent->_sbSegCapture = true;
+    _parent->_sbSegID = 0;
+    retVal = _parent->_SendRAW(_parent->_commBuf, ESP_STATUS_RECV, 600);
+    _parent->_sbSegCapture = false;
+
+    //  Proceed with writing data only once ESP has sent '>' prompt
+    if (!_parent->_InStatus(retVal, ESP_STATUS_RECV))
+        return retVal;
+
+    //  If ESP is not in server mode we need to manually start listening
+    //  for incoming data from ESP
+    if (!_parent->_servOpen)
+        HAL_ESP_IntEnable(_parent->_port, true);
 
-        //  If ESP is not in server mode we need to manually start listening
-        //  for incoming data from ESP
-        if (!_parent->_servOpen)
-            HAL_ESP_IntEnable(true);
+    //  ESP takes exactly [bufLen] bytes, anything after is a new command
+    _parent->_RAWPortWrite(buffer, bufLen);
+    _parent->_RateTake(this, bufLen);
+    _activeMS = HAL_GetMS();
 
-        //  Write data we want to send
-        _parent->_RAWPortWrite(buffer, bufLen);
+    _seg[_segN].id = _parent->_sbSegID;
+    _seg[_segN].len = bufLen;
+    _segN++;
+    //  Everything up to the segment reported as sent has been acknowledged
+    if (_parent->_sbSegAcked > _segAcked)
+        _segAcked = _parent->_sbSegAcked;
 
-        //  Listen for potential response
-        while (_parent->flowControl == ESP_NO_STATUS);
+    return retVal;
+}
+
+/**
+ * Send data gathered from several buffers as one piece (one AT+CIPSEND),
+ * without copying it together first, e.g. header and body of a message
+ * Waits for ESP to send data. Data isn't queued for later: ESP_STATUS_BUSY
+ * means it wasn't sent because ESP answered "busy...", older data of this
+ * socket is still waiting (retry queue, coalescing buffer) or it's over rate
+ * limit, call can be repeated.
+ * @param parts array of [n] pointers to data
+ * @param lens array of [n] lengths of data in [parts]
+ * @param n number of parts
+ * @return status of send process (binary or of ESP_* flags received while
+ *         sending)
+ */
+uint32_t _espClient::SendGather(const char *const *parts, const uint16_t *lens,
+                                uint8_t n)
+{
+    uint32_t total = 0;
+
+    for (uint8_t i = 0; i < n; i++)
+        total += lens[i];
+    if ((total == 0) || (total > 2048))
+        return ESP_STATUS_ERROR;
+
+    //  In passthrough mode socket is a raw byte stream, no handshake needed
+    if (_parent->_ptMode)
+    {
+        for (uint8_t i = 0; i < n; i++)
+            _parent->_PTWrite(parts[i], lens[i]);
+        _activeMS = HAL_GetMS();
+        return ESP_STATUS_OK;
     }
-    //   Stop watchdog timer (started in ISR)
-    //HAL_ESP_WDControl(false, 0);
-    return _parent->flowControl;
+
+    //  Preserve order of data - data written earlier goes first
+    Flush();
+    if ((_coalLen > 0) || SendPending() ||
+        !_parent->_RateAllow(this, total, ESP_RATE_REFUSE))
+        return ESP_STATUS_BUSY;
+
+    return _SendV(parts, lens, n);
 }
+
+/**
+ * Get number of bytes buffered in ESP and not yet acknowledged as sent
+ * @return bytes in flight
+ */
+uint16_t _espClient::BytesInFlight()
+{
+    uint16_t retVal = 0;
+
+    _SegPrune();
+    for (uint8_t i = 0; i < _segN; i++)
+        retVal += _seg[i].len;
+
+    return retVal;
+}
+
+/**
+ * Get number of buffered segments sent through AT+CIPSENDBUF that ESP failed to
+ * send ("<id>,<segment>,SEND FAIL")
+ * @return number of failed segments
+ */
+uint32_t _espClient::SegmentsFailed()
+{
+    return _segFailed;
+}
+
+/**
+ * Queue data for priority transmit scheduler
+ * Data is sent from ESP8266::Service() in chunks of up to ESP_TXQ_CHUNK bytes,
+ * higher priority classes first. Between chunks, data of a higher class queued
+ * on another socket is sent before the rest of this entry. On the same socket
+ * an entry started is always finished first, so the stream isn't interleaved.
+ * [buffer] is not copied and has to remain valid until the entry is sent
+ * (TxQueued() drops). Not to be mixed with SendTCP() on the same socket, their
+ * order isn't kept.
+ * @param buffer data to send
+ * @param bufLen length of data in [buffer]
+ * @param prio[optional] priority class, one of ESP_PRIO_* values
+ * @return ESP_STATUS_OK if data was queued, ESP_STATUS_BUSY if queue of the
+ *         class is full, ESP_STATUS_ERROR if data can't be sent this way (UDP
+ *         socket, passthrough mode)
+ */
+uint32_t _espClient::SendQueued(const char *buffer, uint16_t bufLen,
+                                uint8_t prio)
+{
+    if ((prio >= ESP_PRIO_NUM) || (bufLen == 0) || _udp || _parent->_ptMode)
+        return ESP_STATUS_ERROR;
+    if (_txqLen[prio] >= ESP_TXQ_LEN)
+        return ESP_STATUS_BUSY;
+
+    _espTxEntry &ent = _txq[prio][(_txqHead[prio] + _txqLen[prio]) %
+                                  ESP_TXQ_LEN];
+    ent.buf = buffer;
+    ent.len = bufLen;
+    ent.sent = 0;
+    ent.queuedMS = HAL_GetMS();
+    ent.held = false;
+    _txqLen[prio]++;
+    _parent->_txStats[prio].queued++;
+
+    return ESP_STATUS_OK;
+}
+
+/**
+ * Get number of entries of a priority class waiting for transmit scheduler
+ * @param prio priority class, one of ESP_PRIO_* values
+ * @return number of entries (including one being sent)
+ */
+uint8_t _espClient::TxQueued(uint8_t prio)
+{
+    if (prio >= ESP_PRIO_NUM)
+        return 0;
+
+    return _txqLen[prio];
+}
+
+/**
+ * Limit rate of data sent through this socket (token bucket)
+ * Applies to all ways of sending: data over the limit is held back and sent
+ * later when it went through retry queue (SendTCP()) or transmit scheduler
+ * (SendQueued()), otherwise ESP_STATUS_BUSY is returned (SendBuffered(),
+ * SendUDP()). Limit of the whole ESP (ESP8266::RateLimit()) applies as well.
+ * Passthrough mode isn't limited.
+ * @param rate allowed rate in bytes per second, 0 to remove the limit
+ * @param burst[optional] longest burst in bytes sent at full speed, 0 for
+ * one second worth of data
+ */
+void _espClient::RateLimit(uint32_t rate, uint32_t burst)
+{
+    _parent->_RateSet(_rate, rate, burst);
+}
+
+/**
+ * Get rate limit of this socket, including counters of bytes held back (sent
+ * later) and refused by it
+ * @return pointer to rate limit
+ */
+const _espRateLimit* _espClient::GetRateLimit()
+{
+    return &_rate;
+}
+
+/**
+ * Get number of received bytes waiting in ESP to be pulled (passive receive
+ * mode, see ESP8266::PassiveRecv())
+ * @return number of bytes
+ */
+uint16_t _espClient::RecvPending()
+{
+    return _rxAvail;
+}
+
+/**
+ * Get IP address of the sender of the last data received on this socket
+ * Known only if reporting of remote endpoint is enabled (see
+ * ESP8266::RemoteInfo()), for UDP sockets it can differ between datagrams
+ * @return IP address in decimal format (first octet in MSB), 0 if unknown
+ */
+uint32_t _espClient::RemoteIP()
+{
+    return _remoteIP;
+}
+
+/**
+ * Get port of the sender of the last data received on this socket
+ * (see RemoteIP())
+ * @return remote port, 0 if unknown
+ */
+uint16_t _espClient::RemotePort()
+{
+    return _remotePort;
+}
+
+/**
+ * Get ID of socket this client is bound to (as used by ESP, 0-4)
+ * @return socket ID
+ */
+uint8_t _espClient::SockID()
+{
+    return _id;
+}
+
+/**
+ * Check if this is a connection accepted by TCP server of ESP (as opposed to
+ * a socket opened by this library)
+ * @return true: if client connected to the server
+ *        false: otherwise
+ */
+bool _espClient::Accepted()
+{
+    return _accepted;
+}
+
+/**
+ * Get time since data was last sent or received on this socket
+ * @return time in ms
+ */
+uint32_t _espClient::IdleMS()
+{
+    return HAL_GetMS() - _activeMS;
+}
+
+/**
+ * Set handler of data received on this socket
+ * Handler is called instead of the global hook (ESP8266::AddHook()), with this
+ * client, received data and [ctx], so state of the handler doesn't have to be
+ * kept in globals. It's called from the same context as the global hook would
+ * be (task scheduler or ISR). Data of one +IPD always comes in one call.
+ * @param handler function to call with received data, NULL(0) to use global
+ * hook again
+ * @param ctx[optional] user-defined context passed to [handler]
+ */
+void _espClient::SetHandler(void((*handler)(_espClient*, const uint8_t*,
+                                            const uint16_t, void*)),
+                            void *ctx)
+{
+    _handler = handler;
+    _handlerCtx = ctx;
+}
+
 /**
  * Read response from TCP socket(client) saved in internal buffer
  * Internal buffer with response is filled as soon as response is received in
  * an interrupt. This function only copies response from internal buffer to a
  * user provided one and then clears internal (and data-ready flag).
- * @param buffer pointer to user-provided buffer for incoming data
+ * @param buffer pointer to user-provided buffer for incoming data, must hold
+ * ESP_RX_BUF_LEN bytes (data of one +IPD)
  * @param bufferLen used to return [buffer] size to user
  * @return true: if response was present and is copied into the provided buffer
  *        false: if no response is available
@@ -115,12 +554,10 @@ bool _espClient::Receive(char *buffer, uint16_t *bufferLen)
     //  Check if there's new data received
     if (_respRdy)
     {
-        //  Fill argument buffer
-        while(RespBody[(*bufferLen)] != 0)
-        {
-            buffer[(*bufferLen)] = RespBody[(*bufferLen)];
-            (*bufferLen)++;
-        }
+        //  Fill argument buffer, use length of data as received so that
+        //  binary data (and datagram boundaries) are preserved
+        (*bufferLen) = RespLen;
+        memcpy((void*)buffer, (void*)RespBody, RespLen);
 
         //  Clear response body & flag
         _Clear();
@@ -186,13 +623,172 @@ uint32_t _espClient::Close()
 {
     uint8_t strNum[6] = {0};
 
-    memset(_commBuf, 0, sizeof(_commBuf));
-    strcat(_commBuf, "AT+CIPCLOSE=");
+    memset(_parent->_commBuf, 0, sizeof(_parent->_commBuf));
+    strcat(_parent->_commBuf, "AT+CIPCLOSE=");
     itoa(_id, strNum);
-    strcat(_commBuf, (char*)strNum);
+    strcat(_parent->_commBuf, (char*)strNum);
 
     _alive = false;
-    return _parent->_SendRAW(_commBuf);
+    return _parent->_SendRAW(_parent->_commBuf);
+}
+
+/**
+ * Send data over TCP socket (see SendTCP()), bypassing coalescing buffer
+ * @param buffer data to send
+ * @param bufLen length of data in [buffer]
+ * @return status of send process
+ */
+uint32_t _espClient::_SendNow(const char *buffer, uint16_t bufLen)
+{
+    uint32_t retVal;
+
+    //  Preserve order of data - queue behind data already waiting for retry
+    if (SendPending())
+        return _parent->_RetryQueue(this, buffer, bufLen, false);
+    //  Over rate limit, data is sent from retry queue once there are tokens
+    if (!_parent->_RateAllow(this, bufLen, ESP_RATE_DEFER))
+        return _parent->_RetryQueue(this, buffer, bufLen, false);
+
+    retVal = _Send(buffer, bufLen);
+    if (_parent->_IsBusyOnly(retVal))
+        return _parent->_RetryQueue(this, buffer, bufLen, true);
+
+    return retVal;
+}
+
+/**
+ * Make a single attempt of sending data over open socket
+ * @param buffer data to send
+ * @param bufLen length of data in [buffer]
+ * @param ipAddr[optional] remote IP address (UDP only, 0 for default one)
+ * @param port[optional] remote port (UDP only, used with [ipAddr])
+ * @return status of send process (binary or of ESP_* flags received while
+ *         sending), ESP_STATUS_BUSY if ESP rejected the request with "busy..."
+ */
+uint32_t _espClient::_Send(const char *buffer, uint16_t bufLen, char *ipAddr,
+                           uint16_t port)
+{
+    return _SendV(&buffer, &bufLen, 1, ipAddr, port);
+}
+
+/**
+ * Make a single attempt of sending data gathered from several buffers over
+ * open socket, as one piece of data
+ * @param parts array of [n] pointers to data
+ * @param lens array of [n] lengths of data in [parts]
+ * @param n number of parts
+ * @param ipAddr[optional] remote IP address (UDP only, 0 for default one)
+ * @param port[optional] remote port (UDP only, used with [ipAddr])
+ * @return status of send process (see _Send())
+ */
+uint32_t _espClient::_SendV(const char *const *parts, const uint16_t *lens,
+                            uint8_t n, char *ipAddr, uint16_t port)
+{
+    uint8_t numStr[6] = {0};
+    uint32_t startTick, retVal;
+    uint16_t bufLen = 0;
+    int8_t slot;
+
+    for (uint8_t i = 0; i < n; i++)
+        bufLen += lens[i];
+
+    memset(_parent->_commBuf, 0, sizeof(_parent->_commBuf));
+    strcat(_parent->_commBuf, "AT+CIPSEND=");
+    itoa(_id, numStr);
+    strcat(_parent->_commBuf, (char*)numStr);
+    strcat(_parent->_commBuf, ",");
+    memset(numStr, 0, sizeof(numStr));
+    itoa(bufLen, numStr);
+    strcat(_parent->_commBuf, (char*)numStr);
+    //  Datagram to a remote host other than the default one
+    if (_udp && (ipAddr != 0))
+    {
+        strcat(_parent->_commBuf, ",\"");
+        strcat(_parent->_commBuf, ipAddr);
+        strcat(_parent->_commBuf, "\",");
+        memset(numStr, 0, sizeof(numStr));
+        itoa(port, numStr);
+        strcat(_parent->_commBuf, (char*)numStr);
+    }
+
+    retVal = _parent->_SendRAW(_parent->_commBuf, ESP_STATUS_RECV, 600);
+    //  ESP dropped the request, let the caller decide when to retry
+    if (_parent->_IsBusyOnly(retVal))
+        return retVal;
+
+    //  Proceed with writing data only once ESP has sent '>' prompt
+    if (!_parent->_InStatus(retVal, ESP_STATUS_RECV))
+        return retVal;
+
+    //  Data is a new pending command, terminated by SEND OK/SEND FAIL
+    slot = _parent->_PendPush(ESP_CMD_SENDDATA,
+                              ESP_STATUS_SENDOK | ESP_STATUS_FAIL |
+                              ESP_STATUS_ERROR, ESP_NO_STATUS);
+    if (slot < 0)
+        return ESP_STATUS_ERROR;
+
+    //  If ESP is not in server mode we need to manually start listening
+    //  for incoming data from ESP
+    if (!_parent->_servOpen)
+        HAL_ESP_IntEnable(_parent->_port, true);
+
+    //  Write data we want to send
+    for (uint8_t i = 0; i < n; i++)
+        _parent->_RAWPortWrite(parts[i], lens[i]);
+    startTick = HAL_GetTicks();
+    //  Watchdog only runs once data is written: its timeout is learned from
+    //  latency measured from here, which doesn't include UART time of data
+    HAL_ESP_WDControl(_parent->_port, true,
+                      _parent->GetTimeout(ESP_CMD_SENDDATA, 600));
+    _parent->_RateTake(this, bufLen);
+    _activeMS = HAL_GetMS();
+
+    //  Listen for potential response
+    retVal = _parent->_PendWait(slot);
+    _parent->_StatsRecord(ESP_CMD_SENDDATA, retVal, startTick);
+
+    //   Stop watchdog timer (started in ISR)
+    //HAL_ESP_WDControl(_parent->_port, false, 0);
+    return retVal;
+}
+
+/**
+ * Remove acknowledged segments from the window of buffered sends
+ * @note Acknowledgments are recorded in ISR (_segAcked), segments themselves
+ * are only modified outside of it
+ */
+void _espClient::_SegPrune()
+{
+    uint32_t acked = _segAcked;
+    uint8_t n = 0;
+
+    for (uint8_t i = 0; i < _segN; i++)
+        if (_seg[i].id > acked)
+            _seg[n++] = _seg[i];
+    _segN = n;
+}
+
+/**
+ * Find priority class whose first entry has been partly sent
+ * @return priority class, -1 if no entry is partly sent
+ */
+int8_t _espClient::_TxPartial()
+{
+    for (uint8_t p = 0; p < ESP_PRIO_NUM; p++)
+        if ((_txqLen[p] > 0) && (_txq[p][_txqHead[p]].sent > 0))
+            return p;
+
+    return -1;
+}
+
+/**
+ * Remove first entry from queue of a priority class
+ * @param prio priority class, one of ESP_PRIO_* values
+ */
+void _espClient::_TxPop(uint8_t prio)
+{
+    _txqHead[prio] = (_txqHead[prio] + 1) % ESP_TXQ_LEN;
+    _txqLen[prio]--;
 }
 
 /**
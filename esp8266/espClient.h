@@ -16,12 +16,13 @@ class _espClient;
 
 
 /**
- * _espClient class - wrapper for TCP client connected to ESP server
+ * _espClient class - wrapper for TCP client connected to ESP server (or UDP
+ * socket opened on ESP)
  */
 class _espClient
 {
     friend class    ESP8266;
-    friend void     UART7RxIntHandler(void);
+    friend void     ESPRxISR(ESP8266 &esp);
     public:
         _espClient();
         _espClient(uint8_t id, ESP8266 *par);
@@ -30,6 +31,31 @@ class _espClient
         void        operator= (const _espClient &arg);
 
         uint32_t    SendTCP(char *buffer, uint16_t bufferLen = 0);
+        uint32_t    Coalesce(uint16_t threshold, uint16_t delayMS);
+        uint32_t    Flush();
+        bool        SendPending();
+        uint32_t    SendUDP(const char *buffer, uint16_t bufLen,
+                            char *ipAddr = 0, uint16_t port = 0);
+        bool        IsUDP();
+        uint32_t    SendBuffered(const char *buffer, uint16_t bufLen);
+        uint32_t    SendGather(const char *const *parts, const uint16_t *lens,
+                               uint8_t n);
+        uint32_t    SendQueued(const char *buffer, uint16_t bufLen,
+                               uint8_t prio = ESP_PRIO_BULK);
+        uint8_t     TxQueued(uint8_t prio);
+        void        RateLimit(uint32_t rate, uint32_t burst = 0);
+        const _espRateLimit* GetRateLimit();
+        uint16_t    BytesInFlight();
+        uint32_t    SegmentsFailed();
+        uint16_t    RecvPending();
+        uint32_t    RemoteIP();
+        uint16_t    RemotePort();
+        uint8_t     SockID();
+        bool        Accepted();
+        uint32_t    IdleMS();
+        void        SetHandler(void((*handler)(_espClient*, const uint8_t*,
+                                               const uint16_t, void*)),
+                               void *ctx = 0);
         bool        Receive(char *buffer, uint16_t *bufferLen);
         bool        Ready();
         void        Done();
@@ -38,11 +64,19 @@ class _espClient
         //  Keep socket alive (don't terminate it after first round of communication)
         volatile bool       KeepAlive;
         //  Buffer for data received on this socket
-        volatile char       RespBody[1024];
+        volatile char       RespBody[ESP_RX_BUF_LEN];
         volatile uint16_t   RespLen;
 
     private:
+        uint32_t    _Send(const char *buffer, uint16_t bufLen,
+                          char *ipAddr = 0, uint16_t port = 0);
+        uint32_t    _SendNow(const char *buffer, uint16_t bufLen);
+        uint32_t    _SendV(const char *const *parts, const uint16_t *lens,
+                           uint8_t n, char *ipAddr = 0, uint16_t port = 0);
         void        _Clear();
+        void        _SegPrune();
+        int8_t      _TxPartial();
+        void        _TxPop(uint8_t prio);
 
         //  Pointer to a parent device of of this client
         ESP8266         *_parent;
@@ -50,8 +84,43 @@ class _espClient
         uint8_t         _id;
         //  Specifies whether the socket is alive
         volatile bool   _alive;
+        //  Specifies whether this is a UDP socket
+        bool            _udp;
         //  Specifies whether there's a response from this client ready to read
         volatile bool   _respRdy;
+        //  Segments sent with AT+CIPSENDBUF, not yet acknowledged by ESP
+        _espSegment     _seg[ESP_SBUF_WIN_SEG];
+        uint8_t         _segN;
+        //  Highest segment ID acknowledged by ESP (set in ISR)
+        volatile uint32_t   _segAcked;
+        //  Number of segments ESP failed to send
+        volatile uint32_t   _segFailed;
+        //  Bytes waiting in ESP to be pulled (passive receive mode)
+        volatile uint16_t   _rxAvail;
+        //  Sender of the last received data (AT+CIPDINFO=1), 0 if unknown
+        volatile uint32_t   _remoteIP;
+        volatile uint16_t   _remotePort;
+        //  Handler of data received on this socket and its context
+        void    ((*_handler)(_espClient*, const uint8_t*, const uint16_t,
+                             void*));
+        void    *_handlerCtx;
+        //  Specifies whether this is a connection accepted by the server
+        bool    _accepted;
+        //  Time of the last data sent or received on this socket (ms)
+        volatile uint32_t   _activeMS;
+        //  Data waiting for transmit scheduler, a ring per priority class
+        _espTxEntry     _txq[ESP_PRIO_NUM][ESP_TXQ_LEN];
+        uint8_t         _txqHead[ESP_PRIO_NUM];
+        uint8_t         _txqLen[ESP_PRIO_NUM];
+        //  Rate limit of data sent through this socket
+        _espRateLimit   _rate;
+        //  Small writes merged before sending: buffer, size threshold (0 -
+        //  coalescing disabled), max. time data waits and when it started
+        char            _coal[ESP_COAL_LEN];
+        uint16_t        _coalLen;
+        uint16_t        _coalThresh;
+        uint16_t        _coalDelayMS;
+        uint32_t        _coalStartMS;
 };
 
 #endif /* ROVERKERNEL_ESP8266_ESPCLIENT_H_ */
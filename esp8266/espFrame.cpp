@@ -0,0 +1,102 @@
+/**
+ * espFrame.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ */
+#include "espFrame.h"
+#include "espClient.h"
+
+///-----------------------------------------------------------------------------
+///                      Class constructor & destructor                [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Create sender of length-prefixed messages
+ * @param crc[optional] whether to append CRC to every frame (has to match
+ * receiver)
+ */
+ESPFrame::ESPFrame(bool crc) : _crc(crc), _sent(0)
+{
+}
+
+///-----------------------------------------------------------------------------
+///                      Sending messages                               [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Send a message through TCP socket
+ * Waits for ESP to send the frame (see _espClient::SendGather()).
+ * @param cli client to send message through
+ * @param msg message to send
+ * @param len length of [msg] (max. ESP_FRAME_MAX_LEN)
+ * @return status of send process, ESP_STATUS_ERROR if message is too long,
+ *         ESP_STATUS_BUSY if it couldn't be sent now (call can be repeated)
+ */
+uint32_t ESPFrame::Send(_espClient *cli, const char *msg, uint16_t len)
+{
+    return SendV(cli, &msg, &len, 1);
+}
+
+/**
+ * Send a message made of several pieces (e.g. header and data) through TCP
+ * socket, without copying them together
+ * @param cli client to send message through
+ * @param parts pieces of the message, in order
+ * @param lens length of each of [parts]
+ * @param n number of pieces (max. ESP_FRAME_PARTS)
+ * @return status of send process, ESP_STATUS_ERROR if message is too long,
+ *         ESP_STATUS_BUSY if it couldn't be sent now (call can be repeated)
+ */
+uint32_t ESPFrame::SendV(_espClient *cli, const char *const *parts,
+                         const uint16_t *lens, uint8_t n)
+{
+    uint8_t hdr[ESP_FRAME_HDR_MAX];
+    uint8_t crc[ESP_FRAME_CRC_LEN];
+    const char *frame[ESP_FRAME_PARTS + 2];
+    uint16_t frameLens[ESP_FRAME_PARTS + 2];
+    uint16_t sum;
+    uint32_t retVal, len = 0;
+    uint8_t frameN = 0;
+
+    for (uint8_t i = 0; i < n; i++)
+        len += lens[i];
+    if ((cli == 0) || (n > ESP_FRAME_PARTS) || (len > ESP_FRAME_MAX_LEN))
+        return ESP_STATUS_ERROR;
+
+    frame[frameN] = (const char*)hdr;
+    frameLens[frameN++] = ESPFrameRx::EncodeLen(hdr, len);
+    sum = ESPFrameRx::CRC16(hdr, frameLens[0]);
+    //  Empty pieces are left out, empty message is just the length prefix
+    for (uint8_t i = 0; i < n; i++)
+        if (lens[i] > 0)
+        {
+            frame[frameN] = parts[i];
+            frameLens[frameN++] = lens[i];
+            sum = ESPFrameRx::CRC16((const uint8_t*)parts[i], lens[i], sum);
+        }
+    //  CRC covers length prefix as well as the message
+    if (_crc)
+    {
+        crc[0] = (uint8_t)(sum >> 8);
+        crc[1] = (uint8_t)sum;
+        frame[frameN] = (const char*)crc;
+        frameLens[frameN++] = ESP_FRAME_CRC_LEN;
+    }
+
+    retVal = cli->SendGather(frame, frameLens, frameN);
+    //  Passthrough mode reports plain OK
+    if ((retVal & ESP_STATUS_SENDOK) || (retVal == ESP_STATUS_OK))
+        _sent++;
+
+    return retVal;
+}
+
+/**
+ * Get number of messages sent so far
+ * @return number of messages
+ */
+uint32_t ESPFrame::FramesSent()
+{
+    return _sent;
+}
@@ -0,0 +1,44 @@
+/**
+ * espFrame.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Message framing over TCP sockets of ESP8266. Each message is sent with a
+ *  length prefix (and optional CRC, format in espFrameRx.h), so the receiving
+ *  side gets whole messages regardless of how TCP cut the stream. Messages are
+ *  put back together with ESPFrameRx.
+ */
+
+#ifndef ROVERKERNEL_ESP8266_ESPFRAME_H_
+#define ROVERKERNEL_ESP8266_ESPFRAME_H_
+
+#include "esp8266.h"
+#include "espFrameRx.h"
+
+//  Max number of pieces a message can be sent from (SendV())
+#define ESP_FRAME_PARTS         4
+
+/**
+ * ESPFrame class - sender of length-prefixed messages
+ * Prefix, message and CRC are written to ESP as one piece of data
+ * (_espClient::SendGather()), message itself is never copied.
+ */
+class ESPFrame
+{
+    public:
+        ESPFrame(bool crc = false);
+
+        uint32_t    Send(_espClient *cli, const char *msg, uint16_t len);
+        uint32_t    SendV(_espClient *cli, const char *const *parts,
+                          const uint16_t *lens, uint8_t n);
+        uint32_t    FramesSent();
+
+    private:
+        //  Specifies whether frames carry CRC
+        bool        _crc;
+        //  Number of messages sent
+        uint32_t    _sent;
+};
+
+#endif /* ROVERKERNEL_ESP8266_ESPFRAME_H_ */
@@ -0,0 +1,236 @@
+/**
+ * espFrameRx.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ */
+#include "espFrameRx.h"
+
+#include <string.h>
+
+///-----------------------------------------------------------------------------
+///                      Class constructor & destructor                [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Create reassembler passing received messages to a given function
+ * @param out function called with payload of each message, its length and
+ * [ctx]; payload is only valid until the function returns
+ * @param ctx[optional] user-defined context passed to [out]
+ * @param crc[optional] whether frames carry CRC (has to match sender)
+ */
+ESPFrameRx::ESPFrameRx(void((*out)(const uint8_t*, const uint16_t, void*)),
+                       void *ctx, bool crc) : _out(out), _ctx(ctx), _crc(crc)
+{
+    Reset();
+}
+
+///-----------------------------------------------------------------------------
+///                      Reassembling messages                          [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Feed data received on the socket
+ * Data doesn't have to contain whole frames, partial frame is kept until the
+ * rest of it arrives.
+ * @param data received data
+ * @param len length of [data]
+ */
+void ESPFrameRx::Feed(const uint8_t *data, uint16_t len)
+{
+    uint8_t crcLen = _crc ? ESP_FRAME_CRC_LEN : 0;
+
+    while (len > 0)
+    {
+        uint8_t hdrLen;
+        uint16_t msgLen, n;
+        int8_t hdr;
+
+        //  Frame complete within data is passed on from where it is
+        if (_len == 0)
+        {
+            hdr = _Header(data, len, &hdrLen, &msgLen);
+            if (hdr < 0)
+            {
+                _invalid++;
+                return;
+            }
+            n = hdrLen + msgLen + crcLen;
+            if ((hdr > 0) && (n <= len))
+            {
+                _Frame(data, hdrLen, msgLen);
+                data += n;
+                len -= n;
+                continue;
+            }
+        }
+
+        //  Rest of the frame comes later, collect it in buffer (byte by byte
+        //  until length prefix is complete)
+        hdr = _Header(_buf, _len, &hdrLen, &msgLen);
+        n = (hdr > 0) ? (hdrLen + msgLen + crcLen - _len) : 1;
+        if (n > len)
+            n = len;
+        memcpy(_buf + _len, data, n);
+        _len += n;
+        data += n;
+        len -= n;
+
+        hdr = _Header(_buf, _len, &hdrLen, &msgLen);
+        //  Stream is out of sync, nothing buffered can be trusted
+        if (hdr < 0)
+        {
+            _invalid++;
+            _len = 0;
+            return;
+        }
+        if ((hdr > 0) && (_len == (hdrLen + msgLen + crcLen)))
+        {
+            if (_Frame(_buf, hdrLen, msgLen))
+                _copied++;
+            _len = 0;
+        }
+    }
+}
+
+/**
+ * Drop partially received frame (e.g. when socket is reopened)
+ */
+void ESPFrameRx::Reset()
+{
+    _len = 0;
+    _delivered = 0;
+    _copied = 0;
+    _invalid = 0;
+}
+
+/**
+ * Get number of messages delivered so far
+ * @return number of messages
+ */
+uint32_t ESPFrameRx::FramesDelivered()
+{
+    return _delivered;
+}
+
+/**
+ * Get number of delivered messages which had to be copied into internal
+ * buffer, because they were split across pieces of received data
+ * @return number of messages
+ */
+uint32_t ESPFrameRx::FramesCopied()
+{
+    return _copied;
+}
+
+/**
+ * Get number of frames dropped because of bad CRC or invalid length prefix
+ * @return number of frames
+ */
+uint32_t ESPFrameRx::FramesInvalid()
+{
+    return _invalid;
+}
+
+/**
+ * Write length prefix of a message
+ * @param hdr buffer of at least ESP_FRAME_HDR_MAX bytes to write prefix to
+ * @param len length of message (max. ESP_FRAME_MAX_LEN)
+ * @return length of prefix written to [hdr]
+ */
+uint8_t ESPFrameRx::EncodeLen(uint8_t *hdr, uint16_t len)
+{
+    uint8_t n = 0;
+
+    while (len >= 0x80)
+    {
+        hdr[n++] = (uint8_t)(len | 0x80);
+        len >>= 7;
+    }
+    hdr[n++] = (uint8_t)len;
+
+    return n;
+}
+
+/**
+ * Calculate CRC-16/CCITT checksum of given data
+ * Checksum of data in several pieces is calculated by passing checksum of
+ * previous pieces as [crc].
+ * @param data data to calculate checksum of
+ * @param len length of [data]
+ * @param crc[optional] initial value
+ * @return checksum
+ */
+uint16_t ESPFrameRx::CRC16(const uint8_t *data, uint16_t len, uint16_t crc)
+{
+    while (len--)
+    {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+    }
+
+    return crc;
+}
+
+///-----------------------------------------------------------------------------
+///                      Reassembling messages                         [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Decode length prefix at the start of a frame
+ * @param data start of the frame
+ * @param len number of bytes of the frame available in [data]
+ * @param hdrLen output, length of prefix
+ * @param msgLen output, length of payload
+ * @return 1 if prefix is complete, 0 if more data is needed to decode it, -1
+ *         if prefix is invalid (too long, or length over ESP_FRAME_MAX_LEN)
+ */
+int8_t ESPFrameRx::_Header(const uint8_t *data, uint16_t len, uint8_t *hdrLen,
+                           uint16_t *msgLen)
+{
+    uint32_t val = 0;
+
+    for (uint8_t i = 0; (i < len) && (i < ESP_FRAME_HDR_MAX); i++)
+    {
+        val |= (uint32_t)(data[i] & 0x7F) << (7 * i);
+        if ((data[i] & 0x80) == 0)
+        {
+            if (val > ESP_FRAME_MAX_LEN)
+                return -1;
+            *hdrLen = i + 1;
+            *msgLen = (uint16_t)val;
+            return 1;
+        }
+    }
+
+    return (len >= ESP_FRAME_HDR_MAX) ? -1 : 0;
+}
+
+/**
+ * Check complete frame and pass its payload to output function
+ * @param frame start of the frame (length prefix)
+ * @param hdrLen length of prefix
+ * @param msgLen length of payload
+ * @return true: if message was delivered
+ *        false: if frame was dropped because of bad CRC
+ */
+bool ESPFrameRx::_Frame(const uint8_t *frame, uint8_t hdrLen, uint16_t msgLen)
+{
+    if (_crc)
+    {
+        const uint8_t *crc = frame + hdrLen + msgLen;
+
+        if (CRC16(frame, hdrLen + msgLen) != (((uint16_t)crc[0] << 8) | crc[1]))
+        {
+            _invalid++;
+            return false;
+        }
+    }
+
+    _delivered++;
+    if (_out != 0)
+        _out(frame + hdrLen, msgLen, _ctx);
+
+    return true;
+}
@@ -0,0 +1,77 @@
+/**
+ * espFrameRx.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Reassembler of length-prefixed messages sent over a TCP stream by ESPFrame
+ *  (see espFrame.h). Doesn't depend on ESP8266 library nor HAL so it can be
+ *  used on the receiving host as well as on the board itself.
+ *
+ *  Every frame is: <len><payload>[crc]
+ *      len     - length of payload, varint (7 bits per byte, least significant
+ *                group first, MSB set on all bytes but the last one)
+ *      crc     - optional, CRC-16/CCITT of len and payload, 2B big endian
+ */
+
+#ifndef ROVERKERNEL_ESP8266_ESPFRAMERX_H_
+#define ROVERKERNEL_ESP8266_ESPFRAMERX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*		Message framing settings		*/
+//  Max length of varint length prefix
+#define ESP_FRAME_HDR_MAX       3
+//  Length of CRC (if used)
+#define ESP_FRAME_CRC_LEN       2
+//  Max length of payload, whole frame fits in one AT+CIPSEND (2048 bytes)
+#define ESP_FRAME_MAX_LEN       (2048 - 2 - ESP_FRAME_CRC_LEN)
+
+/**
+ * ESPFrameRx class - splits received stream into messages
+ * Data received on a socket is fed to Feed() as it comes (e.g. from socket's
+ * handler). Frames which are complete within fed data are passed to output
+ * function straight from it, only frames split across several pieces of data
+ * are copied into internal buffer until they're complete. Frames with bad CRC
+ * are dropped; length prefix which can't be valid means stream is out of sync
+ * and everything buffered is dropped.
+ */
+class ESPFrameRx
+{
+    public:
+        ESPFrameRx(void((*out)(const uint8_t*, const uint16_t, void*)),
+                   void *ctx = 0, bool crc = false);
+
+        void        Feed(const uint8_t *data, uint16_t len);
+        void        Reset();
+        uint32_t    FramesDelivered();
+        uint32_t    FramesCopied();
+        uint32_t    FramesInvalid();
+
+        static uint8_t  EncodeLen(uint8_t *hdr, uint16_t len);
+        static uint16_t CRC16(const uint8_t *data, uint16_t len,
+                              uint16_t crc = 0xFFFF);
+
+    private:
+        int8_t      _Header(const uint8_t *data, uint16_t len,
+                            uint8_t *hdrLen, uint16_t *msgLen);
+        bool        _Frame(const uint8_t *frame, uint8_t hdrLen,
+                           uint16_t msgLen);
+
+        //  Output function for received messages, and its context
+        void        ((*_out)(const uint8_t*, const uint16_t, void*));
+        void        *_ctx;
+        //  Specifies whether frames carry CRC
+        bool        _crc;
+        //  Frame split across pieces of data, collected until it's complete
+        uint8_t     _buf[ESP_FRAME_HDR_MAX + ESP_FRAME_MAX_LEN +
+                         ESP_FRAME_CRC_LEN];
+        uint16_t    _len;
+        //  Statistics
+        uint32_t    _delivered;
+        uint32_t    _copied;
+        uint32_t    _invalid;
+};
+
+#endif /* ROVERKERNEL_ESP8266_ESPFRAMERX_H_ */
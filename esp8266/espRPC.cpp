@@ -0,0 +1,309 @@
+/**
+ * espRPC.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ */
+#include "espRPC.h"
+#include "espClient.h"
+#include "HAL/hal.h"
+
+///-----------------------------------------------------------------------------
+///                      Class constructor & destructor                [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Create RPC endpoint, not yet attached to any socket
+ * @param crc[optional] whether messages carry CRC (has to match the peer)
+ */
+ESPRPC::ESPRPC(bool crc) : _esp(0), _sockID(0), _tx(crc),
+                           _rx(_OnFrame, this, crc), _nextID(0),
+                           _reqHandler(0), _reqCtx(0), _timedOut(0),
+                           _unmatched(0)
+{
+    for (uint8_t i = 0; i < ESP_RPC_MAX_CALLS; i++)
+    {
+        _calls[i].used = false;
+        _calls[i].closed = true;
+        _calls[i].answered = false;
+    }
+}
+
+///-----------------------------------------------------------------------------
+///                      Calls                                          [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Attach RPC endpoint to a TCP socket
+ * Sets data handler of the socket, so data received on it is no longer passed
+ * to any other handler. Has to be repeated if socket is reopened.
+ * @param esp ESP instance socket is opened on
+ * @param sockID socket ID on [esp]
+ * @return true: if socket is open and endpoint is attached to it
+ *        false: otherwise
+ */
+bool ESPRPC::Attach(ESP8266 *esp, uint8_t sockID)
+{
+    _espClient *cli;
+
+    _esp = esp;
+    _sockID = sockID;
+    _rx.Reset();
+    cli = _Client();
+    if (cli == 0)
+        return false;
+    cli->SetHandler(_OnData, this);
+
+    return true;
+}
+
+/**
+ * Call a method on the peer
+ * Returns as soon as request is sent, [done] is called with the result when
+ * response comes (in any order relative to other calls), or with status
+ * ESP_RPC_TIMEOUT if it doesn't come within [timeoutMS].
+ * @param method method to call (defined by application)
+ * @param args arguments of the call
+ * @param len length of [args] (max. ESP_RPC_MAX_LEN)
+ * @param done completion callback, gets call ID, status, result, its length
+ * and [ctx]
+ * @param ctx[optional] user-defined context passed to [done]
+ * @param timeoutMS[optional] time to wait for response
+ * @param id[optional] output, ID assigned to the call
+ * @return status of send process, ESP_STATUS_BUSY if ESP_RPC_MAX_CALLS calls
+ *         are already in flight, ESP_STATUS_ERROR if arguments are too long or
+ *         socket isn't open; [done] is only called if request was sent
+ */
+uint32_t ESPRPC::Call(uint8_t method, const char *args, uint16_t len,
+                      void((*done)(uint16_t, uint8_t, const uint8_t*,
+                                   const uint16_t, void*)),
+                      void *ctx, uint32_t timeoutMS, uint16_t *id)
+{
+    _espRPCCall *call = 0;
+    uint16_t callID;
+    uint32_t retVal;
+
+    if ((len > ESP_RPC_MAX_LEN) || (_Client() == 0))
+        return ESP_STATUS_ERROR;
+    //  Slot is free if it was never used or response completed its call
+    for (uint8_t i = 0; i < ESP_RPC_MAX_CALLS; i++)
+        if (!_calls[i].used || _calls[i].answered)
+        {
+            call = &_calls[i];
+            break;
+        }
+    if (call == 0)
+        return ESP_STATUS_BUSY;
+
+    //  Call is set up before sending, response can come before send returns.
+    //  Slot is closed to responses while it's being filled in.
+    call->closed = true;
+    call->answered = false;
+    call->id = callID = _nextID++;
+    call->done = done;
+    call->ctx = ctx;
+    call->startMS = HAL_GetMS();
+    call->timeoutMS = timeoutMS;
+    call->used = true;
+    call->closed = false;
+
+    retVal = _Send(ESP_RPC_REQUEST, callID, method, args, len);
+    //  Request didn't go out, call is dropped without callback
+    if (!(retVal & ESP_STATUS_SENDOK) && (retVal != ESP_STATUS_OK))
+    {
+        call->closed = true;
+        call->used = false;
+        return retVal;
+    }
+
+    if (id != 0)
+        *id = callID;
+
+    return retVal;
+}
+
+/**
+ * Register handler of requests from the peer
+ * Handler gets this endpoint, call ID, method, arguments, their length and
+ * [ctx]. It's called from socket's data handler, so it should only note the
+ * request; response is sent with Reply() from main context.
+ * @param handler request handler (0 to drop requests)
+ * @param ctx[optional] user-defined context passed to [handler]
+ */
+void ESPRPC::OnRequest(void((*handler)(ESPRPC*, uint16_t, uint8_t,
+                                       const uint8_t*, const uint16_t, void*)),
+                       void *ctx)
+{
+    _reqHandler = handler;
+    _reqCtx = ctx;
+}
+
+/**
+ * Send response to a request from the peer
+ * Requests can be answered in any order.
+ * @param id ID of the call, as passed to request handler
+ * @param status status of the call (ESP_RPC_OK if successful)
+ * @param data result of the call
+ * @param len length of [data] (max. ESP_RPC_MAX_LEN)
+ * @return status of send process
+ */
+uint32_t ESPRPC::Reply(uint16_t id, uint8_t status, const char *data,
+                       uint16_t len)
+{
+    return _Send(ESP_RPC_RESPONSE, id, status, data, len);
+}
+
+/**
+ * Complete calls whose response didn't come in time, with status
+ * ESP_RPC_TIMEOUT; has to be called periodically from main context
+ */
+void ESPRPC::Poll()
+{
+    for (uint8_t i = 0; i < ESP_RPC_MAX_CALLS; i++)
+    {
+        _espRPCCall *call = &_calls[i];
+
+        if (!call->used || call->closed || call->answered ||
+            ((HAL_GetMS() - call->startMS) < call->timeoutMS))
+            continue;
+        //  Close the call to responses, then check that one didn't complete
+        //  it in the meantime
+        call->closed = true;
+        if (!call->answered)
+        {
+            _timedOut++;
+            if (call->done != 0)
+                call->done(call->id, ESP_RPC_TIMEOUT, 0, 0, call->ctx);
+        }
+        call->used = false;
+    }
+}
+
+/**
+ * Get number of calls waiting for response
+ * @return number of calls
+ */
+uint8_t ESPRPC::InFlight()
+{
+    uint8_t retVal = 0;
+
+    for (uint8_t i = 0; i < ESP_RPC_MAX_CALLS; i++)
+        if (_calls[i].used && !_calls[i].closed && !_calls[i].answered)
+            retVal++;
+
+    return retVal;
+}
+
+/**
+ * Get number of calls completed by timeout so far
+ * @return number of calls
+ */
+uint32_t ESPRPC::TimedOut()
+{
+    return _timedOut;
+}
+
+/**
+ * Get number of received messages which were dropped: responses to no call in
+ * flight (e.g. late ones), requests with no handler registered and messages
+ * too short to be valid
+ * @return number of messages
+ */
+uint32_t ESPRPC::Unmatched()
+{
+    return _unmatched;
+}
+
+///-----------------------------------------------------------------------------
+///                      Calls                                         [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Get client of the socket endpoint is attached to
+ * @return pointer to client, 0 if socket isn't open
+ */
+_espClient* ESPRPC::_Client()
+{
+    if (_esp == 0)
+        return 0;
+
+    return _esp->GetClientBySockID(_sockID);
+}
+
+/**
+ * Send a message, header and data are framed without copying them together
+ * @param type ESP_RPC_REQUEST or ESP_RPC_RESPONSE
+ * @param id call ID
+ * @param code method of request or status of response
+ * @param data arguments/result
+ * @param len length of [data]
+ * @return status of send process
+ */
+uint32_t ESPRPC::_Send(uint8_t type, uint16_t id, uint8_t code,
+                       const char *data, uint16_t len)
+{
+    char hdr[ESP_RPC_HDR_LEN];
+    const char *parts[2];
+    uint16_t lens[2];
+
+    hdr[0] = (char)type;
+    hdr[1] = (char)(id >> 8);
+    hdr[2] = (char)id;
+    hdr[3] = (char)code;
+    parts[0] = hdr;
+    lens[0] = ESP_RPC_HDR_LEN;
+    parts[1] = data;
+    lens[1] = len;
+
+    return _tx.SendV(_Client(), parts, lens, 2);
+}
+
+/**
+ * Data handler of the socket, passes received data to reassembler
+ */
+void ESPRPC::_OnData(_espClient *cli, const uint8_t *data, const uint16_t len,
+                     void *ctx)
+{
+    (void)cli;
+    ((ESPRPC*)ctx)->_rx.Feed(data, len);
+}
+
+/**
+ * Handle received message: complete call it responds to, or pass request to
+ * request handler
+ */
+void ESPRPC::_OnFrame(const uint8_t *msg, const uint16_t len, void *ctx)
+{
+    ESPRPC *rpc = (ESPRPC*)ctx;
+    uint16_t id;
+
+    if (len < ESP_RPC_HDR_LEN)
+    {
+        rpc->_unmatched++;
+        return;
+    }
+    id = ((uint16_t)msg[1] << 8) | msg[2];
+
+    if ((msg[0] == ESP_RPC_REQUEST) && (rpc->_reqHandler != 0))
+    {
+        rpc->_reqHandler(rpc, id, msg[3], msg + ESP_RPC_HDR_LEN,
+                         len - ESP_RPC_HDR_LEN, rpc->_reqCtx);
+        return;
+    }
+    if (msg[0] == ESP_RPC_RESPONSE)
+        for (uint8_t i = 0; i < ESP_RPC_MAX_CALLS; i++)
+        {
+            _espRPCCall *call = &rpc->_calls[i];
+
+            if (!call->used || call->closed || call->answered ||
+                (call->id != id))
+                continue;
+            call->answered = true;
+            if (call->done != 0)
+                call->done(id, msg[3], msg + ESP_RPC_HDR_LEN,
+                           len - ESP_RPC_HDR_LEN, call->ctx);
+            return;
+        }
+
+    rpc->_unmatched++;
+}
@@ -0,0 +1,123 @@
+/**
+ * espRPC.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Request/response calls over a TCP socket of ESP8266. Every call gets an ID
+ *  which the peer copies into its response, so many calls can be in flight on
+ *  one socket and the peer can answer them in any order. Messages are framed
+ *  with ESPFrame/ESPFrameRx, payload of each frame is:
+ *      <type><id><code><data>
+ *      type    - ESP_RPC_REQUEST or ESP_RPC_RESPONSE, 1B
+ *      id      - ID of the call, 2B big endian
+ *      code    - method in request, status in response (ESP_RPC_OK if
+ *                successful, otherwise defined by application), 1B
+ *      data    - arguments in request, result in response
+ */
+
+#ifndef ROVERKERNEL_ESP8266_ESPRPC_H_
+#define ROVERKERNEL_ESP8266_ESPRPC_H_
+
+#include "esp8266.h"
+#include "espFrame.h"
+
+/*		RPC settings		*/
+//  Max number of calls in flight at the same time
+#define ESP_RPC_MAX_CALLS       8
+//  Default time to wait for response to a call
+#define ESP_RPC_TIMEOUT_MS      1000
+//  Length of header in front of arguments/result
+#define ESP_RPC_HDR_LEN         4
+//  Max length of arguments/result
+#define ESP_RPC_MAX_LEN         (ESP_FRAME_MAX_LEN - ESP_RPC_HDR_LEN)
+//  Message types
+#define ESP_RPC_REQUEST         0x01
+#define ESP_RPC_RESPONSE        0x02
+//  Status of successful call
+#define ESP_RPC_OK              0x00
+//  Status passed to completion callback when no response came in time
+#define ESP_RPC_TIMEOUT         0xFF
+
+/**
+ * Call in flight
+ * Slot is written in main context (Call(), Poll()) but completed from socket's
+ * data handler which can run in ISR: each flag has only one writer so a slot
+ * is completed exactly once, either by response or by timeout.
+ */
+struct _espRPCCall
+{
+    uint16_t    id;
+    void        ((*done)(uint16_t, uint8_t, const uint8_t*, const uint16_t,
+                         void*));
+    void        *ctx;
+    uint32_t    startMS;
+    uint32_t    timeoutMS;
+    //  Slot holds a call (written by main context only)
+    volatile bool   used;
+    //  Responses can't complete the call (written by main context only)
+    volatile bool   closed;
+    //  Response completed the call (written by data handler only)
+    volatile bool   answered;
+};
+
+/**
+ * ESPRPC class - caller and server of calls on one TCP socket
+ * Completion callbacks and request handler are called from socket's data
+ * handler, with data valid only until they return. Replies have to be sent
+ * from main context (same as any other data) so a request handler should keep
+ * the call ID and what it needs of the arguments, and reply later. Timeouts
+ * are checked in Poll() which has to be called periodically.
+ */
+class ESPRPC
+{
+    public:
+        ESPRPC(bool crc = false);
+
+        bool        Attach(ESP8266 *esp, uint8_t sockID);
+        uint32_t    Call(uint8_t method, const char *args, uint16_t len,
+                         void((*done)(uint16_t, uint8_t, const uint8_t*,
+                                      const uint16_t, void*)),
+                         void *ctx = 0,
+                         uint32_t timeoutMS = ESP_RPC_TIMEOUT_MS,
+                         uint16_t *id = 0);
+        void        OnRequest(void((*handler)(ESPRPC*, uint16_t, uint8_t,
+                                              const uint8_t*, const uint16_t,
+                                              void*)),
+                              void *ctx = 0);
+        uint32_t    Reply(uint16_t id, uint8_t status, const char *data,
+                          uint16_t len);
+        void        Poll();
+        uint8_t     InFlight();
+        uint32_t    TimedOut();
+        uint32_t    Unmatched();
+
+    private:
+        _espClient  *_Client();
+        uint32_t    _Send(uint8_t type, uint16_t id, uint8_t code,
+                          const char *data, uint16_t len);
+
+        static void _OnData(_espClient *cli, const uint8_t *data,
+                            const uint16_t len, void *ctx);
+        static void _OnFrame(const uint8_t *msg, const uint16_t len,
+                             void *ctx);
+
+        //  Socket calls go through, looked up on every use as it can be closed
+        ESP8266     *_esp;
+        uint8_t     _sockID;
+        //  Message framing
+        ESPFrame    _tx;
+        ESPFrameRx  _rx;
+        //  Calls in flight and ID of the next one
+        _espRPCCall _calls[ESP_RPC_MAX_CALLS];
+        uint16_t    _nextID;
+        //  Handler of requests from the peer, and its context
+        void        ((*_reqHandler)(ESPRPC*, uint16_t, uint8_t,
+                                    const uint8_t*, const uint16_t, void*));
+        void        *_reqCtx;
+        //  Statistics
+        uint32_t    _timedOut;
+        uint32_t    _unmatched;
+};
+
+#endif /* ROVERKERNEL_ESP8266_ESPRPC_H_ */
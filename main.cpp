@@ -6,28 +6,23 @@ uint8_t socketId;
 volatile bool gotData = false;
 
 /**
- * Function to be called when a new data is received from TCP clients on ALL
- * opened sockets at ESP. Function is called through data scheduler if enabled,
- * otherwise called directly from ISR (don't send any data from here!)
- * @param sockID socket ID at which the reply arrived
+ * Function to be called when a new data is received on the socket we open
+ * (handler is given to OpenTCPSock, so it's only called for that socket).
+ * Function is called through data scheduler if enabled, otherwise called
+ * directly from ISR (don't send any data from here!)
+ * @param cli client (socket) at which the reply arrived
  * @param buf buffer containing incoming data
  * @param len size of incoming data in [buf] buffer
+ * @param ctx context given together with handler, here flag to set
  */
-static void ESPDataReceived(const uint8_t sockID, const uint8_t *buf, const uint16_t len)
+static void ESPDataReceived(_espClient *cli, const uint8_t *buf,
+                            const uint16_t len, void *ctx)
 {
-    //  Check if data came from the socket we opened
-    if (sockID == socketId)
-    {
-        //  Set a flag so we can reply to it from main loop
-        gotData = true;
+    //  Set a flag so we can reply to it from main loop
+    *(volatile bool*)ctx = true;
 
-        //  Print received data to serial
-        DEBUG_WRITE("Received %d bytes from %d: %s \n ", len, sockID, buf);
-    }
-    else
-    {
-        //  Do nothing
-    }
+    //  Print received data to serial
+    DEBUG_WRITE("Received %d bytes: %s \n ", len, buf);
 }
 
 
@@ -46,8 +41,6 @@ int main(void)
     //  Initialize hardware and software related to ESP8266
     esp.InitHW();
     DEBUG_WRITE("Initialized ESP, connecting to AP...");
-    //  Add hook to be called once ESP receives new data (asynchronous)
-    esp.AddHook(ESPDataReceived);
     //  Connect to AP in blocking mode
     esp.ConnectAP("sgvfyj7a", "7vxy3b5d", false);
 
@@ -61,9 +54,11 @@ int main(void)
     DEBUG_WRITE("Connected\n Acquired IP: %u \n", esp.MyIP());
 
     DEBUG_WRITE("Opening connection to TCP server...");
-    //  Connect to a TCP server (192.168.0.12:52699), keep socket alive
+    //  Connect to a TCP server (192.168.0.12:52699), keep socket alive and
+    //  call ESPDataReceived once socket receives new data (asynchronous)
     //  Function returns socket descriptor. Save it so we can reply to the socket
-    socketId = esp.OpenTCPSock("192.168.0.16", 52699, true);
+    socketId = esp.OpenTCPSock("192.168.0.16", 52699, true, 9,
+                               ESPDataReceived, (void*)&gotData);
 
 
     //  Check if socket descriptor is valid
@@ -94,6 +89,9 @@ int main(void)
             esp.GetClientBySockID(socketId)->SendTCP("I've received your message!\n\0");
         }
 
+        //  Let the library retry any sends ESP rejected as "busy..."
+        esp.Service();
+
         DEBUG_WRITE("Sent a message, %d more to go\n", (15 - counter));
         //  Do nothing for cca 3s
         HAL_DelayUS(3000000);
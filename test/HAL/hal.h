@@ -0,0 +1,79 @@
+/**
+ *  hal.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Host HAL used by tests in test/. Takes place of HAL/hal.h when test/ comes
+ *  first in include path, and provides the same interface as TM4C1294 HAL
+ *  (hal_common_tm4c.h, hal_esp_tm4c.h). Ports are connected to a model of ESP
+ *  module (see hostEsp.h) instead of UART peripherals.
+ */
+
+#ifndef __HAL_H__
+#define __HAL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HAL_OK                  0
+
+/**     ESP8266 - related macros        */
+//  Number of ports (ESP modules) available on host
+#define HAL_ESP_PORT_NUM        2
+
+/**
+ * Port connected to one modelled ESP module, state of the model is kept in
+ * hostEsp.cpp and indexed by [idx]
+ */
+struct _halEspPort
+{
+    uint8_t     idx;
+};
+typedef struct _halEspPort HAL_ESP_Port;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Global clock variable
+extern uint32_t g_ui32SysClock;
+
+extern void         HAL_DelayUS(uint32_t us);
+extern void         HAL_BOARD_CLOCK_Init();
+extern void         HAL_BOARD_Reset();
+extern void         UNUSED (int32_t arg);
+extern uint32_t     HAL_GetTicks();
+extern uint32_t     HAL_TicksToUS(uint32_t ticks);
+extern uint32_t     HAL_GetMS();
+
+//  Ports ESP modules are connected to (HAL_ESP_PORT0 is the default one)
+extern HAL_ESP_Port HAL_ESP_PORT0;
+extern HAL_ESP_Port HAL_ESP_PORT1;
+
+extern uint32_t    HAL_ESP_InitPort(HAL_ESP_Port *port, uint32_t baud);
+extern void        HAL_ESP_RegisterIntHandler(HAL_ESP_Port *port,
+                                              void((*intHandler)(void)));
+extern void        HAL_ESP_HWEnable(HAL_ESP_Port *port, bool enable);
+extern bool        HAL_ESP_IsHWEnabled(HAL_ESP_Port *port);
+extern void        HAL_ESP_IntEnable(HAL_ESP_Port *port, bool enable);
+extern int32_t     HAL_ESP_ClearInt(HAL_ESP_Port *port);
+extern void        HAL_ESP_InitWD(HAL_ESP_Port *port, void((*intHandler)(void)));
+extern void        HAL_ESP_WDControl(HAL_ESP_Port *port, bool enable,
+                                     uint32_t timeout);
+extern void        HAL_ESP_WDClearInt(HAL_ESP_Port *port);
+extern void        HAL_ESP_FlowControl(HAL_ESP_Port *port, bool enable);
+extern bool        HAL_ESP_TxReady(HAL_ESP_Port *port);
+extern void        HAL_ESP_RxHold(HAL_ESP_Port *port, bool hold);
+extern uint32_t    HAL_ESP_OverrunCount(HAL_ESP_Port *port);
+extern bool        HAL_ESP_UARTBusy(HAL_ESP_Port *port);
+extern void        HAL_ESP_SendChar(HAL_ESP_Port *port, char c);
+extern bool        HAL_ESP_CharAvail(HAL_ESP_Port *port);
+extern char        HAL_ESP_GetChar(HAL_ESP_Port *port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __HAL_H__ */
@@ -0,0 +1,715 @@
+/**
+ * hostEsp.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ */
+#include "hostEsp.h"
+#include "serialPort/uartHW.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+//  Max number of replies scheduled at the same time, and max length of one
+#define ESP_HOST_SCHED_NUM      64
+#define ESP_HOST_SCHED_LEN      2304
+//  Size of buffers: data waiting to be read by driver, written data
+#define ESP_HOST_RX_LEN         65536
+#define ESP_HOST_TX_LEN         65536
+//  Max length of a command line and of data taken after "> " prompt
+#define ESP_HOST_LINE_LEN       512
+#define ESP_HOST_DATA_LEN       4096
+
+/**
+ * Reply scheduled to be sent to the driver
+ */
+struct _hostReply
+{
+    bool        used;
+    uint64_t    dueUS;
+    uint32_t    seq;
+    uint16_t    len;
+    char        data[ESP_HOST_SCHED_LEN];
+};
+
+/**
+ * State of one modelled module
+ */
+struct _hostModule
+{
+    //  Interrupt handlers registered by the driver
+    void        ((*isr)(void));
+    void        ((*wdIsr)(void));
+    volatile bool   intEn;
+    volatile bool   pendInt;
+    bool        enabled;
+    uint64_t    enabledUS;
+    //  Watchdog deadline (0 if not running) and last timeout
+    uint64_t    wdDeadlineUS;
+    uint32_t    wdLastMS;
+    //  Echo of commands (ATE1/ATE0)
+    bool        echo;
+    //  Data waiting to be read by the driver (ring buffer)
+    char        rx[ESP_HOST_RX_LEN];
+    uint32_t    rxHead;
+    uint32_t    rxTail;
+    //  Replies not sent yet
+    _hostReply  sched[ESP_HOST_SCHED_NUM];
+    uint32_t    schedSeq;
+    //  Command line being written, and data after "> " prompt
+    char        line[ESP_HOST_LINE_LEN];
+    uint16_t    lineLen;
+    char        data[ESP_HOST_DATA_LEN];
+    uint16_t    dataLen;
+    uint16_t    dataExp;
+    //  Transparent transmission: set up (AT+CIPMODE=1), on, last byte written
+    bool        cipMode;
+    bool        transparent;
+    uint64_t    ptLastUS;
+    //  Pace of UART (0 if bytes are taken instantly), time it frees up (ns)
+    uint32_t    baud;
+    uint64_t    txFreeNS;
+    //  Everything written by the driver
+    char        tx[ESP_HOST_TX_LEN];
+    uint32_t    txLen;
+    //  Handlers set by the test
+    HostESPCmd  onCmd;
+    HostESPData onData;
+};
+
+extern "C"
+{
+uint32_t g_ui32SysClock = 120000000;
+HAL_ESP_Port HAL_ESP_PORT0 = { 0 };
+HAL_ESP_Port HAL_ESP_PORT1 = { 1 };
+}
+int hostFails = 0;
+
+static _hostModule _mod[HAL_ESP_PORT_NUM];
+static pthread_mutex_t _lock;
+static bool _started = false;
+
+///-----------------------------------------------------------------------------
+///                      Model internals                               [PRIVATE]
+///-----------------------------------------------------------------------------
+
+static uint64_t _NowUS()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+static void _Lock()
+{
+    pthread_mutex_lock(&_lock);
+}
+
+static void _Unlock()
+{
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Pass reply to the driver (called by interrupt thread when reply is due)
+ */
+static void _RxPut(_hostModule &m, const char *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++)
+    {
+        m.rx[m.rxHead] = data[i];
+        m.rxHead = (m.rxHead + 1) % ESP_HOST_RX_LEN;
+    }
+}
+
+/**
+ * Handle complete command line written by the driver
+ */
+static void _Command(uint8_t port, _hostModule &m)
+{
+    const char *reply = 0;
+    char echo[ESP_HOST_LINE_LEN + 3];
+    uint16_t len;
+
+    //  Still booting, UART input is ignored
+    if ((_NowUS() - m.enabledUS) < (ESP_HOST_BOOT_MS * 1000))
+        return;
+
+    if (strcmp(m.line, "ATE1") == 0)
+        m.echo = true;
+    else if (strcmp(m.line, "ATE0") == 0)
+        m.echo = false;
+    else if (strcmp(m.line, "AT+CIPMODE=1") == 0)
+        m.cipMode = true;
+    else if (strcmp(m.line, "AT+CIPMODE=0") == 0)
+        m.cipMode = false;
+    else if (strncmp(m.line, "AT+LINKTEST=", 12) == 0)
+        reply = "\r\nERROR\r\n";
+    //  Echo comes before the reply, with \r of the command still in it
+    if (m.echo)
+    {
+        len = sprintf(echo, "%s\r\r\n", m.line);
+        HostESP_Reply(port, echo, len, ESP_HOST_REPLY_MS);
+    }
+    if ((reply == 0) && (m.onCmd != 0))
+        reply = m.onCmd(port, m.line);
+    if ((reply == 0) && m.cipMode && (strcmp(m.line, "AT+CIPSEND") == 0))
+        reply = "\r\nOK\r\n\r\n>";
+    if (reply == 0)
+        reply = "\r\nOK\r\n";
+    HostESP_ReplyStr(port, reply, ESP_HOST_REPLY_MS);
+
+    //  Everything that follows the prompt is data
+    if (m.cipMode && (strcmp(m.line, "AT+CIPSEND") == 0) &&
+        (strchr(reply, '>') != 0))
+    {
+        m.transparent = true;
+        m.dataLen = 0;
+    }
+
+    //  Data to send follows the prompt (unless handler already set length)
+    if ((m.dataExp == 0) && (strstr(reply, "> ") != 0) &&
+        ((strncmp(m.line, "AT+CIPSEND=", 11) == 0) ||
+         (strncmp(m.line, "AT+CIPSENDBUF=", 14) == 0)))
+        HostESP_ExpectData(port, atoi(strchr(m.line, ',') + 1));
+}
+
+/**
+ * Handle complete data written after "> " prompt
+ */
+static void _Data(uint8_t port, _hostModule &m)
+{
+    const char *reply = 0;
+    char def[48];
+
+    if (m.onData != 0)
+        reply = m.onData(port, m.data, m.dataLen);
+    if (reply == 0)
+    {
+        sprintf(def, "\r\nRecv %u bytes\r\n\r\nSEND OK\r\n", m.dataLen);
+        reply = def;
+    }
+    HostESP_ReplyStr(port, reply, ESP_HOST_REPLY_MS);
+}
+
+/**
+ * Handle packet of data collected in transparent transmission
+ */
+static void _Packet(uint8_t port, _hostModule &m)
+{
+    const char *reply = 0;
+
+    //  Escape sequence, back to command mode
+    if ((m.dataLen == 3) && (strncmp(m.data, "+++", 3) == 0))
+        m.transparent = false;
+    else if (m.onData != 0)
+        reply = m.onData(port, m.data, m.dataLen);
+    if (reply != 0)
+        HostESP_ReplyStr(port, reply, ESP_HOST_REPLY_MS);
+    m.dataLen = 0;
+}
+
+/**
+ * Interrupt thread: passes due replies to the driver, runs watchdog and UART
+ * interrupt handlers
+ */
+static void* _IntThread(void *arg)
+{
+    (void)arg;
+
+    while (true)
+    {
+        for (uint8_t p = 0; p < HAL_ESP_PORT_NUM; p++)
+        {
+            _hostModule &m = _mod[p];
+            void ((*wd)(void)) = 0;
+            bool avail;
+
+            _Lock();
+            //  Due replies go out in order of their due time
+            while (true)
+            {
+                int16_t next = -1;
+                uint64_t now = _NowUS();
+
+                for (int16_t i = 0; i < ESP_HOST_SCHED_NUM; i++)
+                    if (m.sched[i].used && (m.sched[i].dueUS <= now) &&
+                        ((next < 0) ||
+                         (m.sched[i].dueUS < m.sched[next].dueUS) ||
+                         ((m.sched[i].dueUS == m.sched[next].dueUS) &&
+                          (m.sched[i].seq < m.sched[next].seq))))
+                        next = i;
+                if (next < 0)
+                    break;
+                _RxPut(m, m.sched[next].data, m.sched[next].len);
+                m.sched[next].used = false;
+            }
+            //  Gap in transparent transmission closes the packet
+            if (m.transparent && (m.dataLen > 0) &&
+                ((_NowUS() - m.ptLastUS) >= (ESP_HOST_PT_GAP_MS * 1000)))
+                _Packet(p, m);
+            if ((m.wdDeadlineUS != 0) && (_NowUS() >= m.wdDeadlineUS))
+            {
+                m.wdDeadlineUS = 0;
+                wd = m.wdIsr;
+            }
+            avail = (m.rxHead != m.rxTail);
+            _Unlock();
+
+            if (wd != 0)
+                wd();
+            if ((m.isr != 0) && m.intEn && (avail || m.pendInt))
+            {
+                m.pendInt = false;
+                m.isr();
+            }
+        }
+        usleep(100);
+    }
+
+    return 0;
+}
+
+///-----------------------------------------------------------------------------
+///                      Model control                                  [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Start interrupt thread, has to be called before driver is initialized
+ */
+void HostESP_Start()
+{
+    pthread_mutexattr_t attr;
+    pthread_t thread;
+
+    if (_started)
+        return;
+    _started = true;
+    setvbuf(stdout, 0, _IONBF, 0);
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&_lock, &attr);
+    pthread_create(&thread, 0, _IntThread, 0);
+}
+
+/**
+ * Set handler of command lines written to module on [port]
+ */
+void HostESP_OnCommand(uint8_t port, HostESPCmd handler)
+{
+    _Lock();
+    _mod[port].onCmd = handler;
+    _Unlock();
+}
+
+/**
+ * Set handler of data written to module on [port] after "> " prompt
+ */
+void HostESP_OnData(uint8_t port, HostESPData handler)
+{
+    _Lock();
+    _mod[port].onData = handler;
+    _Unlock();
+}
+
+/**
+ * Schedule data to be sent to the driver from module on [port]
+ * @param port port of the module
+ * @param data data to send (can contain any bytes)
+ * @param len length of [data] (max. ESP_HOST_SCHED_LEN)
+ * @param delayMS time from now when data is sent
+ */
+void HostESP_Reply(uint8_t port, const char *data, uint16_t len,
+                   uint32_t delayMS)
+{
+    _hostModule &m = _mod[port];
+
+    if ((len == 0) || (len > ESP_HOST_SCHED_LEN))
+        return;
+    _Lock();
+    for (uint8_t i = 0; i < ESP_HOST_SCHED_NUM; i++)
+        if (!m.sched[i].used)
+        {
+            m.sched[i].dueUS = _NowUS() + (uint64_t)delayMS * 1000;
+            m.sched[i].seq = m.schedSeq++;
+            m.sched[i].len = len;
+            memcpy(m.sched[i].data, data, len);
+            m.sched[i].used = true;
+            break;
+        }
+    _Unlock();
+}
+
+/**
+ * Schedule zero-terminated string to be sent to the driver
+ */
+void HostESP_ReplyStr(uint8_t port, const char *str, uint32_t delayMS)
+{
+    HostESP_Reply(port, str, strlen(str), delayMS);
+}
+
+/**
+ * Make module take next [len] bytes written to it as data to send
+ */
+void HostESP_ExpectData(uint8_t port, uint16_t len)
+{
+    _Lock();
+    _mod[port].dataExp = (len > ESP_HOST_DATA_LEN) ? ESP_HOST_DATA_LEN : len;
+    _mod[port].dataLen = 0;
+    _Unlock();
+}
+
+/**
+ * Get everything written to module on [port] since last HostESP_TxClear()
+ * @param port port of the module
+ * @param len output, number of bytes written
+ * @return written data (valid until next write)
+ */
+const char* HostESP_TxLog(uint8_t port, uint32_t *len)
+{
+    *len = _mod[port].txLen;
+    return _mod[port].tx;
+}
+
+/**
+ * Forget data written to module on [port]
+ */
+void HostESP_TxClear(uint8_t port)
+{
+    _Lock();
+    _mod[port].txLen = 0;
+    _Unlock();
+}
+
+/**
+ * Wait until all scheduled replies of module on [port] were read by the driver
+ */
+void HostESP_WaitIdle(uint8_t port)
+{
+    _hostModule &m = _mod[port];
+    bool idle = false;
+
+    while (!idle)
+    {
+        usleep(500);
+        _Lock();
+        idle = (m.rxHead == m.rxTail);
+        for (uint8_t i = 0; i < ESP_HOST_SCHED_NUM; i++)
+            if (m.sched[i].used)
+                idle = false;
+        _Unlock();
+    }
+    //  Let the interrupt handler finish with the last piece
+    usleep(1000);
+}
+
+/**
+ * Make bytes written to module on [port] take as long as they would take on
+ * UART at [baud] (driver waits for HAL_ESP_UARTBusy()), 0 to take them
+ * instantly
+ */
+void HostESP_Baud(uint8_t port, uint32_t baud)
+{
+    _Lock();
+    _mod[port].baud = baud;
+    _mod[port].txFreeNS = 0;
+    _Unlock();
+}
+
+/**
+ * Check if module on [port] is in transparent transmission
+ */
+bool HostESP_Transparent(uint8_t port)
+{
+    return _mod[port].transparent;
+}
+
+/**
+ * Print outcome of the test
+ * @param name name of the test
+ * @return exit code of the test (0 if all checks passed)
+ */
+int HostTestDone(const char *name)
+{
+    printf("%s: %s (%d failures)\n", name, hostFails ? "FAILED" : "PASSED",
+           hostFails);
+
+    return (hostFails != 0);
+}
+
+///-----------------------------------------------------------------------------
+///                      Host HAL                                       [PUBLIC]
+///-----------------------------------------------------------------------------
+
+extern "C"
+{
+
+void HAL_DelayUS(uint32_t us)
+{
+    usleep(us);
+}
+
+void HAL_BOARD_CLOCK_Init()
+{
+}
+
+void HAL_BOARD_Reset()
+{
+    exit(1);
+}
+
+void UNUSED(int32_t arg)
+{
+    (void)arg;
+}
+
+uint32_t HAL_GetTicks()
+{
+    return (uint32_t)(_NowUS() * (g_ui32SysClock / 1000000));
+}
+
+uint32_t HAL_TicksToUS(uint32_t ticks)
+{
+    return ticks / (g_ui32SysClock / 1000000);
+}
+
+uint32_t HAL_GetMS()
+{
+    return (uint32_t)(_NowUS() / 1000);
+}
+
+uint32_t HAL_ESP_InitPort(HAL_ESP_Port *port, uint32_t baud)
+{
+    (void)port;
+    (void)baud;
+    return HAL_OK;
+}
+
+void HAL_ESP_RegisterIntHandler(HAL_ESP_Port *port, void((*intHandler)(void)))
+{
+    _mod[port->idx].isr = intHandler;
+}
+
+/**
+ * Enabling module restarts it: it drops everything and reports ready once it
+ * boots
+ */
+void HAL_ESP_HWEnable(HAL_ESP_Port *port, bool enable)
+{
+    _hostModule &m = _mod[port->idx];
+
+    _Lock();
+    if (enable && !m.enabled)
+    {
+        m.enabledUS = _NowUS();
+        m.echo = true;
+        m.lineLen = 0;
+        m.dataExp = 0;
+        m.cipMode = m.transparent = false;
+        for (uint8_t i = 0; i < ESP_HOST_SCHED_NUM; i++)
+            m.sched[i].used = false;
+        HostESP_ReplyStr(port->idx, "\r\nready\r\n", ESP_HOST_BOOT_MS);
+    }
+    m.enabled = enable;
+    _Unlock();
+}
+
+bool HAL_ESP_IsHWEnabled(HAL_ESP_Port *port)
+{
+    return _mod[port->idx].enabled;
+}
+
+void HAL_ESP_IntEnable(HAL_ESP_Port *port, bool enable)
+{
+    _mod[port->idx].intEn = enable;
+}
+
+int32_t HAL_ESP_ClearInt(HAL_ESP_Port *port)
+{
+    (void)port;
+    return 0;
+}
+
+void HAL_ESP_InitWD(HAL_ESP_Port *port, void((*intHandler)(void)))
+{
+    _mod[port->idx].wdIsr = intHandler;
+}
+
+void HAL_ESP_WDControl(HAL_ESP_Port *port, bool enable, uint32_t timeout)
+{
+    _hostModule &m = _mod[port->idx];
+
+    _Lock();
+    if (timeout != 0)
+        m.wdLastMS = timeout;
+    m.wdDeadlineUS = enable ? (_NowUS() + (uint64_t)m.wdLastMS * 1000) : 0;
+    _Unlock();
+}
+
+/**
+ * Same as on the board, clearing watchdog interrupt produces UART interrupt to
+ * process data received so far
+ */
+void HAL_ESP_WDClearInt(HAL_ESP_Port *port)
+{
+    _mod[port->idx].wdDeadlineUS = 0;
+    _mod[port->idx].pendInt = true;
+}
+
+void HAL_ESP_FlowControl(HAL_ESP_Port *port, bool enable)
+{
+    (void)port;
+    (void)enable;
+}
+
+bool HAL_ESP_TxReady(HAL_ESP_Port *port)
+{
+    (void)port;
+    return true;
+}
+
+void HAL_ESP_RxHold(HAL_ESP_Port *port, bool hold)
+{
+    (void)port;
+    (void)hold;
+}
+
+uint32_t HAL_ESP_OverrunCount(HAL_ESP_Port *port)
+{
+    (void)port;
+    return 0;
+}
+
+bool HAL_ESP_UARTBusy(HAL_ESP_Port *port)
+{
+    _hostModule &m = _mod[port->idx];
+    bool retVal;
+
+    _Lock();
+    retVal = (m.baud != 0) && ((_NowUS() * 1000) < m.txFreeNS);
+    _Unlock();
+
+    return retVal;
+}
+
+/**
+ * Byte written to module: collected into command line, or into data if module
+ * is waiting for it after "> " prompt
+ */
+void HAL_ESP_SendChar(HAL_ESP_Port *port, char c)
+{
+    _hostModule &m = _mod[port->idx];
+
+    _Lock();
+    if (m.txLen < ESP_HOST_TX_LEN)
+        m.tx[m.txLen++] = c;
+    //  Byte occupies UART for 10 bit times (8N1)
+    if (m.baud != 0)
+    {
+        uint64_t now = _NowUS() * 1000;
+
+        if (m.txFreeNS < now)
+            m.txFreeNS = now;
+        m.txFreeNS += 10000000000ULL / m.baud;
+    }
+
+    if (m.transparent)
+    {
+        if ((m.dataLen > 0) &&
+            ((_NowUS() - m.ptLastUS) >= (ESP_HOST_PT_GAP_MS * 1000)))
+            _Packet(port->idx, m);
+        m.data[m.dataLen++] = c;
+        m.ptLastUS = _NowUS();
+        if (m.dataLen == ESP_HOST_PT_PACKET)
+            _Packet(port->idx, m);
+    }
+    else if (m.dataExp > 0)
+    {
+        m.data[m.dataLen++] = c;
+        if (m.dataLen == m.dataExp)
+        {
+            m.dataExp = 0;
+            _Data(port->idx, m);
+        }
+    }
+    else if (c == '\n')
+    {
+        if ((m.lineLen > 0) && (m.line[m.lineLen - 1] == '\r'))
+            m.lineLen--;
+        m.line[m.lineLen] = 0;
+        _Command(port->idx, m);
+        m.lineLen = 0;
+    }
+    else if (m.lineLen < (ESP_HOST_LINE_LEN - 1))
+        m.line[m.lineLen++] = c;
+    _Unlock();
+}
+
+bool HAL_ESP_CharAvail(HAL_ESP_Port *port)
+{
+    bool retVal;
+
+    _Lock();
+    retVal = (_mod[port->idx].rxHead != _mod[port->idx].rxTail);
+    _Unlock();
+
+    return retVal;
+}
+
+char HAL_ESP_GetChar(HAL_ESP_Port *port)
+{
+    _hostModule &m = _mod[port->idx];
+    char retVal;
+
+    _Lock();
+    retVal = m.rx[m.rxTail];
+    m.rxTail = (m.rxTail + 1) % ESP_HOST_RX_LEN;
+    _Unlock();
+
+    return retVal;
+}
+
+}
+
+///-----------------------------------------------------------------------------
+///                      Debug port                                     [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/*
+ * Driver's debug output goes to stdout when ESP_HOST_DEBUG environment variable
+ * is set
+ */
+SerialPort::SerialPort() : custHook(0)
+{
+}
+
+SerialPort::~SerialPort()
+{
+}
+
+SerialPort& SerialPort::GetI()
+{
+    static SerialPort singletonInstance;
+    return singletonInstance;
+}
+
+SerialPort* SerialPort::GetP()
+{
+    return &(SerialPort::GetI());
+}
+
+void SerialPort::Send(const char *arg, ...)
+{
+    va_list args;
+
+    if (getenv("ESP_HOST_DEBUG") == 0)
+        return;
+    va_start(args, arg);
+    vprintf(arg, args);
+    va_end(args);
+}
@@ -0,0 +1,81 @@
+/**
+ * hostEsp.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Model of ESP8266 modules behind host HAL (test/HAL/hal.h), used to run the
+ *  driver on a PC. Each port gets its own module which:
+ *      -boots in ESP_HOST_BOOT_MS after being enabled and reports "ready"
+ *      -answers every command line with "OK" unless command handler says
+ *       otherwise, echoes commands after ATE1 the way ESP does ("AT...\r\r\n")
+ *      -rejects AT+LINKTEST (used by baud-rate negotiation) with "ERROR"
+ *      -takes data after "> " prompt of AT+CIPSEND/AT+CIPSENDBUF and reports
+ *       it as sent, unless data handler says otherwise
+ *      -after AT+CIPMODE=1 and AT+CIPSEND takes everything written as data,
+ *       in packets of ESP_HOST_PT_PACKET bytes or cut by a gap of
+ *       ESP_HOST_PT_GAP_MS, until it gets "+++" as a packet on its own
+ *      -takes bytes as fast as they come, or at the pace of UART at a given
+ *       baud rate (HostESP_Baud())
+ *  UART interrupt and watchdog timer are served from a separate thread, which
+ *  runs interrupt handlers whenever there's data for the driver.
+ */
+
+#ifndef TEST_HOSTESP_H_
+#define TEST_HOSTESP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "HAL/hal.h"
+
+//  Time module needs to boot after being enabled
+#define ESP_HOST_BOOT_MS        5
+//  Delay of default replies
+#define ESP_HOST_REPLY_MS       1
+//  Transparent transmission: max length of packet, gap in data closing it
+#define ESP_HOST_PT_PACKET      2048
+#define ESP_HOST_PT_GAP_MS      20
+
+/**
+ * Handler of a command line written to modelled module (without "\r\n")
+ * Returns reply to send back, 0 for default reply ("\r\nOK\r\n") or empty
+ * string for none. Runs with model locked, can call HostESP_* functions.
+ */
+typedef const char* ((*HostESPCmd)(uint8_t port, const char *line));
+/**
+ * Handler of data written after "> " prompt, returns reply same as HostESPCmd
+ * (in transparent transmission it gets each packet and there's no default
+ * reply)
+ */
+typedef const char* ((*HostESPData)(uint8_t port, const char *data,
+                                    uint16_t len));
+
+void        HostESP_Start();
+void        HostESP_OnCommand(uint8_t port, HostESPCmd handler);
+void        HostESP_OnData(uint8_t port, HostESPData handler);
+void        HostESP_Reply(uint8_t port, const char *data, uint16_t len,
+                          uint32_t delayMS);
+void        HostESP_ReplyStr(uint8_t port, const char *str, uint32_t delayMS);
+void        HostESP_ExpectData(uint8_t port, uint16_t len);
+const char* HostESP_TxLog(uint8_t port, uint32_t *len);
+void        HostESP_TxClear(uint8_t port);
+void        HostESP_WaitIdle(uint8_t port);
+void        HostESP_Baud(uint8_t port, uint32_t baud);
+bool        HostESP_Transparent(uint8_t port);
+
+/*		Test result bookkeeping		*/
+extern int  hostFails;
+
+#define HOST_CHECK(c)   do {                                                \
+                            if (!(c))                                       \
+                            {                                               \
+                                printf("FAIL %s:%d %s\n", __FILE__,         \
+                                       __LINE__, #c);                       \
+                                hostFails++;                                \
+                            }                                               \
+                        } while(0)
+
+int         HostTestDone(const char *name);
+
+#endif /* TEST_HOSTESP_H_ */
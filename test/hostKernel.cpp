@@ -0,0 +1,153 @@
+/**
+ * hostKernel.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ */
+#include "hostKernel.h"
+
+#include <pthread.h>
+#include <string.h>
+
+//  Modules registered with scheduler, indexed by their UID
+static _kernelEntry *_modules[TS_MAX_UID] = {0};
+//  Tasks waiting to be run (ring buffer), they're added from ISR thread
+static TaskEntry _tasks[TS_MAX_TASKS];
+static uint16_t _taskHead = 0, _taskTail = 0;
+static pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Register memory space and callback of module [uid]
+ * @param entry module's interface with task scheduler
+ * @param uid ID of module
+ */
+void TS_RegCallback(_kernelEntry *entry, uint8_t uid)
+{
+    if (uid < TS_MAX_UID)
+        _modules[uid] = entry;
+}
+
+TaskEntry::TaskEntry() : uid(0), task(0), time(0), argN(0)
+{
+}
+
+TaskEntry::TaskEntry(uint8_t uid, uint8_t task, int64_t time)
+    : uid(uid), task(task), time(time), argN(0)
+{
+}
+
+/**
+ * Append [argLen] bytes of [arg] to arguments of task
+ * @param arg pointer to argument data
+ * @param argLen number of bytes in [arg]
+ */
+void TaskEntry::AddArg(const volatile void *arg, uint16_t argLen) volatile
+{
+    if ((argN + argLen) > TS_MAX_ARGS)
+        return;
+    memcpy((void*)(args + argN), (const void*)arg, argLen);
+    argN += argLen;
+}
+
+TaskScheduler::TaskScheduler()
+{
+}
+
+/**
+ * Get pointer to the only instance of task scheduler
+ */
+TaskScheduler* TaskScheduler::GetP()
+{
+    static TaskScheduler singletonInstance;
+
+    return &singletonInstance;
+}
+
+/**
+ * Queue task [te], dropped if queue is full
+ * @param te task to queue (copied)
+ */
+void TaskScheduler::SyncTask(volatile TaskEntry &te)
+{
+    pthread_mutex_lock(&_lock);
+    if (((_taskTail + 1) % TS_MAX_TASKS) != _taskHead)
+    {
+        memcpy((void*)&_tasks[_taskTail], (const void*)&te, sizeof(TaskEntry));
+        _taskTail = (_taskTail + 1) % TS_MAX_TASKS;
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Queue task [task] of module [uid], arguments are added with AddArgs()
+ */
+void TaskScheduler::SyncTask(uint8_t uid, uint8_t task, int64_t time)
+{
+    volatile TaskEntry te(uid, task, time);
+
+    SyncTask(te);
+}
+
+/**
+ * Append [argLen] bytes of [arg] to arguments of the last task queued
+ */
+void TaskScheduler::AddArgs(const volatile void *arg, uint16_t argLen)
+{
+    pthread_mutex_lock(&_lock);
+    if (_taskHead != _taskTail)
+        _tasks[(_taskTail + TS_MAX_TASKS - 1) % TS_MAX_TASKS].AddArg(arg, argLen);
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Run all queued tasks in order, including the ones queued while running
+ * Task's arguments are copied into memory space of its module, then module's
+ * callback is called (from the calling thread).
+ * @return number of tasks run
+ */
+uint16_t HostKernel_Run()
+{
+    uint16_t n = 0;
+
+    while (true)
+    {
+        TaskEntry te;
+        _kernelEntry *ker;
+
+        pthread_mutex_lock(&_lock);
+        if (_taskHead == _taskTail)
+        {
+            pthread_mutex_unlock(&_lock);
+            break;
+        }
+        te = _tasks[_taskHead];
+        _taskHead = (_taskHead + 1) % TS_MAX_TASKS;
+        pthread_mutex_unlock(&_lock);
+
+        if ((te.uid >= TS_MAX_UID) || (_modules[te.uid] == 0))
+            continue;
+        ker = _modules[te.uid];
+        ker->serviceID = te.task;
+        memcpy(ker->args, te.args, te.argN);
+        ker->argN = te.argN;
+        ker->retVal = 0;
+        ker->callBackFunc();
+        n++;
+    }
+
+    return n;
+}
+
+/**
+ * Get number of tasks waiting to be run
+ */
+uint16_t HostKernel_Pending()
+{
+    uint16_t n;
+
+    pthread_mutex_lock(&_lock);
+    n = (_taskTail + TS_MAX_TASKS - _taskHead) % TS_MAX_TASKS;
+    pthread_mutex_unlock(&_lock);
+
+    return n;
+}
@@ -0,0 +1,87 @@
+/**
+ * hostKernel.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Host task scheduler used by tests built with __USE_TASK_SCHEDULER__. Gives
+ *  library the same interface as roverKernel's task scheduler (TaskEntry,
+ *  TaskScheduler, _kernelEntry, TS_RegCallback) and module IDs it would get
+ *  from hwconfig.h. Tasks are only queued; test runs them from its own thread
+ *  with HostKernel_Run(), the way the main loop of the board would. Included
+ *  in every source with "-include hostKernel.h".
+ */
+
+#ifndef TEST_HOSTKERNEL_H_
+#define TEST_HOSTKERNEL_H_
+
+#include <stdint.h>
+
+//  ID of ESP8266 module in task scheduler
+#define ESP_UID                 3
+//  Services of ESP8266 module
+#define ESP_T_TCPSERV           0
+#define ESP_T_CONNTCP           1
+#define ESP_T_SENDTCP           2
+#define ESP_T_RECVSOCK          3
+#define ESP_T_CLOSETCP          4
+#define ESP_T_REBOOT            5
+#define ESP_T_PARSE             6
+
+//  Max number of modules registered, tasks queued and bytes of task arguments
+#define TS_MAX_UID              8
+#define TS_MAX_TASKS            32
+#define TS_MAX_ARGS             64
+
+/**
+ * Memory space and callback a module provides to task scheduler
+ */
+struct _kernelEntry
+{
+    uint8_t     serviceID;              //  Service requested
+    uint8_t     args[TS_MAX_ARGS + 1];  //  Arguments of service (+terminator)
+    uint16_t    argN;                   //  Number of bytes in args[]
+    uint32_t    retVal;                 //  Status returned by service
+    void        ((*callBackFunc)(void));
+};
+
+extern void TS_RegCallback(_kernelEntry *entry, uint8_t uid);
+
+/**
+ * Task to be run by task scheduler
+ */
+class TaskEntry
+{
+    public:
+        TaskEntry();
+        TaskEntry(uint8_t uid, uint8_t task, int64_t time);
+
+        void        AddArg(const volatile void *arg, uint16_t argLen) volatile;
+
+        uint8_t     uid;
+        uint8_t     task;
+        int64_t     time;
+        uint8_t     args[TS_MAX_ARGS];
+        uint16_t    argN;
+};
+
+/**
+ * TaskScheduler class - queue of tasks requested by modules
+ */
+class TaskScheduler
+{
+    public:
+        static TaskScheduler* GetP();
+
+        void        SyncTask(volatile TaskEntry &te);
+        void        SyncTask(uint8_t uid, uint8_t task, int64_t time);
+        void        AddArgs(const volatile void *arg, uint16_t argLen);
+
+    private:
+        TaskScheduler();
+};
+
+extern uint16_t HostKernel_Run();
+extern uint16_t HostKernel_Pending();
+
+#endif /* TEST_HOSTKERNEL_H_ */
@@ -0,0 +1,127 @@
+/**
+ * rpcPeer.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ */
+#include "rpcPeer.h"
+
+#include <string.h>
+
+/**
+ * Create host end of RPC calls
+ * @param send function called with each framed message, its length and [ctx]
+ * @param ctx[optional] user-defined context passed to [send]
+ * @param crc[optional] whether messages carry CRC (has to match the board)
+ */
+RPCPeer::RPCPeer(void((*send)(const uint8_t*, uint16_t, void*)), void *ctx,
+                 bool crc) : _send(send), _ctx(ctx), _crc(crc),
+                             _rx(_OnFrame, this, crc), _msgN(0)
+{
+}
+
+/**
+ * Feed data the board sent on the socket
+ * @param data received data
+ * @param len length of [data]
+ */
+void RPCPeer::Feed(const uint8_t *data, uint16_t len)
+{
+    _rx.Feed(data, len);
+}
+
+/**
+ * Frame a message without sending it (e.g. to send it in several pieces)
+ * @param buf buffer to write frame to
+ * @param type ESP_RPC_REQUEST or ESP_RPC_RESPONSE
+ * @param id call ID
+ * @param code method of request or status of response
+ * @param data arguments/result
+ * @param len length of [data]
+ * @return length of frame written to [buf]
+ */
+uint16_t RPCPeer::Frame(uint8_t *buf, uint8_t type, uint16_t id, uint8_t code,
+                        const char *data, uint16_t len)
+{
+    uint8_t n = ESPFrameRx::EncodeLen(buf, len + ESP_RPC_HDR_LEN);
+    uint16_t frameLen;
+
+    buf[n] = type;
+    buf[n + 1] = (uint8_t)(id >> 8);
+    buf[n + 2] = (uint8_t)id;
+    buf[n + 3] = code;
+    memcpy(buf + n + ESP_RPC_HDR_LEN, data, len);
+    frameLen = n + ESP_RPC_HDR_LEN + len;
+
+    if (_crc)
+    {
+        uint16_t sum = ESPFrameRx::CRC16(buf, frameLen);
+
+        buf[frameLen++] = (uint8_t)(sum >> 8);
+        buf[frameLen++] = (uint8_t)sum;
+    }
+
+    return frameLen;
+}
+
+/**
+ * Frame a message and pass it to send function
+ */
+void RPCPeer::Send(uint8_t type, uint16_t id, uint8_t code, const char *data,
+                   uint16_t len)
+{
+    uint8_t buf[ESP_FRAME_HDR_MAX + ESP_FRAME_MAX_LEN + ESP_FRAME_CRC_LEN];
+
+    _send(buf, Frame(buf, type, id, code, data, len), _ctx);
+}
+
+/**
+ * Get number of messages received so far
+ * @return number of messages
+ */
+uint8_t RPCPeer::Received()
+{
+    return _msgN;
+}
+
+/**
+ * Get received message
+ * @param index index of message, in order they were received
+ * @return pointer to message, NULL(0) if there's no such message
+ */
+const _rpcPeerMsg* RPCPeer::Get(uint8_t index)
+{
+    if (index >= _msgN)
+        return 0;
+
+    return &_msg[index];
+}
+
+/**
+ * Forget received messages
+ */
+void RPCPeer::Clear()
+{
+    _msgN = 0;
+}
+
+/**
+ * Keep message received from the board
+ */
+void RPCPeer::_OnFrame(const uint8_t *msg, const uint16_t len, void *ctx)
+{
+    RPCPeer *peer = (RPCPeer*)ctx;
+    _rpcPeerMsg *m;
+
+    if ((len < ESP_RPC_HDR_LEN) || (peer->_msgN >= RPC_PEER_MSG_NUM))
+        return;
+
+    m = &peer->_msg[peer->_msgN++];
+    m->type = msg[0];
+    m->id = ((uint16_t)msg[1] << 8) | msg[2];
+    m->code = msg[3];
+    m->len = len - ESP_RPC_HDR_LEN;
+    if (m->len > RPC_PEER_DATA_LEN)
+        m->len = RPC_PEER_DATA_LEN;
+    memcpy(m->data, msg + ESP_RPC_HDR_LEN, m->len);
+}
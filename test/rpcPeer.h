@@ -0,0 +1,67 @@
+/**
+ * rpcPeer.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Host end of RPC calls (format in esp8266/espRPC.h), the side ESPRPC on the
+ *  board talks to. Received data is split into messages with ESPFrameRx and
+ *  kept for the test to inspect; messages are framed the same way ESPFrame
+ *  does it and passed to a send function (e.g. modelled ESP's +IPD).
+ */
+
+#ifndef TEST_RPCPEER_H_
+#define TEST_RPCPEER_H_
+
+#include "esp8266/espFrameRx.h"
+#include "esp8266/espRPC.h"
+
+//  Max number of received messages kept, and max length of their data
+#define RPC_PEER_MSG_NUM        32
+#define RPC_PEER_DATA_LEN       512
+
+/**
+ * Message received from the board
+ */
+struct _rpcPeerMsg
+{
+    uint8_t     type;
+    uint16_t    id;
+    uint8_t     code;
+    uint16_t    len;
+    uint8_t     data[RPC_PEER_DATA_LEN];
+};
+
+/**
+ * RPCPeer class - decoder and encoder of RPC messages on the host
+ */
+class RPCPeer
+{
+    public:
+        RPCPeer(void((*send)(const uint8_t*, uint16_t, void*)), void *ctx = 0,
+                bool crc = false);
+
+        void        Feed(const uint8_t *data, uint16_t len);
+        uint16_t    Frame(uint8_t *buf, uint8_t type, uint16_t id, uint8_t code,
+                          const char *data, uint16_t len);
+        void        Send(uint8_t type, uint16_t id, uint8_t code,
+                         const char *data, uint16_t len);
+        uint8_t     Received();
+        const _rpcPeerMsg*  Get(uint8_t index);
+        void        Clear();
+
+    private:
+        static void _OnFrame(const uint8_t *msg, const uint16_t len,
+                             void *ctx);
+
+        //  Function sending framed messages to the board, and its context
+        void        ((*_send)(const uint8_t*, uint16_t, void*));
+        void        *_ctx;
+        bool        _crc;
+        ESPFrameRx  _rx;
+        //  Messages received so far
+        _rpcPeerMsg _msg[RPC_PEER_MSG_NUM];
+        uint8_t     _msgN;
+};
+
+#endif /* TEST_RPCPEER_H_ */
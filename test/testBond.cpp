@@ -0,0 +1,324 @@
+/**
+ * testBond.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Bonded stream (ESPBond/ESPBondRx): reassembly of frames arriving out of
+ *  order and split, window of unacknowledged frames on the sender, loss of a
+ *  link, and throughput of one module against two. Each modelled module sends
+ *  buffered segments at ESP_HOST_RATE_KBS and acknowledges them once sent.
+ */
+#include "esp8266/esp8266.h"
+#include "esp8266/espBond.h"
+#include "hostEsp.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+//  Rate at which each modelled module sends data over WiFi
+#define ESP_HOST_RATE_KBS       100
+//  Length of stream used for throughput measurement
+#define STREAM_LEN              200000
+
+//  Reassembled stream
+static uint8_t out[STREAM_LEN];
+static uint32_t outLen = 0;
+
+static void Sink(const uint8_t *data, const uint16_t len, void *ctx)
+{
+    (void)ctx;
+    if ((outLen + len) <= sizeof(out))
+        memcpy(out + outLen, data, len);
+    outLen += len;
+}
+
+static ESPBondRx rx(Sink);
+
+/**
+ * Model of both ends: data written to a module goes straight to receiver,
+ * unless module holds it (it's never sent nor acknowledged)
+ */
+static struct
+{
+    uint16_t    seg;
+    uint64_t    busyUntilUS;
+    bool        hold;
+    bool        closed;
+    uint32_t    heldFrames;
+    uint32_t    heldBytes;
+} mod[2];
+
+static uint64_t NowUS()
+{
+    return (uint64_t)HAL_GetMS() * 1000;
+}
+
+static const char* OnCommand(uint8_t port, const char *line)
+{
+    static char reply[32];
+
+    if (strncmp(line, "AT+CIPSTART=", 12) == 0)
+    {
+        sprintf(reply, "%c,CONNECT\r\n\r\nOK\r\n", line[12]);
+        return reply;
+    }
+    if (strncmp(line, "AT+CIPSENDBUF=", 14) == 0)
+    {
+        if (mod[port].closed)
+            return "\r\nERROR\r\n";
+        mod[port].seg++;
+        sprintf(reply, "%u,0\r\n\r\nOK\r\n> ", mod[port].seg);
+        return reply;
+    }
+
+    return 0;
+}
+
+static const char* OnData(uint8_t port, const char *data, uint16_t len)
+{
+    static char reply[32];
+    uint64_t now = NowUS();
+    uint32_t delayMS;
+
+    //  Every segment is one frame of bonded stream
+    if (mod[port].hold)
+    {
+        mod[port].heldFrames++;
+        mod[port].heldBytes += len - ESP_BOND_HDR_LEN;
+    }
+    else
+    {
+        rx.Feed(port, (const uint8_t*)data, len);
+        //  Segment is acknowledged once module sent it at its rate
+        if (mod[port].busyUntilUS < now)
+            mod[port].busyUntilUS = now;
+        mod[port].busyUntilUS += (uint64_t)len * 1000 / ESP_HOST_RATE_KBS;
+        delayMS = (uint32_t)((mod[port].busyUntilUS - now) / 1000);
+        sprintf(reply, "%u,%u,SEND OK\r\n", port, mod[port].seg);
+        HostESP_ReplyStr(port, reply, delayMS + 1);
+    }
+    sprintf(reply, "\r\nRecv %u bytes\r\n", len);
+
+    return reply;
+}
+
+/**
+ * Build frame of bonded stream
+ * @return length of frame
+ */
+static uint16_t Frame(uint8_t *buf, uint32_t seq, const char *payload)
+{
+    uint16_t len = strlen(payload);
+
+    buf[0] = (uint8_t)(seq >> 24);
+    buf[1] = (uint8_t)(seq >> 16);
+    buf[2] = (uint8_t)(seq >> 8);
+    buf[3] = (uint8_t)seq;
+    buf[4] = (uint8_t)(len >> 8);
+    buf[5] = (uint8_t)len;
+    memcpy(buf + ESP_BOND_HDR_LEN, payload, len);
+
+    return len + ESP_BOND_HDR_LEN;
+}
+
+/**
+ * Reassembler alone: order, split frames, duplicates, window, lost link
+ */
+static void TestRx()
+{
+    ESPBondRx r(Sink);
+    uint8_t f[3][16], bad[6] = {0, 0, 0, 3, 0xFF, 0xFF};
+    uint16_t l0 = Frame(f[0], 0, "ab"), l1 = Frame(f[1], 1, "c");
+    uint16_t l2 = Frame(f[2], 2, "de");
+
+    outLen = 0;
+    r.Feed(1, f[1], 3);
+    r.Feed(0, f[2], l2);
+    r.Feed(1, f[1] + 3, l1 - 3);
+    HOST_CHECK((outLen == 0) && (r.NextSeq() == 0));
+    r.Feed(0, f[0], l0);
+    HOST_CHECK((outLen == 5) && (memcmp(out, "abcde", 5) == 0));
+    HOST_CHECK(r.NextSeq() == 3);
+    r.Feed(0, f[1], l1);
+    HOST_CHECK(outLen == 5);
+    r.Feed(1, bad, sizeof(bad));
+    HOST_CHECK(r.FramesInvalid() == 1);
+
+    //  Frame 3 is missing: nothing is given up while links are up, frames
+    //  past the window are dropped
+    for (uint32_t s = 4; s <= ESP_BOND_RX_WIN + 3; s++)
+    {
+        uint8_t fx[16];
+
+        r.Feed(0, fx, Frame(fx, s, "x"));
+    }
+    HOST_CHECK((r.FramesSkipped() == 0) && (r.NextSeq() == 3));
+    HOST_CHECK(r.FramesInvalid() == 2);
+    HOST_CHECK(outLen == 5);
+
+    //  Frame 3 was sent on link 1, which went down; link 0 is already past it
+    r.LinkDown(1);
+    HOST_CHECK(r.FramesSkipped() == 1);
+    HOST_CHECK(r.NextSeq() == ESP_BOND_RX_WIN + 3);
+    HOST_CHECK(outLen == (5 + ESP_BOND_RX_WIN - 1));
+    r.Feed(1, f[0], l0);
+    HOST_CHECK(outLen == (5 + ESP_BOND_RX_WIN - 1));
+}
+
+/**
+ * Sender doesn't get more than ESP_BOND_RX_WIN frames ahead of a frame that
+ * isn't acknowledged, even when the other link is free
+ */
+static void TestWindow(ESP8266 &a, ESP8266 &b)
+{
+    ESPBond bond;
+    static char data[ESP_BOND_MAX_PAYLOAD * (ESP_BOND_RX_WIN + 2)];
+    char ack[32];
+    uint32_t written = 0;
+
+    rx.Reset();
+    outLen = 0;
+    HOST_CHECK(bond.AddLink(&a, 0) && bond.AddLink(&b, 1));
+    //  Link 0 takes frames (first one included) and never acknowledges them
+    mod[0].hold = true;
+    for (uint8_t i = 0; i < 50; i++)
+    {
+        written += bond.Write(data, sizeof(data) - written);
+        usleep(2000);
+    }
+    HOST_CHECK(mod[0].heldFrames > 0);
+    HOST_CHECK(bond.NextSeq() == ESP_BOND_RX_WIN);
+    HOST_CHECK(written == (ESP_BOND_RX_WIN * ESP_BOND_MAX_PAYLOAD));
+    //  Receiver holds the ones link 1 sent, waiting for the first one
+    HOST_CHECK((outLen == 0) && (rx.NextSeq() == 0));
+    HOST_CHECK(rx.FramesSkipped() == 0);
+    HOST_CHECK(rx.FramesInvalid() == 0);
+
+    //  Module reports its frames as sent, window moves on
+    mod[0].hold = false;
+    sprintf(ack, "0,%u,SEND OK\r\n", mod[0].seg);
+    HostESP_ReplyStr(0, ack, 0);
+    HostESP_WaitIdle(0);
+    HOST_CHECK(bond.Write(data, ESP_BOND_MAX_PAYLOAD) == ESP_BOND_MAX_PAYLOAD);
+    HostESP_WaitIdle(0);
+    HostESP_WaitIdle(1);
+}
+
+/**
+ * Write whole stream through bond of [links] links
+ * @return throughput in kB/s
+ */
+static double Stream(ESP8266 &a, ESP8266 &b, uint8_t links, const char *data)
+{
+    ESPBond bond;
+    uint32_t pos = 0, startMS, ms;
+
+    rx.Reset();
+    outLen = 0;
+    HOST_CHECK(bond.AddLink(&a, 0));
+    if (links == 2)
+        HOST_CHECK(bond.AddLink(&b, 1));
+
+    startMS = HAL_GetMS();
+    while (pos < STREAM_LEN)
+    {
+        uint32_t n = STREAM_LEN - pos;
+
+        if (n > 4000)
+            n = 4000;
+        pos += bond.Write(data + pos, n);
+        if (pos < STREAM_LEN)
+            usleep(500);
+    }
+    while (a.GetClientBySockID(0)->BytesInFlight() ||
+           b.GetClientBySockID(1)->BytesInFlight())
+        usleep(500);
+    ms = HAL_GetMS() - startMS;
+
+    printf("%u link(s): %u bytes in %u ms, %.1f kB/s, split %u/%u\n", links,
+           STREAM_LEN, ms, STREAM_LEN / (double)ms, bond.BytesSent(0),
+           bond.BytesSent(1));
+    HOST_CHECK((outLen == STREAM_LEN) && (memcmp(out, data, STREAM_LEN) == 0));
+    HOST_CHECK(rx.FramesSkipped() == 0);
+
+    return STREAM_LEN / (double)ms;
+}
+
+/**
+ * Socket of link 1 closes with frames in flight: stream goes on over link 0,
+ * receiver gives up only on frames lost with link 1
+ */
+static void TestLinkLoss(ESP8266 &a, ESP8266 &b, const char *data)
+{
+    ESPBond bond;
+    uint32_t pos = 0, tries = 0;
+
+    rx.Reset();
+    outLen = 0;
+    HOST_CHECK(bond.AddLink(&a, 0) && bond.AddLink(&b, 1));
+    while ((pos < 8000) && (tries++ < 1000))
+    {
+        pos += bond.Write(data + pos, 8000 - pos);
+        usleep(1000);
+    }
+    HostESP_WaitIdle(0);
+    HostESP_WaitIdle(1);
+    //  Both links are idle, one frame goes to each; the one on link 1 dies
+    //  with its socket
+    mod[1].hold = true;
+    pos += bond.Write(data + pos, 2 * ESP_BOND_MAX_PAYLOAD);
+    mod[1].closed = true;
+    HostESP_ReplyStr(1, "1,CLOSED\r\n", 0);
+    HostESP_WaitIdle(1);
+    rx.LinkDown(1);
+
+    while ((pos < 40000) && (tries++ < 1000))
+    {
+        pos += bond.Write(data + pos, 40000 - pos);
+        usleep(1000);
+    }
+    HostESP_WaitIdle(0);
+    HOST_CHECK(pos == 40000);
+    HOST_CHECK(!bond.LinkUp(1));
+    HOST_CHECK(mod[1].heldFrames > 0);
+    HOST_CHECK(rx.NextSeq() == bond.NextSeq());
+    HOST_CHECK(rx.FramesSkipped() == mod[1].heldFrames);
+    HOST_CHECK(rx.BytesDelivered() == (40000 - mod[1].heldBytes));
+    HOST_CHECK(rx.FramesInvalid() == 0);
+}
+
+int main()
+{
+    ESP8266 &a = ESP8266::GetI();
+    ESP8266 b(&HAL_ESP_PORT1);
+    static char data[STREAM_LEN];
+    double one, two;
+
+    TestRx();
+
+    HostESP_Start();
+    HostESP_OnCommand(0, OnCommand);
+    HostESP_OnCommand(1, OnCommand);
+    HostESP_OnData(0, OnData);
+    HostESP_OnData(1, OnData);
+    HOST_CHECK(a.InitHW() & ESP_STATUS_OK);
+    HOST_CHECK(b.InitHW() & ESP_STATUS_OK);
+    a.wifiStatus = b.wifiStatus = ESP_WIFI_CONNECTED;
+    HOST_CHECK(a.OpenTCPSock((char*)"10.0.0.9", 80, true, 0) == 0);
+    HOST_CHECK(b.OpenTCPSock((char*)"10.0.0.9", 80, true, 1) == 1);
+
+    TestWindow(a, b);
+
+    srand(1);
+    for (uint32_t i = 0; i < STREAM_LEN; i++)
+        data[i] = (char)(rand() & 0xFF);
+    one = Stream(a, b, 1, data);
+    two = Stream(a, b, 2, data);
+    HOST_CHECK(two > (1.6 * one));
+
+    TestLinkLoss(a, b, data);
+
+    return HostTestDone("testBond");
+}
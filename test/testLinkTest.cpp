@@ -0,0 +1,88 @@
+/**
+ * testLinkTest.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Echo of link test command (baud-rate negotiation) has to match the command
+ *  that was sent. ESP echoes a command together with the '\r' it received,
+ *  followed by "\r\n", so the echoed line ends in '\r' which is not part of
+ *  the command.
+ */
+#include "esp8266/esp8266.h"
+#include "hostEsp.h"
+
+#include <string.h>
+
+//  Link test command, and bytes ESP8266 (AT firmware 1.x, echo on) sends back
+//  when it's written to it
+static const char linkCmd[] = "AT+LINKTEST=q3ZfT0bGm8LwXk1Rj5aVYcNe7Hs2";
+static const char linkCapture[] =
+        "AT+LINKTEST=q3ZfT0bGm8LwXk1Rj5aVYcNe7Hs2\r\r\n"
+        "\r\n"
+        "ERROR\r\n";
+
+/**
+ * Gives test access to echo capture of the driver
+ */
+class EchoProbe : public ESP8266
+{
+    public:
+        EchoProbe() : ESP8266(&HAL_ESP_PORT1) {}
+
+        /**
+         * Parse [len] bytes of [capture] with echo capture on
+         * @return true if captured echo matches [cmd]
+         */
+        bool Echo(const char *capture, uint16_t len, const char *cmd)
+        {
+            char buf[128];
+            uint32_t status;
+
+            memcpy(buf, capture, len);
+            _echoLen = 0;
+            _echoCapture = true;
+            status = ParseResponse(buf, len, false);
+            _echoCapture = false;
+
+            return (status & ESP_STATUS_ERROR) &&
+                   (_echoLen == strlen(cmd)) &&
+                   (_echoCRC == _CRC16(cmd, strlen(cmd)));
+        }
+};
+
+int main()
+{
+    ESP8266 &esp = ESP8266::GetI();
+    EchoProbe probe;
+    uint8_t tested = 0;
+
+    //  Echo as ESP sends it, and without the extra '\r'
+    HOST_CHECK(probe.Echo(linkCapture, sizeof(linkCapture) - 1, linkCmd));
+    {
+        char plain[sizeof(linkCapture)];
+        uint16_t len = strlen(linkCmd);
+
+        memcpy(plain, linkCmd, len);
+        memcpy(plain + len, "\r\n\r\nERROR\r\n", 11);
+        HOST_CHECK(probe.Echo(plain, len + 11, linkCmd));
+    }
+
+    //  Whole negotiation against modelled ESP, which echoes the same way
+    HostESP_Start();
+    HOST_CHECK(esp.InitHW(ESP_DEF_BAUD, true) & ESP_STATUS_OK);
+    for (uint8_t i = 0; i < ESP_BAUD_CAND_NUM; i++)
+    {
+        const _espLinkTest *test = esp.GetLinkTest(i);
+
+        if (test->rounds == 0)
+            continue;
+        tested++;
+        HOST_CHECK(test->rounds == ESP_BAUD_TEST_ROUNDS);
+        HOST_CHECK(test->errors == 0);
+    }
+    HOST_CHECK(tested > 0);
+    HOST_CHECK(esp.GetBaud() == ESP_MAX_BAUD);
+
+    return HostTestDone("testLinkTest");
+}
@@ -0,0 +1,213 @@
+/**
+ * testParse.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Socket data (+IPD) containing text of ESP's status messages ("OK", "ERROR",
+ *  "> ", "n,CLOSED", ...) has to reach socket's handler unchanged, and must not
+ *  complete pending commands, close sockets or change WiFi status. Data of a
+ *  long +IPD has to reach the handler whole, in one call, so framed messages
+ *  (ESPFrameRx) carried in it stay in sync.
+ */
+#include "esp8266/esp8266.h"
+#include "esp8266/espFrame.h"
+#include "hostEsp.h"
+
+#include <string.h>
+
+//  Data received through socket handler
+static char rxData[4096];
+static uint16_t rxLen = 0;
+static uint16_t rxCalls = 0;
+static uint16_t rxMaxCall = 0;
+//  Test schedules replies to commands itself
+static bool quiet = false;
+
+static void OnData(_espClient *cli, const uint8_t *data, const uint16_t len,
+                   void *ctx)
+{
+    (void)cli;
+    (void)ctx;
+    memcpy(rxData + rxLen, data, len);
+    rxLen += len;
+    rxCalls++;
+    if (len > rxMaxCall)
+        rxMaxCall = len;
+}
+
+//  Messages reassembled from socket data
+static uint8_t msgData[2048];
+static uint16_t msgLen = 0;
+static uint16_t msgNum = 0;
+
+static void OnMessage(const uint8_t *msg, const uint16_t len, void *ctx)
+{
+    (void)ctx;
+    memcpy(msgData, msg, len);
+    msgLen = len;
+    msgNum++;
+}
+
+static const char* OnCommand(uint8_t port, const char *line)
+{
+    (void)port;
+    if (strncmp(line, "AT+CIPSTART=", 12) == 0)
+        return "0,CONNECT\r\n\r\nOK\r\n";
+
+    return quiet ? "" : 0;
+}
+
+//  Payloads which look like status messages of ESP
+static const char *payloads[] =
+{
+    "OK\r\n",
+    "\r\nERROR\r\n",
+    "> ",
+    "0,CLOSED\r\n",
+    "OK\r\n0,CLOSED\r\n> ERROR\r\nWIFI DISCONNECT\r\nSEND OK\r\n",
+};
+#define PAYLOAD_NUM     (sizeof(payloads) / sizeof(payloads[0]))
+
+/**
+ * Build "+IPD,0,<len>:<payload>" frame
+ * @return length of frame
+ */
+static uint16_t IPDFrame(char *buf, const char *payload)
+{
+    uint16_t len = strlen(payload);
+    uint16_t hdr = sprintf(buf, "+IPD,0,%u:", len);
+
+    memcpy(buf + hdr, payload, len);
+
+    return hdr + len;
+}
+
+/**
+ * Feed frames directly to ParseResponse
+ */
+static void TestDirect(ESP8266 &esp)
+{
+    char buf[256];
+
+    for (uint8_t i = 0; i < PAYLOAD_NUM; i++)
+    {
+        uint16_t len = IPDFrame(buf, payloads[i]);
+        uint32_t status;
+
+        rxLen = rxCalls = 0;
+        status = esp.ParseResponse(buf, len);
+        HOST_CHECK(status == ESP_STATUS_IPD);
+        HOST_CHECK((rxLen == strlen(payloads[i])) &&
+                   (memcmp(rxData, payloads[i], rxLen) == 0));
+        HOST_CHECK(rxCalls == 1);
+        HOST_CHECK(esp.GetClientBySockID(0) != 0);
+        HOST_CHECK(esp.wifiStatus == ESP_WIFI_CONNECTED);
+    }
+
+    //  Two frames and a status line in one piece: only the line counts
+    {
+        uint16_t len = IPDFrame(buf, payloads[1]);
+
+        len += IPDFrame(buf + len, payloads[2]);
+        strcpy(buf + len, "\r\nOK\r\n");
+        len += 6;
+        rxLen = rxCalls = 0;
+        HOST_CHECK(esp.ParseResponse(buf, len) ==
+                   (ESP_STATUS_IPD | ESP_STATUS_OK));
+        HOST_CHECK(rxCalls == 2);
+        HOST_CHECK((rxLen == 11) &&
+                   (memcmp(rxData, "\r\nERROR\r\n> ", 11) == 0));
+    }
+}
+
+/**
+ * +IPD frames longer than 1023 bytes, carrying one framed message each, reach
+ * handler whole in a single call
+ */
+static void TestLong(ESP8266 &esp)
+{
+    static const uint16_t sizes[] = {1023, 1024, 1460, 2000};
+    ESPFrameRx frameRx(OnMessage, 0, true);
+    static char buf[2100];
+
+    esp.GetClientBySockID(0)->SetHandler(OnData);
+    for (uint8_t i = 0; i < (sizeof(sizes) / sizeof(sizes[0])); i++)
+    {
+        uint16_t msg = sizes[i] - 2 - ESP_FRAME_CRC_LEN;
+        uint16_t hdr = sprintf(buf, "+IPD,0,%u:", sizes[i]);
+        uint8_t *frame = (uint8_t*)buf + hdr;
+        uint8_t n = ESPFrameRx::EncodeLen(frame, msg);
+        uint16_t crc;
+
+        for (uint16_t j = 0; j < msg; j++)
+            frame[n + j] = (uint8_t)(j * 7 + i);
+        crc = ESPFrameRx::CRC16(frame, n + msg);
+        frame[n + msg] = (uint8_t)(crc >> 8);
+        frame[n + msg + 1] = (uint8_t)crc;
+
+        rxLen = rxCalls = rxMaxCall = 0;
+        HOST_CHECK(esp.ParseResponse(buf, hdr + sizes[i]) == ESP_STATUS_IPD);
+        HOST_CHECK(rxLen == sizes[i]);
+        HOST_CHECK(memcmp(rxData, frame, sizes[i]) == 0);
+        HOST_CHECK((rxCalls == 1) && (rxMaxCall == sizes[i]));
+
+        msgNum = 0;
+        frameRx.Feed((const uint8_t*)rxData, rxLen);
+        HOST_CHECK((msgNum == 1) && (msgLen == msg));
+        HOST_CHECK(memcmp(msgData, frame + n, msg) == 0);
+        HOST_CHECK(frameRx.FramesInvalid() == 0);
+    }
+}
+
+/**
+ * Data arrives through UART while a command is waiting for its reply
+ */
+static void TestPending(ESP8266 &esp)
+{
+    char buf[256];
+    uint16_t len = IPDFrame(buf, payloads[PAYLOAD_NUM - 1]);
+    uint32_t status;
+    _espEvent ev;
+    bool closed = false;
+
+    while (esp.GetEvent(&ev));
+    rxLen = rxCalls = 0;
+    //  Reply to the command comes well after the data
+    HostESP_Reply(0, buf, len, 2);
+    HostESP_ReplyStr(0, "\r\nERROR\r\n", 40);
+    quiet = true;
+    status = esp.RemoteInfo(false);
+    quiet = false;
+
+    HOST_CHECK(status & ESP_STATUS_ERROR);
+    HOST_CHECK(!(status & (ESP_STATUS_OK | ESP_STATUS_SOCKCLOSE)));
+    HOST_CHECK((rxLen == strlen(payloads[PAYLOAD_NUM - 1])) &&
+               (memcmp(rxData, payloads[PAYLOAD_NUM - 1], rxLen) == 0));
+    HOST_CHECK(esp.GetClientBySockID(0) != 0);
+    while (esp.GetEvent(&ev))
+        if ((ev.type == ESP_EV_SOCKCLOSE) || (ev.type == ESP_EV_WIFIDISCN))
+            closed = true;
+    HOST_CHECK(!closed);
+}
+
+int main()
+{
+    ESP8266 &esp = ESP8266::GetI();
+
+    HostESP_Start();
+    HostESP_OnCommand(0, OnCommand);
+    HOST_CHECK(esp.InitHW() & ESP_STATUS_OK);
+    esp.wifiStatus = ESP_WIFI_CONNECTED;
+    HOST_CHECK(esp.OpenTCPSock((char*)"10.0.0.9", 80, true, 9, OnData) == 0);
+    HostESP_WaitIdle(0);
+
+    //  UART interrupt stays off while test calls the parser itself
+    HAL_ESP_IntEnable(&HAL_ESP_PORT0, false);
+    TestDirect(esp);
+    TestLong(esp);
+    HAL_ESP_IntEnable(&HAL_ESP_PORT0, true);
+    TestPending(esp);
+
+    return HostTestDone("testParse");
+}
@@ -0,0 +1,128 @@
+/**
+ * testPassthrough.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Throughput of a single socket in transparent transmission (passthrough)
+ *  against normal mode (AT+CIPSEND, '>' prompt and SEND OK for every write),
+ *  for small and big writes, and return to command mode with "+++". Modelled
+ *  module takes data at the pace of UART at ESP_DEF_BAUD and reports SEND OK
+ *  once remote end acknowledges data, ESP_HOST_ACK_MS after it was written.
+ */
+#include "esp8266/esp8266.h"
+#include "esp8266/espClient.h"
+#include "hostEsp.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+//  Time from data written to module until remote end acknowledges it
+#define ESP_HOST_ACK_MS         5
+//  Length of stream used for throughput measurement
+#define STREAM_LEN              60000
+
+//  Data that reached remote end
+static char out[STREAM_LEN];
+static volatile uint32_t outLen = 0;
+
+static const char* OnCommand(uint8_t port, const char *line)
+{
+    (void)port;
+    if (strncmp(line, "AT+CIPSTART=\"", 13) == 0)
+        return "CONNECT\r\n\r\nOK\r\n";
+    if (strncmp(line, "AT+CIPSTART=", 12) == 0)
+        return "0,CONNECT\r\n\r\nOK\r\n";
+    if (strncmp(line, "AT+CIPSEND=", 11) == 0)
+        return "\r\nOK\r\n> ";
+    if (strncmp(line, "AT+CIPCLOSE=", 12) == 0)
+        return "0,CLOSED\r\n\r\nOK\r\n";
+
+    return 0;
+}
+
+static const char* OnData(uint8_t port, const char *data, uint16_t len)
+{
+    static char reply[32];
+
+    if ((outLen + len) <= sizeof(out))
+        memcpy(out + outLen, data, len);
+    outLen += len;
+    if (HostESP_Transparent(port))
+        return 0;
+
+    HostESP_ReplyStr(port, "\r\nSEND OK\r\n", ESP_HOST_ACK_MS);
+    sprintf(reply, "\r\nRecv %u bytes\r\n", len);
+
+    return reply;
+}
+
+/**
+ * Write whole stream in pieces of [chunk] bytes and wait until remote end has
+ * all of it
+ * @return throughput in kB/s
+ */
+static double Stream(_espClient *cli, const char *data, uint16_t chunk,
+                     const char *mode)
+{
+    uint32_t startMS, ms;
+
+    outLen = 0;
+    startMS = HAL_GetMS();
+    for (uint32_t pos = 0; pos < STREAM_LEN; pos += chunk)
+        cli->SendTCP((char*)data + pos, chunk);
+    while (outLen < STREAM_LEN)
+        usleep(100);
+    ms = HAL_GetMS() - startMS;
+
+    printf("%s, %4u B writes: %u bytes in %u ms, %.1f kB/s\n", mode, chunk,
+           STREAM_LEN, ms, STREAM_LEN / (double)ms);
+    HOST_CHECK((outLen == STREAM_LEN) && (memcmp(out, data, STREAM_LEN) == 0));
+
+    return STREAM_LEN / (double)ms;
+}
+
+int main()
+{
+    ESP8266 &esp = ESP8266::GetI();
+    static char data[STREAM_LEN];
+    const uint16_t chunks[2] = { 240, 2000 };
+    double normal[2], pt[2] = { 0, 0 };
+
+    HostESP_Start();
+    HostESP_OnCommand(0, OnCommand);
+    HostESP_OnData(0, OnData);
+    HOST_CHECK(esp.InitHW() & ESP_STATUS_OK);
+    esp.wifiStatus = ESP_WIFI_CONNECTED;
+    HostESP_Baud(0, ESP_DEF_BAUD);
+
+    srand(1);
+    for (uint32_t i = 0; i < STREAM_LEN; i++)
+        data[i] = (char)(rand() & 0xFF);
+
+    HOST_CHECK(esp.OpenTCPSock((char*)"10.0.0.9", 80, true, 0) == 0);
+    for (uint8_t i = 0; i < 2; i++)
+        normal[i] = Stream(esp.GetClientBySockID(0), data, chunks[i], "CIPSEND");
+    esp.GetClientBySockID(0)->Close();
+    HostESP_WaitIdle(0);
+    esp.TCPListen(false);
+
+    HOST_CHECK(esp.StartPassthrough((char*)"10.0.0.9", 80) & ESP_STATUS_RECV);
+    HOST_CHECK(esp.InPassthrough() && HostESP_Transparent(0));
+    for (uint8_t i = 0; (i < 2) && esp.InPassthrough(); i++)
+        pt[i] = Stream(esp.GetClientBySockID(0), data, chunks[i], "passthrough");
+
+    //  Escape sequence takes module back to command mode, nothing of it is
+    //  taken as data
+    outLen = 0;
+    HOST_CHECK(esp.StopPassthrough() & ESP_STATUS_OK);
+    HOST_CHECK(!esp.InPassthrough() && !HostESP_Transparent(0));
+    HOST_CHECK(outLen == 0);
+
+    for (uint8_t i = 0; i < 2; i++)
+        HOST_CHECK(pt[i] > normal[i]);
+    HOST_CHECK(pt[0] > (2 * normal[0]));
+
+    return HostTestDone("testPassthrough");
+}
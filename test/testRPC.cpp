@@ -0,0 +1,221 @@
+/**
+ * testRPC.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  RPC calls (ESPRPC) between the board and host peer (RPCPeer) over a socket
+ *  of modelled ESP: several calls in flight answered out of order and split
+ *  across +IPD frames, full call table, timeouts and late responses, and
+ *  requests coming from the peer.
+ */
+#include "esp8266/esp8266.h"
+#include "esp8266/espClient.h"
+#include "esp8266/espRPC.h"
+#include "hostEsp.h"
+#include "rpcPeer.h"
+
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Peer's data reaches the board as +IPD on socket 0
+ */
+static void PeerSend(const uint8_t *data, uint16_t len, void *ctx)
+{
+    char buf[2100];
+    uint16_t hdr = sprintf(buf, "+IPD,0,%u:", len);
+
+    (void)ctx;
+    memcpy(buf + hdr, data, len);
+    HostESP_Reply(0, buf, hdr + len, 0);
+    HostESP_WaitIdle(0);
+}
+
+static RPCPeer peer(PeerSend, 0, true);
+
+static const char* OnCommand(uint8_t port, const char *line)
+{
+    (void)port;
+    if (strncmp(line, "AT+CIPSTART=", 12) == 0)
+        return "0,CONNECT\r\n\r\nOK\r\n";
+    if (strncmp(line, "AT+CIPSEND=", 11) == 0)
+        return "\r\nOK\r\n> ";
+
+    return 0;
+}
+
+static const char* OnData(uint8_t port, const char *data, uint16_t len)
+{
+    (void)port;
+    peer.Feed((const uint8_t*)data, len);
+
+    return 0;
+}
+
+//  Completed calls, in order of completion
+static struct
+{
+    uint16_t    id;
+    uint8_t     status;
+    uint16_t    len;
+    char        data[512];
+} done[16];
+static uint8_t doneN = 0;
+
+static void OnDone(uint16_t id, uint8_t status, const uint8_t *data,
+                   const uint16_t len, void *ctx)
+{
+    (void)ctx;
+    if (doneN >= 16)
+        return;
+    done[doneN].id = id;
+    done[doneN].status = status;
+    done[doneN].len = len;
+    memcpy(done[doneN].data, data, len);
+    doneN++;
+}
+
+//  Requests from the peer, answered from main context
+static uint16_t reqID;
+static uint8_t reqMethod;
+static uint8_t reqN = 0;
+
+static void OnRequest(ESPRPC *rpc, uint16_t id, uint8_t method,
+                      const uint8_t *args, const uint16_t len, void *ctx)
+{
+    (void)rpc;
+    (void)args;
+    (void)len;
+    (void)ctx;
+    reqID = id;
+    reqMethod = method;
+    reqN++;
+}
+
+static bool Done(uint8_t i, uint16_t id, uint8_t status, const char *data)
+{
+    return (done[i].id == id) && (done[i].status == status) &&
+           (done[i].len == strlen(data)) &&
+           (memcmp(done[i].data, data, done[i].len) == 0);
+}
+
+/**
+ * Four calls in flight, answered out of order; last two in one piece of data
+ * split across two +IPD frames
+ */
+static void TestPipelined(ESPRPC &rpc)
+{
+    uint16_t ids[4];
+    char args[8];
+    uint8_t buf[600];
+    uint16_t len;
+    static char longRes[300];
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        sprintf(args, "arg%u", i);
+        HOST_CHECK(rpc.Call(1, args, 4, OnDone, 0, 1000, &ids[i]) &
+                   ESP_STATUS_SENDOK);
+    }
+    HOST_CHECK(rpc.InFlight() == 4);
+    HOST_CHECK(peer.Received() == 4);
+    for (uint8_t i = 0; (i < 4) && (i < peer.Received()); i++)
+    {
+        sprintf(args, "arg%u", i);
+        HOST_CHECK(peer.Get(i)->type == ESP_RPC_REQUEST);
+        HOST_CHECK((peer.Get(i)->id == ids[i]) && (peer.Get(i)->code == 1));
+        HOST_CHECK((peer.Get(i)->len == 4) &&
+                   (memcmp(peer.Get(i)->data, args, 4) == 0));
+    }
+    HOST_CHECK((ids[0] != ids[1]) && (ids[1] != ids[2]) && (ids[2] != ids[3]));
+
+    peer.Send(ESP_RPC_RESPONSE, ids[2], ESP_RPC_OK, "r2", 2);
+    peer.Send(ESP_RPC_RESPONSE, ids[0], 7, "r0", 2);
+    memset(longRes, 'L', sizeof(longRes));
+    len = peer.Frame(buf, ESP_RPC_RESPONSE, ids[3], ESP_RPC_OK, "r3", 2);
+    len += peer.Frame(buf + len, ESP_RPC_RESPONSE, ids[1], ESP_RPC_OK, longRes,
+                      sizeof(longRes));
+    PeerSend(buf, 5, 0);
+    PeerSend(buf + 5, len - 5, 0);
+
+    HOST_CHECK(doneN == 4);
+    HOST_CHECK(Done(0, ids[2], ESP_RPC_OK, "r2"));
+    HOST_CHECK(Done(1, ids[0], 7, "r0"));
+    HOST_CHECK(Done(2, ids[3], ESP_RPC_OK, "r3"));
+    HOST_CHECK((done[3].id == ids[1]) && (done[3].len == sizeof(longRes)));
+    HOST_CHECK(rpc.InFlight() == 0);
+}
+
+/**
+ * Full call table, timeouts and a response that comes too late
+ */
+static void TestTimeout(ESPRPC &rpc)
+{
+    uint16_t first;
+
+    doneN = 0;
+    for (uint8_t i = 0; i < ESP_RPC_MAX_CALLS; i++)
+        HOST_CHECK(rpc.Call(2, "", 0, OnDone, 0, 50, (i == 0) ? &first : 0) &
+                   ESP_STATUS_SENDOK);
+    HOST_CHECK(rpc.Call(2, "", 0, OnDone) == ESP_STATUS_BUSY);
+
+    rpc.Poll();
+    HOST_CHECK(doneN == 0);
+    usleep(60000);
+    rpc.Poll();
+    HOST_CHECK(doneN == ESP_RPC_MAX_CALLS);
+    HOST_CHECK(done[0].status == ESP_RPC_TIMEOUT);
+    HOST_CHECK(rpc.TimedOut() == ESP_RPC_MAX_CALLS);
+    HOST_CHECK(rpc.InFlight() == 0);
+
+    peer.Send(ESP_RPC_RESPONSE, first, ESP_RPC_OK, "late", 4);
+    HOST_CHECK(doneN == ESP_RPC_MAX_CALLS);
+    HOST_CHECK(rpc.Unmatched() == 1);
+}
+
+/**
+ * Peer calls the board, board answers from main context
+ */
+static void TestRequest(ESPRPC &rpc)
+{
+    peer.Clear();
+    peer.Send(ESP_RPC_REQUEST, 77, 5, "ping", 4);
+    HOST_CHECK((reqN == 1) && (reqID == 77) && (reqMethod == 5));
+
+    HOST_CHECK(rpc.Reply(reqID, ESP_RPC_OK, "pong", 4) & ESP_STATUS_SENDOK);
+    HOST_CHECK(peer.Received() == 1);
+    if (peer.Received() == 1)
+    {
+        HOST_CHECK(peer.Get(0)->type == ESP_RPC_RESPONSE);
+        HOST_CHECK((peer.Get(0)->id == 77) &&
+                   (peer.Get(0)->code == ESP_RPC_OK));
+        HOST_CHECK((peer.Get(0)->len == 4) &&
+                   (memcmp(peer.Get(0)->data, "pong", 4) == 0));
+    }
+}
+
+int main()
+{
+    ESP8266 &esp = ESP8266::GetI();
+    ESPRPC rpc(true);
+
+    HostESP_Start();
+    HostESP_OnCommand(0, OnCommand);
+    HostESP_OnData(0, OnData);
+    HOST_CHECK(esp.InitHW() & ESP_STATUS_OK);
+    esp.wifiStatus = ESP_WIFI_CONNECTED;
+
+    //  Nothing to call through until socket is open
+    HOST_CHECK(!rpc.Attach(&esp, 0));
+    HOST_CHECK(rpc.Call(1, "x", 1, OnDone) == ESP_STATUS_ERROR);
+    HOST_CHECK(esp.OpenTCPSock((char*)"10.0.0.9", 80, true, 0) == 0);
+    HOST_CHECK(rpc.Attach(&esp, 0));
+    rpc.OnRequest(OnRequest);
+
+    TestPipelined(rpc);
+    TestTimeout(rpc);
+    TestRequest(rpc);
+
+    return HostTestDone("testRPC");
+}
@@ -0,0 +1,115 @@
+/**
+ * testRetry.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Socket sends rejected with "busy...": data is copied into retry queue, so
+ *  caller can reuse its buffer right away and the retry still sends original
+ *  data; data that can't be queued is refused with ESP_STATUS_ERROR.
+ */
+#include "esp8266/esp8266.h"
+#include "esp8266/espClient.h"
+#include "hostEsp.h"
+
+#include <string.h>
+#include <unistd.h>
+
+//  Number of AT+CIPSEND commands to reject with "busy..."
+static uint8_t rejectN = 0;
+//  Data that reached remote end
+static char out[256];
+static uint16_t outLen = 0;
+
+static const char* OnCommand(uint8_t port, const char *line)
+{
+    (void)port;
+    if (strncmp(line, "AT+CIPSTART=", 12) == 0)
+        return "0,CONNECT\r\n\r\nOK\r\n";
+    if (strncmp(line, "AT+CIPSEND=", 11) == 0)
+    {
+        if (rejectN > 0)
+        {
+            rejectN--;
+            return "\r\nbusy s...\r\n";
+        }
+        return "\r\nOK\r\n> ";
+    }
+
+    return 0;
+}
+
+static const char* OnData(uint8_t port, const char *data, uint16_t len)
+{
+    (void)port;
+    if ((outLen + len) <= sizeof(out))
+        memcpy(out + outLen, data, len);
+    outLen += len;
+
+    return 0;
+}
+
+/**
+ * Call Service() until retry queue is empty or [ms] passes
+ */
+static void Serve(ESP8266 &esp, _espClient *cli, uint32_t ms)
+{
+    uint32_t startMS = HAL_GetMS();
+
+    while (cli->SendPending() && ((HAL_GetMS() - startMS) < ms))
+    {
+        esp.Service();
+        usleep(1000);
+    }
+    HostESP_WaitIdle(0);
+}
+
+int main()
+{
+    ESP8266 &esp = ESP8266::GetI();
+    _espClient *cli;
+    char buf[32];
+    static char big[ESP_RETRYQ_DATA_LEN + 1];
+
+    HostESP_Start();
+    HostESP_OnCommand(0, OnCommand);
+    HostESP_OnData(0, OnData);
+    HOST_CHECK(esp.InitHW() & ESP_STATUS_OK);
+    esp.wifiStatus = ESP_WIFI_CONNECTED;
+    HOST_CHECK(esp.OpenTCPSock((char*)"10.0.0.9", 80, true, 0) == 0);
+    cli = esp.GetClientBySockID(0);
+    if (cli == 0)
+        return HostTestDone("testRetry");
+
+    //  Rejected data is queued, buffer is overwritten before it's retried
+    rejectN = 1;
+    strcpy(buf, "first");
+    HOST_CHECK(cli->SendTCP(buf, 5) == ESP_STATUS_BUSY);
+    HOST_CHECK(cli->SendPending());
+    //  Data behind it waits in queue too, to keep order
+    strcpy(buf, "second");
+    HOST_CHECK(cli->SendTCP(buf, 6) == ESP_STATUS_BUSY);
+    memset(buf, 'Y', sizeof(buf));
+    Serve(esp, cli, 2000);
+    HOST_CHECK(!cli->SendPending());
+    HOST_CHECK((outLen == 11) && (memcmp(out, "firstsecond", 11) == 0));
+
+    //  Data too long to be copied is refused, not kept as a pointer
+    outLen = 0;
+    rejectN = 1;
+    memset(big, 'b', sizeof(big));
+    HOST_CHECK(cli->SendTCP(big, sizeof(big)) == ESP_STATUS_ERROR);
+    HOST_CHECK(!cli->SendPending());
+
+    //  Full queue refuses further data
+    rejectN = 1;
+    for (uint8_t i = 0; i < ESP_RETRYQ_LEN; i++)
+        HOST_CHECK(cli->SendTCP((char*)"q", 1) == ESP_STATUS_BUSY);
+    HOST_CHECK(cli->SendTCP((char*)"q", 1) == ESP_STATUS_ERROR);
+    rejectN = 0;
+    Serve(esp, cli, 2000);
+    HOST_CHECK(!cli->SendPending());
+    HOST_CHECK(outLen == ESP_RETRYQ_LEN);
+
+    return HostTestDone("testRetry");
+}
@@ -0,0 +1,135 @@
+/**
+ * testSched.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Socket data with library built for task scheduler (__USE_TASK_SCHEDULER__,
+ *  host scheduler in hostKernel.h): ISR only queues ESP_T_RECVSOCK and socket
+ *  handler runs later from the scheduler, reading socket's RespBody then. Data
+ *  of +IPD longer than 1023 bytes has to be there whole when it does, for the
+ *  handler and for Receive(), so framed messages (ESPFrameRx) stay in sync.
+ */
+#include "esp8266/esp8266.h"
+#include "esp8266/espClient.h"
+#include "esp8266/espFrame.h"
+#include "hostEsp.h"
+#include "hostKernel.h"
+
+#include <string.h>
+
+//  Length of +IPD data carrying one framed message, and of the message (2 B
+//  length prefix)
+#define IPD_LEN                 2000
+#define MSG_LEN                 (IPD_LEN - 2 - ESP_FRAME_CRC_LEN)
+
+static ESPFrameRx *frameRx;
+//  Data received through socket handler
+static uint8_t rxData[4096];
+static uint16_t rxLen = 0;
+static uint16_t rxCalls = 0;
+
+static void OnData(_espClient *cli, const uint8_t *data, const uint16_t len,
+                   void *ctx)
+{
+    (void)cli;
+    (void)ctx;
+    if ((rxLen + len) <= sizeof(rxData))
+        memcpy(rxData + rxLen, data, len);
+    rxLen += len;
+    rxCalls++;
+    frameRx->Feed(data, len);
+}
+
+//  Messages reassembled from socket data
+static uint8_t msgData[2048];
+static uint16_t msgLen = 0;
+static uint16_t msgNum = 0;
+
+static void OnMessage(const uint8_t *msg, const uint16_t len, void *ctx)
+{
+    (void)ctx;
+    memcpy(msgData, msg, len);
+    msgLen = len;
+    msgNum++;
+}
+
+static const char* OnCommand(uint8_t port, const char *line)
+{
+    (void)port;
+    if (strncmp(line, "AT+CIPSTART=", 12) == 0)
+        return "0,CONNECT\r\n\r\nOK\r\n";
+
+    return 0;
+}
+
+/**
+ * Build +IPD of socket 0 carrying one framed message (CRC included)
+ * @param buf buffer to build +IPD in
+ * @param frame returns pointer to data of +IPD within [buf]
+ * @param msg returns pointer to the message within [buf]
+ * @return length of +IPD in [buf]
+ */
+static uint16_t IPDFrame(char *buf, uint8_t **frame, uint8_t **msg)
+{
+    uint16_t hdr = sprintf(buf, "\r\n+IPD,0,%u:", IPD_LEN);
+    uint8_t n;
+    uint16_t crc;
+
+    *frame = (uint8_t*)buf + hdr;
+    n = ESPFrameRx::EncodeLen(*frame, MSG_LEN);
+    *msg = *frame + n;
+    for (uint16_t j = 0; j < MSG_LEN; j++)
+        (*msg)[j] = (uint8_t)(j * 13);
+    crc = ESPFrameRx::CRC16(*frame, n + MSG_LEN);
+    (*msg)[MSG_LEN] = (uint8_t)(crc >> 8);
+    (*msg)[MSG_LEN + 1] = (uint8_t)crc;
+    memcpy(buf + hdr + IPD_LEN, "\r\n", 2);
+
+    return hdr + IPD_LEN + 2;
+}
+
+int main()
+{
+    ESP8266 &esp = ESP8266::GetI();
+    ESPFrameRx rx(OnMessage, 0, true);
+    static char buf[2100];
+    static char recv[ESP_RX_BUF_LEN];
+    uint8_t *frame, *msg;
+    uint16_t len, recvLen;
+    _espClient *cli;
+
+    frameRx = &rx;
+    HostESP_Start();
+    HostESP_OnCommand(0, OnCommand);
+    HOST_CHECK(esp.InitHW() & ESP_STATUS_OK);
+    esp.wifiStatus = ESP_WIFI_CONNECTED;
+    HOST_CHECK(esp.OpenTCPSock((char*)"10.0.0.9", 80, true, 0) == 0);
+    cli = esp.GetClientBySockID(0);
+    if (cli == 0)
+        return HostTestDone("testSched");
+    HostKernel_Run();
+    len = IPDFrame(buf, &frame, &msg);
+
+    //  Handler runs only from the scheduler, and gets all data in one call
+    cli->SetHandler(OnData);
+    HostESP_Reply(0, buf, len, 0);
+    HostESP_WaitIdle(0);
+    HOST_CHECK(rxCalls == 0);
+    HOST_CHECK(HostKernel_Run() == 1);
+    HOST_CHECK((rxCalls == 1) && (rxLen == IPD_LEN));
+    HOST_CHECK(memcmp(rxData, frame, IPD_LEN) == 0);
+    HOST_CHECK((msgNum == 1) && (msgLen == MSG_LEN) &&
+               (memcmp(msgData, msg, MSG_LEN) == 0));
+    HOST_CHECK(rx.FramesInvalid() == 0);
+
+    //  Without handler nothing is scheduled, Receive() gets all data
+    cli->SetHandler(0);
+    HostESP_Reply(0, buf, len, 0);
+    HostESP_WaitIdle(0);
+    HOST_CHECK(HostKernel_Pending() == 0);
+    HOST_CHECK(cli->Receive(recv, &recvLen));
+    HOST_CHECK((recvLen == IPD_LEN) && (memcmp(recv, frame, IPD_LEN) == 0));
+
+    return HostTestDone("testSched");
+}
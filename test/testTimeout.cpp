@@ -0,0 +1,59 @@
+/**
+ * testTimeout.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Adaptive timeout of socket data (ESP_CMD_SENDDATA) learned on small sends
+ *  doesn't cut short a big one: watchdog only runs once data is written, so
+ *  UART time of data (UART paced at 57600 baud here) never counts towards it.
+ */
+#include "esp8266/esp8266.h"
+#include "esp8266/espClient.h"
+#include "hostEsp.h"
+
+#include <string.h>
+
+static const char* OnCommand(uint8_t port, const char *line)
+{
+    (void)port;
+    if (strncmp(line, "AT+CIPSTART=", 12) == 0)
+        return "0,CONNECT\r\n\r\nOK\r\n";
+    if (strncmp(line, "AT+CIPSEND=", 11) == 0)
+        return "\r\nOK\r\n> ";
+
+    return 0;
+}
+
+int main()
+{
+    ESP8266 &esp = ESP8266::GetI();
+    const _espCmdStats *stats = esp.GetCmdStats(ESP_CMD_SENDDATA);
+    _espClient *cli;
+    static char big[2000];
+
+    HostESP_Start();
+    HostESP_OnCommand(0, OnCommand);
+    HOST_CHECK(esp.InitHW() & ESP_STATUS_OK);
+    esp.wifiStatus = ESP_WIFI_CONNECTED;
+    HOST_CHECK(esp.OpenTCPSock((char*)"10.0.0.9", 80, true, 0) == 0);
+    cli = esp.GetClientBySockID(0);
+    if (cli == 0)
+        return HostTestDone("testTimeout");
+    HostESP_Baud(0, 57600);
+
+    //  Small sends train the timeout down to its lower bound
+    esp.ResetCmdStats();
+    for (uint8_t i = 0; i < 10; i++)
+        HOST_CHECK(cli->SendTCP((char*)"0123456789abcdef", 16) &
+                   ESP_STATUS_SENDOK);
+    HOST_CHECK(esp.GetTimeout(ESP_CMD_SENDDATA, 600) < 350);
+
+    //  2000 bytes take about 350ms on UART
+    memset(big, 'd', sizeof(big));
+    HOST_CHECK(cli->SendTCP(big, sizeof(big)) & ESP_STATUS_SENDOK);
+    HOST_CHECK(cli->SendTCP((char*)"after", 5) & ESP_STATUS_SENDOK);
+    HOST_CHECK((stats->timeout == 0) && (stats->ok == 12));
+
+    return HostTestDone("testTimeout");
+}
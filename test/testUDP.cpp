@@ -0,0 +1,147 @@
+/**
+ * testUDP.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Rate of small packets sent through a UDP socket against a TCP one, and
+ *  datagram boundaries kept both ways. Modelled module takes data at the pace
+ *  of UART at ESP_DEF_BAUD; it reports SEND OK for a TCP segment once remote
+ *  end acknowledges it, ESP_HOST_ACK_MS after it was written, and for a
+ *  datagram as soon as it's sent.
+ */
+#include "esp8266/esp8266.h"
+#include "esp8266/espClient.h"
+#include "hostEsp.h"
+
+#include <string.h>
+#include <unistd.h>
+
+//  Time from data written to module until remote end acknowledges it (TCP)
+#define ESP_HOST_ACK_MS         5
+//  Number and length of packets used for rate measurement
+#define PKT_NUM                 300
+#define PKT_LEN                 32
+
+#define SOCK_TCP                0
+#define SOCK_UDP                1
+
+//  Socket of the last AT+CIPSEND, and packets that reached remote end on it
+static uint8_t sendSock;
+static uint32_t pkts[2], badLen = 0;
+
+static const char* OnCommand(uint8_t port, const char *line)
+{
+    static char reply[32];
+
+    (void)port;
+    if (strncmp(line, "AT+CIPSTART=", 12) == 0)
+    {
+        sprintf(reply, "%c,CONNECT\r\n\r\nOK\r\n", line[12]);
+        return reply;
+    }
+    if (strncmp(line, "AT+CIPSEND=", 11) == 0)
+    {
+        sendSock = line[11] - '0';
+        return "\r\nOK\r\n> ";
+    }
+
+    return 0;
+}
+
+static const char* OnData(uint8_t port, const char *data, uint16_t len)
+{
+    static char reply[32];
+
+    (void)data;
+    pkts[sendSock]++;
+    if (len != PKT_LEN)
+        badLen++;
+    if (sendSock == SOCK_UDP)
+        return 0;
+
+    HostESP_ReplyStr(port, "\r\nSEND OK\r\n", ESP_HOST_ACK_MS);
+    sprintf(reply, "\r\nRecv %u bytes\r\n", len);
+
+    return reply;
+}
+
+//  Datagrams received on UDP socket
+static uint16_t rxLen[4];
+static uint8_t rxN = 0;
+
+static void OnRecv(_espClient *cli, const uint8_t *buf, const uint16_t len,
+                   void *ctx)
+{
+    (void)cli;
+    (void)buf;
+    (void)ctx;
+    if (rxN < 4)
+        rxLen[rxN] = len;
+    rxN++;
+}
+
+/**
+ * Send PKT_NUM packets of PKT_LEN bytes back to back
+ * @return rate in packets/s
+ */
+static double Burst(_espClient *cli, bool udp)
+{
+    char pkt[PKT_LEN];
+    uint32_t startMS, ms;
+
+    memset(pkt, 'p', sizeof(pkt));
+    startMS = HAL_GetMS();
+    for (uint16_t i = 0; i < PKT_NUM; i++)
+        if (udp)
+            HOST_CHECK(cli->SendUDP(pkt, PKT_LEN) & ESP_STATUS_SENDOK);
+        else
+            HOST_CHECK(cli->SendTCP(pkt, PKT_LEN) & ESP_STATUS_SENDOK);
+    ms = HAL_GetMS() - startMS;
+
+    printf("%s: %u packets of %u B in %u ms, %.0f packets/s\n",
+           udp ? "UDP" : "TCP", PKT_NUM, PKT_LEN, ms, PKT_NUM * 1000.0 / ms);
+
+    return PKT_NUM * 1000.0 / ms;
+}
+
+int main()
+{
+    ESP8266 &esp = ESP8266::GetI();
+    static const char dgrams[] = "\r\n+IPD,1,3:a\0b\r\n+IPD,1,1:c"
+                                 "\r\n+IPD,1,5:d\r\nOK";
+    _espClient *udp;
+    double tcpRate, udpRate;
+
+    HostESP_Start();
+    HostESP_OnCommand(0, OnCommand);
+    HostESP_OnData(0, OnData);
+    HOST_CHECK(esp.InitHW() & ESP_STATUS_OK);
+    esp.wifiStatus = ESP_WIFI_CONNECTED;
+    HostESP_Baud(0, ESP_DEF_BAUD);
+
+    HOST_CHECK(esp.OpenTCPSock((char*)"10.0.0.9", 80, true,
+                               SOCK_TCP) == SOCK_TCP);
+    HOST_CHECK(esp.OpenUDPSock((char*)"10.0.0.9", 5000, 5001,
+                               SOCK_UDP) == SOCK_UDP);
+    udp = esp.GetClientBySockID(SOCK_UDP);
+    HOST_CHECK((udp != 0) && udp->IsUDP());
+    if (udp == 0)
+        return HostTestDone("testUDP");
+
+    tcpRate = Burst(esp.GetClientBySockID(SOCK_TCP), false);
+    udpRate = Burst(udp, true);
+    HOST_CHECK((pkts[SOCK_TCP] == PKT_NUM) && (pkts[SOCK_UDP] == PKT_NUM));
+    HOST_CHECK(badLen == 0);
+    HOST_CHECK(udpRate > (1.5 * tcpRate));
+
+    //  Each datagram reaches handler on its own, with its exact length, even
+    //  when they arrive together
+    udp->SetHandler(OnRecv);
+    HostESP_Reply(0, dgrams, sizeof(dgrams) - 1, 0);
+    HostESP_WaitIdle(0);
+    HOST_CHECK((rxN == 3) && (rxLen[0] == 3) && (rxLen[1] == 1) &&
+               (rxLen[2] == 5));
+
+    return HostTestDone("testUDP");
+}